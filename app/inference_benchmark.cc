@@ -0,0 +1,324 @@
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include <random>
+
+#include "config.h"
+#include "game_state.h"
+#include "nn/chess_nn.h"
+#include "nn/nn_util.h"
+#include "serialize.h"
+#include "util.h"
+
+ABSL_FLAG(std::string, config, "../config.json",
+          "Config to take the device and the precision from.");
+ABSL_FLAG(std::string, exp_file, "",
+          "Experience file to take the positions from. Positions of random "
+          "games are used if empty.");
+ABSL_FLAG(std::string, num_layers, "10", "Comma separated depths to sweep.");
+ABSL_FLAG(std::string, num_filters, "256", "Comma separated widths to sweep.");
+ABSL_FLAG(std::string, batch_sizes, "1,8,16,32,64,128,256",
+          "Comma separated batch sizes to sweep.");
+ABSL_FLAG(std::string, intra_op_threads, "1,2,4",
+          "Comma separated intra-op thread counts to sweep.");
+ABSL_FLAG(std::string, precisions, "",
+          "Comma separated precisions to sweep; fp32 or reduced (see "
+          "use_reduced_precision). Follows the config if empty.");
+ABSL_FLAG(int, warmup_iterations, 3, "Untimed iterations per setting.");
+ABSL_FLAG(int, iterations, 20, "Timed iterations per setting.");
+ABSL_FLAG(int, num_random_positions, 4096,
+          "# of positions to generate when exp_file is empty.");
+ABSL_FLAG(std::string, format, "csv", "Output format; csv or json.");
+
+namespace chess {
+namespace {
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+std::vector<int> ParseIntList(const std::string& list) {
+  std::vector<int> values;
+  for (absl::string_view token : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+    int value = 0;
+    if (!absl::SimpleAtoi(token, &value) || value <= 0) {
+      std::cerr << "Invalid value [" << token << "] in " << list << std::endl;
+      std::exit(1);
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+// Values of use_reduced_precision to sweep.
+std::vector<bool> ParsePrecisions(const std::string& list,
+                                  const Config& config) {
+  if (list.empty()) {
+    return {config.use_reduced_precision};
+  }
+
+  std::vector<bool> values;
+  for (absl::string_view token : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+    if (token != "fp32" && token != "reduced") {
+      std::cerr << "Invalid precision [" << token << "] in " << list
+                << std::endl;
+      std::exit(1);
+    }
+    values.push_back(token == "reduced");
+  }
+  return values;
+}
+
+// Positions of the games where both sides play the random legal moves.
+std::vector<GameStateSerialized> GenerateRandomPositions(int num_positions,
+                                                         Config* config) {
+  std::vector<GameStateSerialized> positions;
+
+  while (static_cast<int>(positions.size()) < num_positions) {
+    std::vector<std::unique_ptr<GameState>> states;
+    states.push_back(
+        std::make_unique<GameState>(GameState::CreateInitGameState()));
+
+    while (static_cast<int>(positions.size()) < num_positions &&
+           states.back()->TotalMoveCount() <
+               config->max_game_moves_until_draw &&
+           !states.back()->IsDraw()) {
+      std::vector<Move> moves = states.back()->GetLegalMoves();
+      if (moves.empty()) {
+        break;
+      }
+
+      positions.push_back(states.back()->GetGameStateSerialized());
+
+      std::uniform_int_distribution<size_t> pick(0, moves.size() - 1);
+      states.push_back(std::make_unique<GameState>(
+          states.back().get(), moves[pick(config->rand_gen)]));
+    }
+  }
+
+  return positions;
+}
+
+std::vector<GameStateSerialized> LoadPositions(Config* config) {
+  const std::string exp_file = absl::GetFlag(FLAGS_exp_file);
+  if (exp_file.empty()) {
+    return GenerateRandomPositions(absl::GetFlag(FLAGS_num_random_positions),
+                                   config);
+  }
+
+  std::vector<GameStateSerialized> positions;
+  for (const auto& exp : DeserializeExperiences(exp_file)) {
+    positions.push_back(exp->game_state);
+  }
+  return positions;
+}
+
+struct BenchmarkResult {
+  int num_layer;
+  int num_filter;
+  int batch_size;
+  int intra_op_threads;
+  bool reduced_precision;
+
+  // Average per batch.
+  double encode_us;
+  double transfer_us;
+  double forward_us;
+
+  // Percentiles of the whole latency (encode + transfer + forward).
+  double p50_us;
+  double p99_us;
+
+  double positions_per_sec;
+};
+
+double Percentile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  const size_t index = std::min(values.size() - 1,
+                                static_cast<size_t>(p * values.size()));
+  return values[index];
+}
+
+BenchmarkResult RunBenchmark(ChessNN model, int batch_size,
+                             const std::vector<GameStateSerialized>& positions,
+                             Config* config) {
+  torch::NoGradGuard no_grad;
+
+  auto options = torch::TensorOptions().dtype(torch::kFloat).pinned_memory(
+      config->device.is_cuda());
+  torch::Tensor input =
+      torch::zeros({batch_size, kNumStatePlanes, 8, 8}, options);
+
+  const int warmup_iterations = absl::GetFlag(FLAGS_warmup_iterations);
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+
+  double total_encode_us = 0, total_transfer_us = 0, total_forward_us = 0;
+  std::vector<double> latencies;
+
+  size_t next_position = 0;
+  for (int iter = 0; iter < warmup_iterations + iterations; iter++) {
+    const auto encode_start = Clock::now();
+    for (int row = 0; row < batch_size; row++) {
+      input[row].copy_(GameStateSerializedToTensor(positions[next_position]));
+      next_position = (next_position + 1) % positions.size();
+    }
+
+    const auto transfer_start = Clock::now();
+    torch::Tensor batch = input.to(config->device);
+
+    const auto forward_start = Clock::now();
+    {
+      ReducedPrecisionGuard precision_guard(config);
+
+      // Copying the value back to CPU waits for the device to finish.
+      model->GetValue(batch).to(torch::kCPU, torch::kFloat);
+    }
+    const auto forward_end = Clock::now();
+
+    if (iter < warmup_iterations) {
+      continue;
+    }
+
+    auto to_us = [](Clock::duration d) {
+      return std::chrono::duration<double, std::micro>(d).count();
+    };
+
+    total_encode_us += to_us(transfer_start - encode_start);
+    total_transfer_us += to_us(forward_start - transfer_start);
+    total_forward_us += to_us(forward_end - forward_start);
+    latencies.push_back(to_us(forward_end - encode_start));
+  }
+
+  BenchmarkResult result;
+  result.num_layer = model->NumLayer();
+  result.num_filter = model->NumFilter();
+  result.batch_size = batch_size;
+  result.intra_op_threads = torch::get_num_threads();
+  result.reduced_precision = config->use_reduced_precision;
+  result.encode_us = total_encode_us / iterations;
+  result.transfer_us = total_transfer_us / iterations;
+  result.forward_us = total_forward_us / iterations;
+  result.p50_us = Percentile(latencies, 0.5);
+  result.p99_us = Percentile(latencies, 0.99);
+  result.positions_per_sec =
+      batch_size * 1e6 /
+      (result.encode_us + result.transfer_us + result.forward_us);
+
+  return result;
+}
+
+void PrintResults(const std::vector<BenchmarkResult>& results) {
+  if (absl::GetFlag(FLAGS_format) == "json") {
+    json output = json::array();
+    for (const auto& r : results) {
+      output.push_back({{"num_layer", r.num_layer},
+                        {"num_filter", r.num_filter},
+                        {"batch_size", r.batch_size},
+                        {"intra_op_threads", r.intra_op_threads},
+                        {"precision", r.reduced_precision ? "reduced" : "fp32"},
+                        {"encode_us", r.encode_us},
+                        {"transfer_us", r.transfer_us},
+                        {"forward_us", r.forward_us},
+                        {"p50_us", r.p50_us},
+                        {"p99_us", r.p99_us},
+                        {"positions_per_sec", r.positions_per_sec}});
+    }
+    std::cout << output.dump(2) << std::endl;
+    return;
+  }
+
+  fmt::print(
+      "num_layer,num_filter,batch_size,intra_op_threads,precision,encode_us,"
+      "transfer_us,forward_us,p50_us,p99_us,positions_per_sec\n");
+  for (const auto& r : results) {
+    fmt::print("{},{},{},{},{},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f}\n",
+               r.num_layer, r.num_filter, r.batch_size, r.intra_op_threads,
+               r.reduced_precision ? "reduced" : "fp32", r.encode_us,
+               r.transfer_us, r.forward_us, r.p50_us, r.p99_us,
+               r.positions_per_sec);
+  }
+}
+
+}  // namespace
+}  // namespace chess
+
+// Measures the forward of ChessNN over the sweep of the model sizes, the batch
+// sizes, the intra-op thread counts and the precisions. Use it to pick
+// num_layer, num_filter, the batch sizes (mcts_batch_leaf_node_size,
+// mcts_inference_batch_size, inference_max_batch_size),
+// evaluator_intra_op_threads and use_reduced_precision for the host.
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  if (absl::GetFlag(FLAGS_iterations) < 1 ||
+      absl::GetFlag(FLAGS_warmup_iterations) < 0) {
+    std::cerr << "iterations should be positive and warmup_iterations should "
+                 "not be negative."
+              << std::endl;
+    return 1;
+  }
+
+  const std::string config_file = absl::GetFlag(FLAGS_config);
+  chess::Config config = chess::IsFileExist(config_file)
+                             ? chess::Config(config_file)
+                             : chess::Config();
+
+  const std::vector<chess::GameStateSerialized> positions =
+      chess::LoadPositions(&config);
+  if (positions.empty()) {
+    std::cerr << "No positions to benchmark." << std::endl;
+    return 1;
+  }
+
+  // Progress goes to stderr so that stdout only has the results.
+  std::cerr << "Benchmarking with " << positions.size() << " positions on "
+            << config.device << std::endl;
+
+  std::vector<bool> precisions;
+  for (bool reduced :
+       chess::ParsePrecisions(absl::GetFlag(FLAGS_precisions), config)) {
+    if (reduced && !chess::IsReducedPrecisionSupported(config.device)) {
+      std::cerr << "Reduced precision is not supported on " << config.device
+                << "; Skipping it" << std::endl;
+      continue;
+    }
+    precisions.push_back(reduced);
+  }
+
+  std::vector<chess::BenchmarkResult> results;
+  for (int num_layer : chess::ParseIntList(absl::GetFlag(FLAGS_num_layers))) {
+    for (int num_filter :
+         chess::ParseIntList(absl::GetFlag(FLAGS_num_filters))) {
+      chess::ChessNN model(num_layer, num_filter, config.use_conv_policy_head);
+      model->to(config.device);
+      model->eval();
+
+      for (int threads :
+           chess::ParseIntList(absl::GetFlag(FLAGS_intra_op_threads))) {
+        torch::set_num_threads(threads);
+
+        for (bool reduced : precisions) {
+          config.use_reduced_precision = reduced;
+
+          for (int batch_size :
+               chess::ParseIntList(absl::GetFlag(FLAGS_batch_sizes))) {
+            std::cerr << fmt::format(
+                             "layer {} filter {} threads {} {} batch {}",
+                             num_layer, num_filter, threads,
+                             reduced ? "reduced" : "fp32", batch_size)
+                      << std::endl;
+            results.push_back(
+                chess::RunBenchmark(model, batch_size, positions, &config));
+          }
+        }
+      }
+    }
+  }
+
+  chess::PrintResults(results);
+}
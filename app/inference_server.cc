@@ -0,0 +1,61 @@
+#include <csignal>
+
+#include "config.h"
+#include "nn/chess_nn.h"
+#include "shm_inference.h"
+#include "shm_inference_server.h"
+#include "util.h"
+
+namespace {
+
+chess::ShmInferenceServer* running_server = nullptr;
+
+void HandleSignal(int) {
+  if (running_server) {
+    running_server->Stop();
+  }
+}
+
+}  // namespace
+
+// Loads the model once and serves the evaluation requests of the self-play
+// processes (which set the same inference_server_name) through the shared
+// memory.
+int main() {
+  chess::Config config("../config.json");
+  config.PrintConfig();
+
+  if (config.inference_server_name.empty()) {
+    std::cerr << "inference_server_name is not set (e.g. /deepchess)"
+              << std::endl;
+    return 1;
+  }
+
+  chess::ChessNN chess_nn(config.num_layer, config.num_filter,
+                          config.use_conv_policy_head);
+  if (chess::IsFileExist(config.existing_model_name)) {
+    torch::load(chess_nn, config.existing_model_name);
+  } else {
+    std::cout << config.existing_model_name
+              << " is not found; Serving the untrained model" << std::endl;
+  }
+  chess_nn->to(config.device);
+  chess_nn->eval();
+
+  auto channel = chess::ShmInferenceChannel::Create(
+      config.inference_server_name, config.inference_server_num_slots,
+      config.inference_server_slot_rows);
+  if (!channel.ok()) {
+    std::cerr << channel.status() << std::endl;
+    return 1;
+  }
+
+  chess::ShmInferenceServer server(chess_nn, &config, channel.value().get());
+
+  running_server = &server;
+  std::signal(SIGINT, HandleSignal);
+  std::signal(SIGTERM, HandleSignal);
+
+  std::cout << "Serving on " << config.inference_server_name << std::endl;
+  server.Run();
+}
@@ -1,7 +1,35 @@
 #include "chess.h"
 #include "server.h"
 #include "server_context.h"
+#include "shm_evaluator.h"
 #include "train.h"
+#include "util.h"
+
+namespace {
+
+// Evaluator of the model, or of the inference server if inference_server_name
+// is set.
+absl::StatusOr<std::unique_ptr<chess::Evaluator>> CreateEvaluator(
+    chess::ChessNN chess_nn, chess::Config* config,
+    chess::ServerContext* server_context) {
+  std::unique_ptr<chess::Evaluator> eval;
+  if (config->inference_server_name.empty()) {
+    eval = std::make_unique<chess::Evaluator>(
+        chess_nn, config, server_context->GetWorkerManager());
+  } else {
+    auto shm_eval = chess::ShmEvaluator::Create(
+        config, server_context->GetWorkerManager());
+    if (!shm_eval.ok()) {
+      return shm_eval.status();
+    }
+    eval = std::move(shm_eval).value();
+  }
+
+  eval->StartInferenceWorker();
+  return eval;
+}
+
+}  // namespace
 
 int main() {
   if (torch::cuda::cudnn_is_available()) {
@@ -18,20 +46,49 @@ int main() {
     server.RunServer();
   }
 
-  if (config.do_train) {
+  if (config.self_play_only) {
+    if (config.exp_save_file_name.empty()) {
+      std::cerr << "exp_save_file_name is not set" << std::endl;
+      return 1;
+    }
+
+    // The model is only needed when there is no inference server.
+    chess::ChessNN chess_nn(config.num_layer, config.num_filter,
+                            config.use_conv_policy_head);
+    if (config.inference_server_name.empty() &&
+        chess::IsFileExist(config.existing_model_name)) {
+      torch::load(chess_nn, config.existing_model_name);
+    }
+    chess_nn->to(config.device);
+    chess_nn->eval();
+
+    auto eval = CreateEvaluator(chess_nn, &config, &server_context);
+    if (!eval.ok()) {
+      std::cerr << eval.status() << std::endl;
+      return 1;
+    }
+
+    chess::Train trainer(&config, &server_context);
+    trainer.DoSelfPlay(eval->get());
+  } else if (config.do_train) {
     chess::Train trainer(&config, &server_context);
     trainer.DoTrain();
   } else {
     chess::Chess game(&config);
-    chess::ChessNN chess_nn(config.num_layer, config.num_filter);
+    chess::ChessNN chess_nn(config.num_layer, config.num_filter,
+                            config.use_conv_policy_head);
     chess_nn->to(config.device);
 
     chess::UniformDistribution dist;
-    chess::Evaluator eval(chess_nn, &config, server_context.GetWorkerManager());
-    eval.StartInferenceWorker();
 
-    chess::Agent agent(&dist, &config, &eval, server_context.GetWorkerManager(),
-                       0);
+    auto eval = CreateEvaluator(chess_nn, &config, &server_context);
+    if (!eval.ok()) {
+      std::cerr << eval.status() << std::endl;
+      return 1;
+    }
+
+    chess::Agent agent(&dist, &config, eval->get(),
+                       server_context.GetWorkerManager(), 0);
     auto result = game.PlayChessWithHuman(&agent, chess::WHITE);
     switch (result) {
       case chess::DRAW:
@@ -0,0 +1,123 @@
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <fmt/core.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "puct_select.h"
+
+ABSL_FLAG(std::string, num_children, "8,20,35,64,218",
+          "Comma separated # of children to sweep.");
+ABSL_FLAG(int, num_nodes, 1024,
+          "# of nodes (of random statistics) to cycle through.");
+ABSL_FLAG(int, iterations, 1000000, "Timed selections per setting.");
+
+namespace chess {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<int> ParseIntList(const std::string& list) {
+  std::vector<int> values;
+  for (absl::string_view token : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+    int value = 0;
+    if (!absl::SimpleAtoi(token, &value) || value <= 0) {
+      std::cerr << "Invalid value [" << token << "] in " << list << std::endl;
+      std::exit(1);
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+// Statistics of num_nodes nodes, laid out back to back as in MCTSTree.
+struct Nodes {
+  std::vector<float> prior;
+  std::vector<int32_t> n_s_a;
+  std::vector<float> w_s_a;
+  std::vector<int32_t> virtual_visit;
+  std::vector<int> total_visit;
+
+  ChildStats Stats(int node, int num_children) const {
+    const size_t offset = static_cast<size_t>(node) * num_children;
+    return {prior.data() + offset, n_s_a.data() + offset,
+            w_s_a.data() + offset, virtual_visit.data() + offset};
+  }
+};
+
+Nodes RandomNodes(int num_nodes, int num_children) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::uniform_int_distribution<int> visit(1, 100);
+
+  Nodes nodes;
+  for (int node = 0; node < num_nodes; node++) {
+    int total_visit = 0;
+    for (int i = 0; i < num_children; i++) {
+      nodes.prior.push_back(unit(gen));
+      nodes.n_s_a.push_back(visit(gen));
+      nodes.w_s_a.push_back((2 * unit(gen) - 1) * nodes.n_s_a.back());
+      nodes.virtual_visit.push_back(0);
+      total_visit += nodes.n_s_a.back();
+    }
+    nodes.total_visit.push_back(total_visit);
+  }
+  return nodes;
+}
+
+// Average ns per selection.
+double RunBenchmark(PUCTKernel kernel, const Nodes& nodes, int num_children) {
+  const int num_nodes = nodes.total_visit.size();
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+
+  // Keeps the selections from being optimized out.
+  int64_t checksum = 0;
+
+  const auto start = Clock::now();
+  for (int iter = 0; iter < iterations; iter++) {
+    const int node = iter % num_nodes;
+    checksum += SelectPUCT(kernel, nodes.Stats(node, num_children),
+                           num_children, nodes.total_visit[node],
+                           /*virtual_loss=*/-1);
+  }
+  const auto end = Clock::now();
+
+  if (checksum < 0) {
+    std::cerr << checksum << std::endl;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+}  // namespace chess
+
+// Measures the PUCT child selection (MCTS::Select) with each kernel that the
+// CPU supports.
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  fmt::print("kernel,num_children,ns_per_select\n");
+  for (int num_children :
+       chess::ParseIntList(absl::GetFlag(FLAGS_num_children))) {
+    const chess::Nodes nodes =
+        chess::RandomNodes(absl::GetFlag(FLAGS_num_nodes), num_children);
+
+    for (chess::PUCTKernel kernel :
+         {chess::PUCTKernel::kScalar, chess::PUCTKernel::kAvx2,
+          chess::PUCTKernel::kAvx512}) {
+      if (!chess::IsPUCTKernelSupported(kernel)) {
+        continue;
+      }
+
+      fmt::print("{},{},{:.2f}\n", chess::PUCTKernelName(kernel), num_children,
+                 chess::RunBenchmark(kernel, nodes, num_children));
+    }
+  }
+}
@@ -0,0 +1,242 @@
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "evaluator.h"
+#include "game_state.h"
+#include "nn/chess_nn.h"
+#include "nn/nn_util.h"
+
+ABSL_FLAG(std::string, num_requesters, "1,4,16",
+          "Comma separated # of requester threads to sweep.");
+ABSL_FLAG(int, num_requests, 2000, "Round trips per requester.");
+ABSL_FLAG(int, num_layer, 1, "Depth of the model.");
+ABSL_FLAG(int, num_filter, 8,
+          "Width of the model. Keep the model small so that the handoff "
+          "dominates the round trip.");
+
+namespace chess {
+namespace {
+
+std::vector<int> ParseIntList(const std::string& list) {
+  std::vector<int> values;
+  for (absl::string_view token : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+    int value = 0;
+    if (!absl::SimpleAtoi(token, &value) || value <= 0) {
+      std::cerr << "Invalid value [" << token << "] in " << list << std::endl;
+      std::exit(1);
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+// Async path of the Evaluator before the staging buffers and the completion
+// slots: The requesters encode their states, push them to the mutex protected
+// deque and wait on their own condition variable; The inference workers wake
+// up on the condition variable of the queue.
+class BaselineEvaluator {
+ public:
+  BaselineEvaluator(ChessNN model, const Config* config)
+      : model_(model), config_(config), workers_(config->num_threads) {
+    for (int i = 0; i < config_->evaluator_worker_count; i++) {
+      inference_workers_.push_back(
+          std::thread(&BaselineEvaluator::InferenceWorker, this));
+    }
+  }
+
+  ~BaselineEvaluator() {
+    {
+      std::lock_guard<std::mutex> lk(queue_m_);
+      should_finish_inference_ = true;
+    }
+    queue_cv_.notify_all();
+
+    for (auto& worker : inference_workers_) {
+      worker.join();
+    }
+  }
+
+  float EvaluateAsync(const GameState& state, int worker_id) {
+    auto& worker = workers_[worker_id];
+
+    std::unique_lock<std::mutex> lk(worker.m);
+    worker.result_is_set = false;
+
+    {
+      std::lock_guard<std::mutex> lk_queue(queue_m_);
+      queue_.push_back(
+          std::make_pair(GameStateToTensor(state).unsqueeze(0), worker_id));
+    }
+    queue_cv_.notify_all();
+
+    worker.cv.wait(lk, [&worker]() { return worker.result_is_set; });
+    return worker.result;
+  }
+
+ private:
+  struct Worker {
+    std::mutex m;
+    std::condition_variable cv;
+    bool result_is_set = false;
+    float result = 0;
+  };
+
+  void InferenceWorker() {
+    torch::NoGradGuard no_grad;
+
+    while (true) {
+      std::unique_lock<std::mutex> lk(queue_m_);
+      queue_cv_.wait(lk, [this]() {
+        return !queue_.empty() || should_finish_inference_;
+      });
+      if (should_finish_inference_) {
+        return;
+      }
+
+      std::vector<torch::Tensor> batches;
+      std::vector<int> worker_ids;
+      while (!queue_.empty() && static_cast<int>(batches.size()) <
+                                    config_->inference_max_batch_size) {
+        batches.push_back(queue_.front().first);
+        worker_ids.push_back(queue_.front().second);
+        queue_.pop_front();
+      }
+
+      // Leftovers can be picked up by other idle workers.
+      const bool has_leftover = !queue_.empty();
+      lk.unlock();
+
+      if (has_leftover) {
+        queue_cv_.notify_one();
+      }
+
+      torch::Tensor batch_tensor = torch::cat(batches).to(config_->device);
+
+      ReducedPrecisionGuard precision_guard(config_);
+      torch::Tensor values =
+          model_->GetValue(batch_tensor).to(torch::kCPU, torch::kFloat);
+
+      for (size_t i = 0; i < worker_ids.size(); i++) {
+        auto& worker = workers_[worker_ids[i]];
+        {
+          std::lock_guard<std::mutex> lk_worker(worker.m);
+          worker.result = values.data_ptr<float>()[i];
+          worker.result_is_set = true;
+        }
+        worker.cv.notify_one();
+      }
+    }
+  }
+
+  ChessNN model_;
+  const Config* config_;
+
+  std::vector<Worker> workers_;
+
+  std::mutex queue_m_;
+  std::condition_variable queue_cv_;
+  std::deque<std::pair<torch::Tensor, /*worker_id=*/int>> queue_;
+  bool should_finish_inference_ = false;
+
+  std::vector<std::thread> inference_workers_;
+};
+
+// Each of the num_requesters threads evaluates num_requests states one by one
+// through evaluate(state, worker_id). Returns the average round trip latency
+// in microseconds.
+template <typename EvaluateFn>
+double MeasureRoundTrip(int num_requesters, int num_requests,
+                        EvaluateFn evaluate) {
+  const GameState state = GameState::CreateInitGameState();
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::thread> requesters;
+  for (int i = 0; i < num_requesters; i++) {
+    requesters.push_back(std::thread([&state, &evaluate, i, num_requests]() {
+      for (int r = 0; r < num_requests; r++) {
+        evaluate(state, i);
+      }
+    }));
+  }
+
+  for (auto& requester : requesters) {
+    requester.join();
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         num_requests;
+}
+
+}  // namespace
+}  // namespace chess
+
+// Measures the round trip of the single state requests through
+// Evaluator::EvaluateAsync (the staging buffers and the completion slots)
+// against the mutex and condition variable path that it replaced, with the
+// same small model behind both. The cache is off, so every request goes
+// through the inference worker.
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  const int num_requests = absl::GetFlag(FLAGS_num_requests);
+  if (num_requests < 1) {
+    std::cerr << "num_requests should be positive." << std::endl;
+    return 1;
+  }
+
+  const std::vector<int> num_requesters_list =
+      chess::ParseIntList(absl::GetFlag(FLAGS_num_requesters));
+
+  chess::Config config;
+  config.num_threads =
+      *std::max_element(num_requesters_list.begin(), num_requesters_list.end());
+  config.eval_cache_size = 0;
+
+  chess::ChessNN model(absl::GetFlag(FLAGS_num_layer),
+                       absl::GetFlag(FLAGS_num_filter));
+  model->to(config.device);
+  model->eval();
+
+  fmt::print("num_requesters,baseline_us,evaluator_us\n");
+  for (int num_requesters : num_requesters_list) {
+    double baseline_us = 0;
+    {
+      chess::BaselineEvaluator baseline(model, &config);
+      baseline_us = chess::MeasureRoundTrip(
+          num_requesters, num_requests,
+          [&baseline](const chess::GameState& state, int worker_id) {
+            return baseline.EvaluateAsync(state, worker_id);
+          });
+    }
+
+    double evaluator_us = 0;
+    {
+      chess::Evaluator evaluator(model, &config, /*worker_manager=*/nullptr);
+      evaluator.StartInferenceWorker();
+      evaluator_us = chess::MeasureRoundTrip(
+          num_requesters, num_requests,
+          [&evaluator](const chess::GameState& state, int worker_id) {
+            return evaluator.EvaluateAsync(state, worker_id);
+          });
+    }
+
+    fmt::print("{},{:.3f},{:.3f}\n", num_requesters, baseline_us,
+               evaluator_us);
+  }
+}
@@ -5,51 +5,66 @@
 #include "mcts.h"
 
 namespace chess {
-namespace {
 
-std::pair<Experience, Move> GetMoveForSelfPlay(
-    std::unique_ptr<GameState> current, Evaluator* evaluator,
-    Distribution* dist, Config* config, int worker_id) {
-  MCTS mcts(current.get(), evaluator, dist, config, worker_id);
-  mcts.RunMCTS();
-
-  Move best_move = mcts.MoveToMake(/*choose_best_move=*/false);
-  torch::Tensor policy = mcts.GetPolicyVector();
+bool IsSelfPlayOver(const GameState& state, int num_move,
+                    const Config& config) {
+  // Game is over :)
+  if (state.GetLegalMoves().empty()) {
+    return true;
+  }
 
-  return std::make_pair(Experience{std::move(current), policy, 0}, best_move);
+  return state.IsDraw() || num_move >= config.max_game_moves_until_draw;
 }
 
-}  // namespace
+void SetSelfPlayResult(const GameState& last_state, int num_move,
+                       const Config& config,
+                       std::vector<std::unique_ptr<Experience>>* experiences) {
+  // When the game ends, the last state is not in the experiences.
+  if (num_move == config.max_game_moves_until_draw || last_state.IsDraw()) {
+    // This is draw.
+    return;
+  }
+
+  PieceSide loser = last_state.WhoIsMoving();
+  for (const auto& experience : *experiences) {
+    if (experience->state->WhoIsMoving() == loser) {
+      experience->result = -1;
+    } else {
+      experience->result = 1;
+    }
+  }
+}
 
 Agent::Agent(Distribution* dist, Config* config, Evaluator* evaluator,
-             WorkerManager* worker_manager, int worker_id)
+             WorkerManager* worker_manager, int worker_id, int model_id,
+             InferencePriority priority)
     : dist_(dist),
       config_(config),
       evaluator_(evaluator),
       worker_manager_(worker_manager),
-      worker_id_(worker_id) {}
+      worker_id_(worker_id),
+      model_id_(model_id),
+      priority_(priority) {}
+
+Agent::~Agent() = default;
 
 void Agent::Run() { DoSelfPlay(); }
 
 void Agent::DoSelfPlay() {
+  StartNewGame();
+
   // Generate experiences.
   auto current = std::make_unique<GameState>(GameState::CreateInitGameState());
   auto start = std::chrono::high_resolution_clock::now();
 
   int num_move = 0;
-  while (num_move < config_->max_game_moves_until_draw) {
-    // Game is over :)
-    if (current->GetLegalMoves().empty()) {
-      break;
-    }
+  while (!IsSelfPlayOver(*current, num_move, *config_)) {
+    MCTS* mcts = SearchTree(*current);
+    mcts->RunMCTS();
 
-    if (current->IsDraw()) {
-      break;
-    }
-
-    auto [experience, move] = GetMoveForSelfPlay(std::move(current), evaluator_,
-                                                 dist_, config_, worker_id_);
-    experiences_.push_back(std::make_unique<Experience>(std::move(experience)));
+    Move move = mcts->MoveToMake(/*choose_best_move=*/false);
+    experiences_.push_back(std::make_unique<Experience>(
+        std::move(current), mcts->GetPolicyVector(), 0));
 
     current =
         std::make_unique<GameState>(experiences_.back()->state.get(), move);
@@ -75,36 +90,48 @@ void Agent::DoSelfPlay() {
   // When the game ends, "current" owns the game ending state, which is not
   // added to the experiences queue.
   if (num_move == config_->max_game_moves_until_draw || current->IsDraw()) {
-    // This is draw.
     fmt::print("Game Is Over! : DRAW \n");
-    current->GetBoard().PrettyPrintBoard();
-    return;
+  } else {
+    fmt::print("Game Is Over! : WHITE WIN? {} \n",
+               current->WhoIsMoving() == BLACK);
   }
+  current->GetBoard().PrettyPrintBoard();
 
-  GameState* last_state = current.get();
-  PieceSide loser = last_state->WhoIsMoving();
+  SetSelfPlayResult(*current, num_move, *config_, &experiences_);
+}
 
-  fmt::print("Game Is Over! : WHITE WIN? {} \n", loser == BLACK);
-  last_state->GetBoard().PrettyPrintBoard();
+Move Agent::GetBestMove(const GameState& game_state) {
+  return GetBestMove(game_state, SearchLimits::FromConfig(*config_));
+}
 
-  for (const auto& experience : experiences_) {
-    if (experience->state->WhoIsMoving() == loser) {
-      experience->result = -1;
-    } else {
-      experience->result = 1;
-    }
+Move Agent::GetBestMove(const GameState& game_state,
+                        const SearchLimits& limits) {
+  MCTS* mcts = SearchTree(game_state);
+  mcts->RunMCTS(limits);
+
+  if (config_->move_debug_output) {
+    mcts->DumpDebugInfo();
   }
+
+  return mcts->MoveToMake(/*choose_best_move=*/true);
 }
 
-Move Agent::GetBestMove(const GameState& game_state) const {
-  MCTS mcts(&game_state, evaluator_, dist_, config_, worker_id_);
-  mcts.RunMCTS();
+void Agent::StartNewGame() {
+  if (mcts_ != nullptr) {
+    mcts_->EndGame();
+  }
+}
 
-  if (config_->move_debug_output) {
-    mcts.DumpDebugInfo();
+MCTS* Agent::SearchTree(const GameState& game_state) {
+  if (mcts_ == nullptr) {
+    mcts_ = std::make_unique<MCTS>(&game_state, evaluator_, dist_, config_,
+                                   worker_id_, model_id_, priority_);
+  } else if (!config_->reuse_mcts_tree || !mcts_->AdvanceTo(game_state)) {
+    // Reuses the arenas of the previous search.
+    mcts_->Reset(&game_state);
   }
 
-  return mcts.MoveToMake(/*choose_best_move=*/true);
+  return mcts_.get();
 }
 
 }  // namespace chess
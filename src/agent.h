@@ -10,10 +10,13 @@
 #include "evaluator.h"
 #include "game_state.h"
 #include "nn/chess_nn.h"
+#include "search_control.h"
 #include "worker_manager.h"
 
 namespace chess {
 
+class MCTS;
+
 struct Experience {
   std::unique_ptr<GameState> state;
   torch::Tensor policy;
@@ -27,10 +30,22 @@ struct Experience {
       : state(std::move(state)), policy(policy), result(result) {}
 };
 
+// Whether the self-play game is over at the state after num_move moves.
+bool IsSelfPlayOver(const GameState& state, int num_move, const Config& config);
+
+// Set the results of the experiences of the self-play game that ended at the
+// last_state after num_move moves.
+void SetSelfPlayResult(const GameState& last_state, int num_move,
+                       const Config& config,
+                       std::vector<std::unique_ptr<Experience>>* experiences);
+
 class Agent {
  public:
+  // The agent plays with the model_id th model of the evaluator.
   Agent(Distribution* dist, Config* config, Evaluator* evaluator,
-        WorkerManager* worker_manager, int worker_id);
+        WorkerManager* worker_manager, int worker_id, int model_id = 0,
+        InferencePriority priority = InferencePriority::kBackground);
+  ~Agent();
 
   // Conduct the self play and gain experiences.
   void Run();
@@ -40,12 +55,27 @@ class Agent {
     return experiences_;
   }
 
-  Move GetBestMove(const GameState& game_state) const;
+  // Consecutive calls within a game reuse the search tree of the previous
+  // move (see Config::reuse_mcts_tree). The states of the game should be alive
+  // until the game ends.
+  Move GetBestMove(const GameState& game_state);
+
+  // Same as above, but searches within the limits instead of the ones of the
+  // config.
+  Move GetBestMove(const GameState& game_state, const SearchLimits& limits);
+
+  // Drop the search tree of the previous game. Must be called before playing a
+  // new game (whose states may be allocated where the old ones were).
+  void StartNewGame();
+
   int WorkerId() const { return worker_id_; }
 
  private:
   void DoSelfPlay();
 
+  // Search tree of which the root is game_state.
+  MCTS* SearchTree(const GameState& game_state);
+
   std::vector<std::unique_ptr<Experience>> experiences_;
 
   Distribution* dist_;
@@ -55,6 +85,12 @@ class Agent {
 
   // ID of the current thread worker.
   int worker_id_;
+
+  int model_id_;
+  InferencePriority priority_;
+
+  // Search tree of the last searched move.
+  std::unique_ptr<MCTS> mcts_;
 };
 
 }  // namespace chess
@@ -0,0 +1,61 @@
+#include "batching_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace chess {
+namespace {
+
+// Weight of the newest sample in the moving averages.
+constexpr double kMovingAverageWeight = 0.1;
+
+double MovingAverage(double average, double sample) {
+  // First sample.
+  if (average == 0) {
+    return sample;
+  }
+
+  return (1 - kMovingAverageWeight) * average + kMovingAverageWeight * sample;
+}
+
+}  // namespace
+
+BatchingPolicy::BatchingPolicy(const Config* config)
+    : min_batch_size_(std::max(1, config->inference_min_batch_size)),
+      max_batch_size_(
+          std::max(min_batch_size_, config->inference_max_batch_size)),
+      max_wait_(config->inference_batch_max_wait_us),
+      target_batch_size_(min_batch_size_) {}
+
+void BatchingPolicy::RecordArrival(int num_states) {
+  num_arrived_since_dispatch_ += num_states;
+}
+
+void BatchingPolicy::RecordDispatch(Clock::time_point now) {
+  if (dispatched_before_) {
+    double elapsed_us =
+        std::chrono::duration<double, std::micro>(now - last_dispatch_).count();
+    if (elapsed_us > 0) {
+      arrival_rate_ = MovingAverage(arrival_rate_,
+                                    num_arrived_since_dispatch_ / elapsed_us);
+    }
+  }
+
+  dispatched_before_ = true;
+  last_dispatch_ = now;
+  num_arrived_since_dispatch_ = 0;
+
+  UpdateTarget();
+}
+
+void BatchingPolicy::RecordForwardLatency(std::chrono::microseconds latency) {
+  forward_latency_us_ = MovingAverage(forward_latency_us_, latency.count());
+  UpdateTarget();
+}
+
+void BatchingPolicy::UpdateTarget() {
+  int target = std::lround(arrival_rate_ * forward_latency_us_);
+  target_batch_size_ = std::clamp(target, min_batch_size_, max_batch_size_);
+}
+
+}  // namespace chess
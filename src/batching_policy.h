@@ -0,0 +1,67 @@
+#ifndef BATCHING_POLICY_H
+#define BATCHING_POLICY_H
+
+#include <chrono>
+
+#include "config.h"
+
+namespace chess {
+
+// Decides how the async inference worker collects the batch. Once the first
+// request arrives, the worker waits until either TargetBatchSize() states are
+// queued or MaxWait() has passed.
+//
+// The target is the # of states that arrive while a single forward pass is
+// running (arrival rate * forward latency). This is roughly what the worker can
+// collect without making the requesters wait longer than they already do.
+//
+// This class is not thread safe. The caller should guard it with a mutex.
+class BatchingPolicy {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  BatchingPolicy(const Config* config);
+
+  // Called when num_states states are queued.
+  void RecordArrival(int num_states);
+
+  // Called when the worker takes the batch from the queue.
+  void RecordDispatch(Clock::time_point now);
+
+  // Called when the forward pass of the batch is done.
+  void RecordForwardLatency(std::chrono::microseconds latency);
+
+  // If false, the worker should inference whatever is queued right away.
+  bool Enabled() const { return max_wait_.count() > 0; }
+
+  int TargetBatchSize() const { return target_batch_size_; }
+  int MaxBatchSize() const { return max_batch_size_; }
+  std::chrono::microseconds MaxWait() const { return max_wait_; }
+
+  // Average # of states arriving per microsecond.
+  double ArrivalRate() const { return arrival_rate_; }
+
+  // Average latency of the forward pass in microseconds.
+  double ForwardLatency() const { return forward_latency_us_; }
+
+ private:
+  void UpdateTarget();
+
+  const int min_batch_size_;
+  const int max_batch_size_;
+  const std::chrono::microseconds max_wait_;
+
+  int target_batch_size_;
+
+  // # of states that arrived since the last dispatch.
+  int num_arrived_since_dispatch_ = 0;
+  Clock::time_point last_dispatch_;
+  bool dispatched_before_ = false;
+
+  double arrival_rate_ = 0;
+  double forward_latency_us_ = 0;
+};
+
+}  // namespace chess
+
+#endif
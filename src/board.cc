@@ -10,6 +10,7 @@
 #include "piece_moves/pawn.h"
 #include "piece_moves/queen.h"
 #include "piece_moves/rook.h"
+#include "util.h"
 
 namespace chess {
 namespace {
@@ -328,6 +329,15 @@ uint64_t Board::GetBinaryPositionOfAll() const {
   return binary_board;
 }
 
+uint64_t Board::Hash() const {
+  uint64_t hash = 0;
+  for (uint64_t b : board_) {
+    hash = HashCombine(hash, b);
+  }
+
+  return hash;
+}
+
 bool Board::operator==(const Board& board) const {
   return board_ == board.board_;
 }
@@ -66,6 +66,9 @@ class Board {
 
   uint64_t GetBinaryPositionOfAll() const;
 
+  // Hash of the pieces on the board.
+  uint64_t Hash() const;
+
   bool operator==(const Board& board) const;
   bool operator!=(const Board& board) const;
 
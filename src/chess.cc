@@ -30,8 +30,10 @@ Move GetMoveFromUser(std::vector<Move> legal_moves) {
 
 }  // namespace
 
-GameResult Chess::PlayChessBetweenAgents(const Agent* white,
-                                         const Agent* black) {
+GameResult Chess::PlayChessBetweenAgents(Agent* white, Agent* black) {
+  white->StartNewGame();
+  black->StartNewGame();
+
   std::vector<std::unique_ptr<GameState>> states;
   states.push_back(
       std::make_unique<GameState>(GameState::CreateInitGameState()));
@@ -66,7 +68,9 @@ GameResult Chess::PlayChessBetweenAgents(const Agent* white,
   return DRAW;
 }
 
-GameResult Chess::PlayChessWithHuman(const Agent* agent, PieceSide my_color) {
+GameResult Chess::PlayChessWithHuman(Agent* agent, PieceSide my_color) {
+  agent->StartNewGame();
+
   std::vector<std::unique_ptr<GameState>> states;
   states.push_back(
       std::make_unique<GameState>(GameState::CreateInitGameState()));
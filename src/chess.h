@@ -13,10 +13,10 @@ class Chess {
   Chess(Config* config) : config_(config) {}
 
   // Play the game between the agent and human.
-  GameResult PlayChessBetweenAgents(const Agent* white, const Agent* black);
+  GameResult PlayChessBetweenAgents(Agent* white, Agent* black);
 
   // Play the game between me and the trained agent.
-  GameResult PlayChessWithHuman(const Agent* agent, PieceSide my_color);
+  GameResult PlayChessWithHuman(Agent* agent, PieceSide my_color);
 
  private:
   Config* config_ = nullptr;
@@ -0,0 +1,84 @@
+#ifndef COMPLETION_SLOT_H
+#define COMPLETION_SLOT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace chess {
+
+// Hint to the CPU that we are in the spin loop.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// # of spins before parking the thread. Spinning on a single core machine only
+// steals the time from the thread that we are waiting for.
+inline int SpinCountBeforePark(int spin_count) {
+  static const bool is_single_core = std::thread::hardware_concurrency() <= 1;
+  return is_single_core ? 0 : spin_count;
+}
+
+// One shot handoff between the thread that waits for the result and the thread
+// that produces it. The waiter spins for a while first, since the result
+// usually arrives within a single forward pass. It parks on the condition
+// variable only after that, and the producer takes the mutex only if the waiter
+// is actually parked.
+class CompletionSlot {
+ public:
+  // Must be called by the waiter before the request is published.
+  void Reset() { state_.store(kPending, std::memory_order_relaxed); }
+
+  // Mark as done and wake up the waiter if it is parked.
+  void Complete() {
+    if (state_.exchange(kDone, std::memory_order_acq_rel) == kParked) {
+      std::lock_guard<std::mutex> lk(m_);
+      cv_.notify_one();
+    }
+  }
+
+  // Wait until Complete() is called.
+  void Wait() {
+    for (int i = 0; i < SpinCountBeforePark(kSpinCount); i++) {
+      if (state_.load(std::memory_order_acquire) == kDone) {
+        return;
+      }
+      CpuRelax();
+    }
+
+    std::unique_lock<std::mutex> lk(m_);
+    int expected = kPending;
+    if (state_.compare_exchange_strong(expected, kParked,
+                                       std::memory_order_acq_rel)) {
+      cv_.wait(lk, [this]() {
+        return state_.load(std::memory_order_acquire) == kDone;
+      });
+    }
+  }
+
+  bool IsDone() const {
+    return state_.load(std::memory_order_acquire) == kDone;
+  }
+
+ private:
+  static constexpr int kPending = 0;
+  static constexpr int kParked = 1;
+  static constexpr int kDone = 2;
+
+  // Roughly tens of microseconds.
+  static constexpr int kSpinCount = 4096;
+
+  std::atomic<int> state_ = kDone;
+
+  std::mutex m_;
+  std::condition_variable cv_;
+};
+
+}  // namespace chess
+
+#endif
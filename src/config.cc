@@ -32,6 +32,7 @@ Config::Config(std::string file_name) {
   DEFINE_CONFIG(num_layer, int);
   DEFINE_CONFIG(num_epoch, int);
   DEFINE_CONFIG(num_filter, int);
+  DEFINE_CONFIG(use_conv_policy_head, bool);
   DEFINE_CONFIG(total_game_play_for_testing, int);
   DEFINE_CONFIG(current_best_target_score, float);
   DEFINE_CONFIG(max_game_moves_until_draw, int);
@@ -39,9 +40,25 @@ Config::Config(std::string file_name) {
   DEFINE_CONFIG(mcts_inference_batch_size, int);
   DEFINE_CONFIG(do_batch_mcts, bool);
   DEFINE_CONFIG(mcts_batch_leaf_node_size, int);
+  DEFINE_CONFIG(mcts_max_batch_collisions, int);
   DEFINE_CONFIG(mcts_virtual_loss, float);
+  DEFINE_CONFIG(mcts_search_threads, int);
+  DEFINE_CONFIG(reuse_mcts_tree, bool);
+  DEFINE_CONFIG(mcts_move_time_ms, int);
+  DEFINE_CONFIG(mcts_max_nodes, int);
+  DEFINE_CONFIG(mcts_smart_pruning, bool);
+  DEFINE_CONFIG(mcts_gumbel_root, bool);
+  DEFINE_CONFIG(mcts_gumbel_num_considered, int);
+  DEFINE_CONFIG(mcts_gumbel_c_visit, float);
+  DEFINE_CONFIG(mcts_gumbel_c_scale, float);
+  DEFINE_CONFIG(mcts_solver, bool);
+  DEFINE_CONFIG(mcts_transpositions, bool);
+  DEFINE_CONFIG(mcts_arena_huge_pages, bool);
   DEFINE_CONFIG(train_batch_size, int);
   DEFINE_CONFIG(num_self_play_game, int);
+  DEFINE_CONFIG(self_play_games_per_thread, int);
+  DEFINE_CONFIG(use_coroutine_self_play, bool);
+  DEFINE_CONFIG(coroutine_batches_in_flight, int);
   DEFINE_CONFIG(learning_rate, float);
   DEFINE_CONFIG(weight_decay, float);
   DEFINE_CONFIG(existing_model_name, std::string);
@@ -50,10 +67,22 @@ Config::Config(std::string file_name) {
   DEFINE_CONFIG(show_self_play_boards, bool);
   DEFINE_CONFIG(move_debug_output, bool);
   DEFINE_CONFIG(use_async_inference, bool);
+  DEFINE_CONFIG(use_reduced_precision, bool);
   DEFINE_CONFIG(precompute_batch_parent_min_visit_count, int);
   DEFINE_CONFIG(evaluator_worker_count, int);
+  DEFINE_CONFIG(evaluator_intra_op_threads, int);
+  DEFINE_CONFIG(pin_evaluator_worker_cores, bool);
+  DEFINE_CONFIG(inference_batch_max_wait_us, int);
+  DEFINE_CONFIG(inference_min_batch_size, int);
+  DEFINE_CONFIG(inference_max_batch_size, int);
+  DEFINE_CONFIG(eval_cache_size, int);
+  DEFINE_CONFIG(interactive_inference_deadline_us, int);
+  DEFINE_CONFIG(inference_server_name, std::string);
+  DEFINE_CONFIG(inference_server_num_slots, int);
+  DEFINE_CONFIG(inference_server_slot_rows, int);
   DEFINE_CONFIG(run_server, bool);
   DEFINE_CONFIG(do_train, bool);
+  DEFINE_CONFIG(self_play_only, bool);
   DEFINE_CONFIG(server_port, std::string);
   DEFINE_CONFIG(use_cuda, bool);
 
@@ -23,6 +23,12 @@ class Config {
   // # of filters in ChessNN.
   int num_filter = 128;
 
+  // Use the fully convolutional policy head instead of the dense layer. The
+  // dense layer holds ~22M parameters while the convolutional head only holds
+  // a few hundred thousand. Note that the models with different policy heads
+  // cannot load each other's checkpoint.
+  bool use_conv_policy_head = false;
+
   // Total number of entire training iteration.
   int num_epoch = 1;
 
@@ -50,15 +56,77 @@ class Config {
   // Size of the batch to request inferencing rollouts.
   int mcts_batch_leaf_node_size = 20;
 
+  // Max # of the selections that hit a leaf pending evaluation while a batch
+  // is collected. The batch is sent with the leaves collected so far once
+  // there are more.
+  int mcts_max_batch_collisions = 10;
+
   // Size of the virtual loss per visit.
   float mcts_virtual_loss = -0.05;
 
+  // # of threads that search a single tree together. Each search thread
+  // evaluates through its own requester slot of the evaluator.
+  int mcts_search_threads = 1;
+
+  // Keep the subtree of the played move for the search of the next move. Its
+  // visits are carried over on top of num_mcts_iteration new ones.
+  bool reuse_mcts_tree = true;
+
+  // Wall clock budget of a search in milliseconds. 0 for no deadline.
+  int mcts_move_time_ms = 0;
+
+  // Stop the search once the tree has this many nodes. 0 for no limit.
+  int mcts_max_nodes = 0;
+
+  // Stop the search once the most visited move can not be overtaken within
+  // the remaining iterations. Truncates the visit distribution (the policy
+  // target of the self-play), so it is always on only for the server. Ignored
+  // with mcts_gumbel_root, whose move is not the most visited one.
+  bool mcts_smart_pruning = false;
+
+  // Search the root in the style of Gumbel MuZero (see GumbelRoot): The
+  // sequential halving among mcts_gumbel_num_considered children sampled with
+  // the Gumbel noise, and the policy target from the completed Q.
+  bool mcts_gumbel_root = false;
+  int mcts_gumbel_num_considered = 16;
+  float mcts_gumbel_c_visit = 50;
+  float mcts_gumbel_c_scale = 1;
+
+  // Prove the wins, the losses and the draws (MCTS-solver): The terminal states
+  // and the ancestors that they decide get the exact value, and are not
+  // searched further.
+  bool mcts_solver = true;
+
+  // Share the search of the positions that are reached by different move
+  // orders within a tree (see MCTS::Transpose). The transpositions take the
+  // value of the position without the evaluation, and are not expanded while
+  // the node of the position is searched more than them.
+  bool mcts_transpositions = false;
+
+  // Advise the search arenas (where the nodes and the states of MCTS live) to
+  // be backed by the transparent huge pages.
+  bool mcts_arena_huge_pages = false;
+
   // Size of the batch during training.
   int train_batch_size = 40;
 
   // # of self-play games.
   int num_self_play_game = 8;
 
+  // # of self-play games that each of the num_threads threads plays at once
+  // (see SelfPlayDriver). Each game adds up to mcts_batch_leaf_node_size
+  // leaves to the batch of the thread. If 1, the thread plays a game at a
+  // time (unless use_coroutine_self_play).
+  int self_play_games_per_thread = 1;
+
+  // Play the self_play_games_per_thread games of each thread as coroutines
+  // (see CoroutineSelfPlay) instead.
+  bool use_coroutine_self_play = false;
+
+  // # of batches that each thread of CoroutineSelfPlay keeps in flight. While
+  // a batch is inferenced, the games of the other batches do the tree work.
+  int coroutine_batches_in_flight = 2;
+
   // Learning rate for Adam.
   float learning_rate = 0.01;
 
@@ -77,14 +145,61 @@ class Config {
   // Use the Async version of Inference evaluator.
   bool use_async_inference = false;
 
+  // Run the forward pass under the bfloat16 autocast on CPU (float16 on CUDA)
+  // when the device supports it. Weights and the training loss stay in fp32.
+  bool use_reduced_precision = false;
+
   // Minimum number of visit required to precompute value of every child of the
   // node. If this is set to num_mcts_iteration, then it means we won't
   // precompute batches.
   int precompute_batch_parent_min_visit_count = 2;
 
-  // Number of async workers in Evaluator.
+  // Number of async workers in Evaluator. Each worker owns its own replica of
+  // the model and picks up the queued requests whenever it is idle.
   int evaluator_worker_count = 1;
-  
+
+  // # of intra-op threads that each async worker uses for the forward pass.
+  // If 0, the libtorch default is used.
+  int evaluator_intra_op_threads = 0;
+
+  // Max time (in microseconds) that the async worker waits for the batch to be
+  // filled after the first request arrives. If 0, the worker inferences
+  // whatever is queued right away.
+  int inference_batch_max_wait_us = 0;
+
+  // Bounds of the batch size that the async worker waits for. The actual
+  // target is adapted from the request arrival rate and the forward latency.
+  // The worker never inferences more than inference_max_batch_size states at
+  // once; This is also the # of rows of each preallocated staging buffer.
+  int inference_min_batch_size = 1;
+  int inference_max_batch_size = 256;
+
+  // Pin each async worker (and its intra-op threads) to its own set of
+  // evaluator_intra_op_threads cores. Worker i uses cores
+  // [i * evaluator_intra_op_threads, (i + 1) * evaluator_intra_op_threads).
+  bool pin_evaluator_worker_cores = false;
+
+  // # of entries in the evaluation cache of each Evaluator (keyed by the hash
+  // of the position). 0 disables the cache.
+  int eval_cache_size = 1 << 18;
+
+  // Latency goal (in microseconds) of the interactive inference requests (e.g.
+  // the server games). Monitoring only: Requests that take longer are counted
+  // as misses (total_deadline_miss), but nothing is scheduled by it. The
+  // interactive requests never wait for their batch to fill anyway; A miss
+  // means that the forwards themselves are too slow.
+  int interactive_inference_deadline_us = 50000;
+
+  // Name of the shared memory that the out of process inference server
+  // (app/inference_server.cc) listens on. If set, the evaluators send their
+  // requests to the server instead of running the model in process.
+  std::string inference_server_name = "";
+
+  // # of request slots of the inference server, and the max # of states that
+  // each slot holds. Each slot takes ~30KB per state.
+  int inference_server_num_slots = 32;
+  int inference_server_slot_rows = 32;
+
   // Model name to import.
   std::string existing_model_name = "";
 
@@ -101,6 +216,12 @@ class Config {
   // Should do train.
   bool do_train = true;
 
+  // Only play the self-play games (num_self_play_game of them) and write their
+  // experiences to exp_save_file_name, without training. Runs against the
+  // inference server if inference_server_name is set, so several of these
+  // processes can feed a single GPU.
+  bool self_play_only = false;
+
   // Server port.
   std::string server_port = "8888";
 
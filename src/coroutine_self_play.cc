@@ -0,0 +1,323 @@
+#include "coroutine_self_play.h"
+
+#include <algorithm>
+#include <cassert>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "agent.h"
+#include "mcts.h"
+
+namespace chess {
+namespace {
+
+// Coroutine of the games played in a single slot. Starts suspended; the
+// scheduler resumes it.
+class GameTask {
+ public:
+  struct promise_type {
+    GameTask get_return_object() {
+      return GameTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  explicit GameTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  GameTask(GameTask&& task) noexcept
+      : handle_(std::exchange(task.handle_, nullptr)) {}
+  GameTask(const GameTask&) = delete;
+
+  ~GameTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  std::coroutine_handle<> Handle() const { return handle_; }
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Runs the games of a thread. Every game that is not waiting for the evaluation
+// runs until its next co_await; The states that they wait for are then sent as
+// a batch.
+class Scheduler {
+ public:
+  // Awaitable of the values of the states.
+  class Evaluation {
+   public:
+    Evaluation(Scheduler* scheduler, std::vector<const GameState*> states)
+        : scheduler_(scheduler), states_(std::move(states)) {}
+
+    bool await_ready() const noexcept { return states_.empty(); }
+    void await_suspend(std::coroutine_handle<> handle) {
+      scheduler_->Wait(this, handle);
+    }
+    std::vector<float> await_resume() { return std::move(values_); }
+
+   private:
+    friend class Scheduler;
+
+    Scheduler* scheduler_;
+    std::vector<const GameState*> states_;
+    std::vector<float> values_;
+  };
+
+  Scheduler(Config* config, Evaluator* evaluator, int worker_id, int model_id)
+      : config_(config), evaluator_(evaluator), model_id_(model_id) {
+    const int num_batches =
+        config_->use_async_inference
+            ? std::max(1, config_->coroutine_batches_in_flight)
+            : 1;
+    for (int i = 0; i < num_batches; i++) {
+      batches_.push_back(
+          Batch{evaluator_->SearchThreadWorkerId(worker_id, i), {}, false});
+    }
+  }
+
+  Evaluation Evaluate(std::vector<const GameState*> states) {
+    return Evaluation(this, std::move(states));
+  }
+
+  void Spawn(std::coroutine_handle<> handle) {
+    ready_.push_back(handle);
+    num_games_++;
+  }
+
+  // Run until every game is done.
+  void Run();
+
+ private:
+  struct Waiter {
+    Evaluation* evaluation;
+    std::coroutine_handle<> handle;
+  };
+
+  // Batch that is sent through the requester slot of worker_id.
+  struct Batch {
+    int worker_id;
+    std::vector<Waiter> waiters;
+    bool in_flight;
+  };
+
+  void Wait(Evaluation* evaluation, std::coroutine_handle<> handle) {
+    waiting_.push_back({evaluation, handle});
+  }
+
+  // Send the waiting states through a batch that is not in flight. Returns
+  // false if every batch is in flight.
+  bool TrySend();
+  void Send(Batch* batch);
+
+  // Give the values to the waiters of the batch and make them ready.
+  void Finish(Batch* batch, const std::vector<float>& values);
+
+  Config* config_;
+  Evaluator* evaluator_;
+  int model_id_;
+
+  // Games that can run.
+  std::deque<std::coroutine_handle<>> ready_;
+
+  // Games that wait for the evaluation, which is not sent yet.
+  std::vector<Waiter> waiting_;
+
+  std::vector<Batch> batches_;
+
+  // Batches in the order that they were sent.
+  std::deque<Batch*> in_flight_;
+
+  int num_games_ = 0;
+};
+
+void Scheduler::Run() {
+  // Each batch takes its share of the games, so that the rest of the games run
+  // while it is inferenced.
+  const size_t batch_share =
+      (num_games_ + batches_.size() - 1) / batches_.size();
+
+  while (true) {
+    // Tree work of every game that can run.
+    while (!ready_.empty()) {
+      std::coroutine_handle<> handle = ready_.front();
+      ready_.pop_front();
+      handle.resume();
+
+      if (waiting_.size() >= batch_share) {
+        TrySend();
+      }
+    }
+
+    if (!waiting_.empty() && TrySend()) {
+      continue;
+    }
+
+    if (in_flight_.empty()) {
+      // Nothing is waiting nor running.
+      assert(waiting_.empty());
+      return;
+    }
+
+    // Resume the games of the batches that came back. If none did, there is
+    // nothing else to do than to wait for the oldest one.
+    bool any_done = false;
+    for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+      if (evaluator_->PollAsyncBatch((*it)->worker_id)) {
+        Finish(*it, evaluator_->TakeAsyncBatchResult((*it)->worker_id));
+        it = in_flight_.erase(it);
+        any_done = true;
+      } else {
+        it++;
+      }
+    }
+
+    if (!any_done) {
+      Batch* oldest = in_flight_.front();
+      in_flight_.pop_front();
+      Finish(oldest, evaluator_->TakeAsyncBatchResult(oldest->worker_id));
+    }
+  }
+}
+
+bool Scheduler::TrySend() {
+  for (Batch& batch : batches_) {
+    if (!batch.in_flight) {
+      Send(&batch);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Scheduler::Send(Batch* batch) {
+  std::vector<const GameState*> states;
+  for (const Waiter& waiter : waiting_) {
+    states.insert(states.end(), waiter.evaluation->states_.begin(),
+                  waiter.evaluation->states_.end());
+  }
+  batch->waiters = std::move(waiting_);
+  waiting_.clear();
+
+  if (!config_->use_async_inference) {
+    Finish(batch, evaluator_->EvalulateBatch(states, model_id_));
+    return;
+  }
+
+  evaluator_->SubmitAsyncBatch(states, batch->worker_id, model_id_);
+  batch->in_flight = true;
+  in_flight_.push_back(batch);
+}
+
+void Scheduler::Finish(Batch* batch, const std::vector<float>& values) {
+  auto begin = values.begin();
+  for (const Waiter& waiter : batch->waiters) {
+    const size_t num_states = waiter.evaluation->states_.size();
+    waiter.evaluation->values_.assign(begin, begin + num_states);
+    begin += num_states;
+
+    ready_.push_back(waiter.handle);
+  }
+
+  batch->waiters.clear();
+  batch->in_flight = false;
+}
+
+// Plays the games in a slot until start_game() does not allow a new game.
+GameTask PlayGames(Scheduler* scheduler, Distribution* dist, Config* config,
+                   Evaluator* evaluator, int worker_id, int model_id,
+                   const CoroutineSelfPlay::StartGame* start_game,
+                   const CoroutineSelfPlay::FinishGame* finish_game) {
+  std::unique_ptr<MCTS> mcts;
+
+  while ((*start_game)()) {
+    auto current =
+        std::make_unique<GameState>(GameState::CreateInitGameState());
+    std::vector<std::unique_ptr<Experience>> experiences;
+    int num_move = 0;
+
+    while (!IsSelfPlayOver(*current, num_move, *config)) {
+      if (mcts == nullptr) {
+        mcts = std::make_unique<MCTS>(current.get(), evaluator, dist, config,
+                                      worker_id, model_id);
+      } else if (!config->reuse_mcts_tree || !mcts->AdvanceTo(*current)) {
+        mcts->Reset(current.get());
+      }
+
+      mcts->BeginSearch(SearchLimits::FromConfig(*config));
+      while (!mcts->SearchDone()) {
+        std::vector<NodeIndex> leaves =
+            mcts->CollectLeaves(config->mcts_batch_leaf_node_size);
+
+        std::vector<const GameState*> states;
+        states.reserve(leaves.size());
+        for (NodeIndex leaf : leaves) {
+          states.push_back(&mcts->Tree().State(leaf));
+        }
+
+        std::vector<float> values =
+            co_await scheduler->Evaluate(std::move(states));
+        mcts->ApplyValues(leaves, values);
+      }
+
+      Move move = mcts->MoveToMake(/*choose_best_move=*/false);
+      experiences.push_back(std::make_unique<Experience>(
+          std::move(current), mcts->GetPolicyVector(), 0));
+
+      current = std::make_unique<GameState>(experiences.back()->state.get(),
+                                            move);
+      num_move++;
+    }
+
+    // States of this game are going away.
+    if (mcts != nullptr) {
+      mcts->EndGame();
+    }
+
+    SetSelfPlayResult(*current, num_move, *config, &experiences);
+    (*finish_game)(experiences);
+  }
+}
+
+}  // namespace
+
+CoroutineSelfPlay::CoroutineSelfPlay(Distribution* dist, Config* config,
+                                     Evaluator* evaluator, int worker_id,
+                                     int model_id)
+    : dist_(dist),
+      config_(config),
+      evaluator_(evaluator),
+      worker_id_(worker_id),
+      model_id_(model_id) {}
+
+void CoroutineSelfPlay::Run(const StartGame& start_game,
+                            const FinishGame& finish_game) {
+  Scheduler scheduler(config_, evaluator_, worker_id_, model_id_);
+
+  std::vector<GameTask> tasks;
+  for (int i = 0; i < std::max(config_->self_play_games_per_thread, 1); i++) {
+    tasks.push_back(PlayGames(&scheduler, dist_, config_, evaluator_,
+                              worker_id_, model_id_, &start_game,
+                              &finish_game));
+    scheduler.Spawn(tasks.back().Handle());
+  }
+
+  scheduler.Run();
+
+  for (const GameTask& task : tasks) {
+    assert(task.Handle().done());
+  }
+}
+
+}  // namespace chess
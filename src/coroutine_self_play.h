@@ -0,0 +1,44 @@
+#ifndef COROUTINE_SELF_PLAY_H
+#define COROUTINE_SELF_PLAY_H
+
+#include "config.h"
+#include "distribution.h"
+#include "evaluator.h"
+#include "self_play_driver.h"
+
+namespace chess {
+
+// Plays self_play_games_per_thread self-play games at once on a single thread,
+// each as a C++20 coroutine. A game searches as usual and co_awaits the
+// evaluation of its leaves. The scheduler of the thread sends the leaves of
+// the suspended games as a batch, and resumes them when the batch comes back.
+// Up to coroutine_batches_in_flight batches are in flight at once, so the
+// games of the batch that came back do the tree work while the others wait
+// for the inference.
+//
+// Only coroutine_self_play.cc needs C++20; This header does not, so the users
+// of the library stay on C++17.
+class CoroutineSelfPlay {
+ public:
+  using StartGame = SelfPlayDriver::StartGame;
+  using FinishGame = SelfPlayDriver::FinishGame;
+
+  // The games are evaluated with the model_id th model of the evaluator,
+  // through the requester slots of worker_id.
+  CoroutineSelfPlay(Distribution* dist, Config* config, Evaluator* evaluator,
+                    int worker_id, int model_id = 0);
+
+  // Same as SelfPlayDriver::Run().
+  void Run(const StartGame& start_game, const FinishGame& finish_game);
+
+ private:
+  Distribution* dist_;
+  Config* config_;
+  Evaluator* evaluator_;
+  int worker_id_;
+  int model_id_;
+};
+
+}  // namespace chess
+
+#endif
@@ -0,0 +1,58 @@
+#include "eval_cache.h"
+
+namespace chess {
+namespace {
+
+constexpr size_t kNumStripes = 64;
+
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+
+}  // namespace
+
+EvalCache::EvalCache(int num_entries)
+    : entries_(num_entries > 0 ? RoundUpToPowerOfTwo(num_entries) : 0),
+      stripes_(kNumStripes) {}
+
+std::optional<float> EvalCache::Lookup(uint64_t key) {
+  if (!Enabled()) {
+    return std::nullopt;
+  }
+
+  const size_t index = key & (entries_.size() - 1);
+
+  {
+    std::lock_guard<std::mutex> lk(StripeOf(index));
+
+    const Entry& entry = entries_[index];
+    if (entry.valid && entry.key == key) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return entry.value;
+    }
+  }
+
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return std::nullopt;
+}
+
+void EvalCache::Insert(uint64_t key, float value) {
+  if (!Enabled()) {
+    return;
+  }
+
+  const size_t index = key & (entries_.size() - 1);
+
+  std::lock_guard<std::mutex> lk(StripeOf(index));
+
+  Entry& entry = entries_[index];
+  entry.key = key;
+  entry.valid = true;
+  entry.value = value;
+}
+
+}  // namespace chess
@@ -0,0 +1,52 @@
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace chess {
+
+// Fixed size cache of the evaluated values keyed by GameState::Hash(). The
+// entries are direct mapped (newer one replaces older one) and guarded by a
+// small set of striped locks, so it can be shared by every search thread.
+//
+// Nothing is ever invalidated. The Evaluator folds the model id and the
+// version of the model (see Evaluator::ModelVersion()) into the key, so the
+// values of the older weights are just never looked up again.
+class EvalCache {
+ public:
+  // num_entries is rounded up to the power of 2. 0 disables the cache.
+  explicit EvalCache(int num_entries);
+
+  bool Enabled() const { return !entries_.empty(); }
+
+  std::optional<float> Lookup(uint64_t key);
+  void Insert(uint64_t key, float value);
+
+  uint64_t Hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t Misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Entry {
+    uint64_t key = 0;
+    bool valid = false;
+    float value = 0;
+  };
+
+  std::mutex& StripeOf(size_t index) {
+    return stripes_[index & (stripes_.size() - 1)];
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<std::mutex> stripes_;
+
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+};
+
+}  // namespace chess
+
+#endif
@@ -2,12 +2,38 @@
 
 #include <fmt/ranges.h>
 
+#include <algorithm>
+
 #include "nn/chess_nn.h"
 #include "nn/nn_util.h"
+#include "util.h"
 
 namespace chess {
 
-float Evaluator::Evalulate(const GameState& state) {
+Evaluator::Evaluator(std::vector<ChessNN> models, const Config* config,
+                     WorkerManager* worker_manager)
+    : models_(std::move(models)),
+      config_(config),
+      eval_cache_(config->eval_cache_size),
+      batching_policy_(config),
+      worker_info_((config_->num_threads + 1) *
+                   std::max({1, config_->mcts_search_threads,
+                             config_->coroutine_batches_in_flight})),
+      worker_manager_(worker_manager) {
+  for (size_t model_id = 0; model_id < models_.size(); model_id++) {
+    published_models_.push_back(std::make_unique<PublishedModel>());
+  }
+
+  // Evaluators that do not run the models locally (e.g. ShmEvaluator) do not
+  // have any to publish.
+  for (size_t model_id = 0; model_id < models_.size(); model_id++) {
+    if (!models_[model_id].is_empty()) {
+      PublishModel(model_id, models_[model_id]);
+    }
+  }
+}
+
+float Evaluator::Evalulate(const GameState& state, int model_id) {
   if (state.IsDraw()) {
     return 0;
   }
@@ -17,26 +43,37 @@ float Evaluator::Evalulate(const GameState& state) {
     return -1;
   }
 
+  std::shared_ptr<const ModelSnapshot> snapshot = GetSnapshot(model_id);
+  if (auto cached = LookupCache(state, model_id, snapshot->version)) {
+    return cached.value();
+  }
+
   torch::Tensor tensor = GameStateToTensor(state);
   tensor = tensor.to(config_->device);
 
+  ReducedPrecisionGuard precision_guard(config_);
+
   // Convert board to the state.
-  torch::Tensor value_tensor = chess_net_->GetValue(tensor);
+  torch::Tensor value_tensor = snapshot->replicas[0]->GetValue(tensor);
 
   // Note that the returned value_tensor is 1 * 1.
   torch::Device device(torch::kCPU);
-  torch::Tensor cpu_tensor = value_tensor.to(device);
+  torch::Tensor cpu_tensor = value_tensor.to(device, torch::kFloat);
 
-  return cpu_tensor.data_ptr<float>()[0];
+  const float value = cpu_tensor.data_ptr<float>()[0];
+  InsertCache(state, model_id, snapshot->version, value);
+
+  return value;
 }
 
 std::vector<float> Evaluator::EvalulateBatch(
-    std::vector<const GameState*> states) {
+    std::vector<const GameState*> states, int model_id) {
   if (states.empty()) {
     return {};
   }
 
   std::vector<float> scores(states.size(), 0);
+  std::shared_ptr<const ModelSnapshot> snapshot = GetSnapshot(model_id);
 
   std::vector<bool> is_set(states.size(), false);
   std::vector<torch::Tensor> batch;
@@ -53,6 +90,12 @@ std::vector<float> Evaluator::EvalulateBatch(
       continue;
     }
 
+    if (auto cached = LookupCache(*states[i], model_id, snapshot->version)) {
+      scores[i] = cached.value();
+      is_set[i] = true;
+      continue;
+    }
+
     torch::Tensor tensor = GameStateToTensor(*states[i]);
     batch.push_back(tensor);
   }
@@ -64,11 +107,12 @@ std::vector<float> Evaluator::EvalulateBatch(
   torch::Tensor batch_tensor = torch::stack(batch);
   batch_tensor = batch_tensor.to(config_->device);
 
-  torch::Tensor value_tensor = chess_net_->GetValue(batch_tensor);
+  ReducedPrecisionGuard precision_guard(config_);
+  torch::Tensor value_tensor = snapshot->replicas[0]->GetValue(batch_tensor);
 
   // Note that the returned value_tensor is N * 1.
   torch::Device device(torch::kCPU);
-  torch::Tensor cpu_tensor = value_tensor.to(device);
+  torch::Tensor cpu_tensor = value_tensor.to(device, torch::kFloat);
 
   size_t score_index = 0, batch_index = 0;
   while (batch_index < batch.size()) {
@@ -77,6 +121,8 @@ std::vector<float> Evaluator::EvalulateBatch(
       continue;
     } else {
       scores[score_index] = cpu_tensor.data_ptr<float>()[batch_index];
+      InsertCache(*states[score_index], model_id, snapshot->version,
+                  scores[score_index]);
     }
 
     score_index++;
@@ -86,7 +132,8 @@ std::vector<float> Evaluator::EvalulateBatch(
   return scores;
 }
 
-float Evaluator::EvaluateAsync(const GameState& state, int worker_id) {
+float Evaluator::EvaluateAsync(const GameState& state, int worker_id,
+                                int model_id, InferencePriority priority) {
   if (state.IsDraw()) {
     return 0;
   }
@@ -96,33 +143,24 @@ float Evaluator::EvaluateAsync(const GameState& state, int worker_id) {
     return -1;
   }
 
-  auto& worker_info = worker_info_[worker_id];
-
-  std::unique_lock<std::mutex> lk(worker_info.m_cv);
-  worker_info.result_is_set = false;
-
-  {
-    std::lock_guard<std::mutex> lk_queue(batch_queue_m_);
-    torch::Tensor tensor = GameStateToTensor(state);
-    assert(tensor.sizes().size() == 3);
-
-    // We have to pass 1 * .... tensor;
-    tensor = tensor.unsqueeze(0);
-    batch_queue_.push_back(std::make_pair(tensor, worker_id));
+  // Inference workers use this version or the later one.
+  const uint64_t version = ModelVersion(model_id);
+  if (auto cached = LookupCache(state, model_id, version)) {
+    return cached.value();
   }
 
-  batch_queue_cv_.notify_one();
+  std::vector<float> result =
+      EvaluateThroughWorker({&state}, worker_id, model_id, priority);
 
-  // Wait until the inference is done.
-  worker_info_[worker_id].cv_inference.wait(
-      lk, [&worker_info]() { return worker_info.result_is_set; });
+  assert(result.size() == 1);
+  InsertCache(state, model_id, version, result[0]);
 
-  assert(worker_info.result.size() == 1);
-  return worker_info.result[0];
+  return result[0];
 }
 
 std::vector<float> Evaluator::EvaluateAsyncBatch(
-    const std::vector<const GameState*>& states, int worker_id) {
+    const std::vector<const GameState*>& states, int worker_id, int model_id,
+    InferencePriority priority) {
   if (states.empty()) {
     return {};
   }
@@ -130,47 +168,150 @@ std::vector<float> Evaluator::EvaluateAsyncBatch(
   std::vector<float> scores(states.size(), 0);
   std::vector<bool> is_set(states.size(), false);
 
-  std::vector<torch::Tensor> batch;
-  for (size_t i = 0; i < states.size(); i++) {
-    if (states[i]->IsDraw()) {
-      scores[i] = 0;
-      is_set[i] = true;
-      continue;
-    }
+  // Inference workers use this version or the later one.
+  const uint64_t version = ModelVersion(model_id);
 
-    if (states[i]->GetLegalMoves().empty()) {
-      scores[i] = -1;
-      is_set[i] = true;
-      continue;
-    }
+  std::vector<const GameState*> batch =
+      FilterKnownStates(states, model_id, version, &scores, &is_set);
+  if (batch.empty()) {
+    return scores;
+  }
 
-    torch::Tensor tensor = GameStateToTensor(*states[i]);
-    batch.push_back(tensor);
+  std::vector<float> result =
+      EvaluateThroughWorker(batch, worker_id, model_id, priority);
+  MergeInferenceResult(states, is_set, result, model_id, version, &scores);
+
+  return scores;
+}
+
+void Evaluator::SubmitAsyncBatch(const std::vector<const GameState*>& states,
+                                 int worker_id, int model_id,
+                                 InferencePriority priority) {
+  PendingBatch& pending = worker_info_[worker_id].pending;
+  pending.states = states;
+  pending.model_id = model_id;
+  pending.priority = priority;
+  pending.version = ModelVersion(model_id);
+
+  pending.scores.assign(states.size(), 0);
+  pending.is_set.assign(states.size(), false);
+  pending.batch = FilterKnownStates(states, model_id, pending.version,
+                                    &pending.scores, &pending.is_set);
+  pending.num_sent = 0;
+  pending.result.clear();
+
+  SendNextChunk(worker_id);
+}
+
+bool Evaluator::PollAsyncBatch(int worker_id) {
+  auto& worker_info = worker_info_[worker_id];
+  if (!worker_info.completion.IsDone()) {
+    return false;
   }
 
-  if (batch.empty()) {
-    return scores;
+  CollectChunk(worker_id);
+
+  // Batches larger than the staging buffer are sent in chunks.
+  if (worker_info.pending.num_sent < worker_info.pending.batch.size()) {
+    SendNextChunk(worker_id);
+    return false;
   }
 
-  torch::Tensor batch_tensor = torch::stack(batch);
-  batch_tensor = batch_tensor.to(config_->device);
+  return true;
+}
+
+std::vector<float> Evaluator::TakeAsyncBatchResult(int worker_id) {
+  auto& worker_info = worker_info_[worker_id];
+  while (!PollAsyncBatch(worker_id)) {
+    worker_info.completion.Wait();
+  }
+
+  PendingBatch& pending = worker_info.pending;
+  if (!pending.batch.empty()) {
+    MergeInferenceResult(pending.states, pending.is_set, pending.result,
+                         pending.model_id, pending.version, &pending.scores);
+  }
 
+  return std::move(pending.scores);
+}
+
+void Evaluator::SendNextChunk(int worker_id) {
   auto& worker_info = worker_info_[worker_id];
+  PendingBatch& pending = worker_info.pending;
+  if (pending.num_sent >= pending.batch.size()) {
+    return;
+  }
 
-  std::unique_lock<std::mutex> lk(worker_info.m_cv);
-  worker_info.result_is_set = false;
+  ModelQueue& queue = GetModelQueue(pending.model_id, pending.priority);
+  const int num_rows = std::min<int>(batching_policy_.MaxBatchSize(),
+                                     pending.batch.size() - pending.num_sent);
 
-  {
-    std::lock_guard<std::mutex> lk_queue(batch_queue_m_);
-    batch_queue_.push_back(std::make_pair(batch_tensor, worker_id));
+  pending.chunk_start = BatchingPolicy::Clock::now();
+
+  auto [buffer, start_row] =
+      ReserveRows(&queue, pending.priority, num_rows, worker_id);
+  for (int i = 0; i < num_rows; i++) {
+    torch::Tensor row = buffer->input[start_row + i];
+    GameStateToTensor(*pending.batch[pending.num_sent + i], &row);
+  }
+
+  worker_info.completion.Reset();
+  SubmitRows(buffer, num_rows);
+
+  pending.num_sent += num_rows;
+}
+
+void Evaluator::CollectChunk(int worker_id) {
+  auto& worker_info = worker_info_[worker_id];
+  PendingBatch& pending = worker_info.pending;
+  if (pending.result.size() >= pending.num_sent) {
+    // Already collected.
+    return;
   }
 
-  batch_queue_cv_.notify_one();
+  RecordLatency(pending.priority,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    BatchingPolicy::Clock::now() - pending.chunk_start));
 
-  // Wait until the inference is done.
-  worker_info_[worker_id].cv_inference.wait(
-      lk, [&worker_info]() { return worker_info.result_is_set; });
+  assert(pending.result.size() + worker_info.result.size() ==
+         pending.num_sent);
+  pending.result.insert(pending.result.end(), worker_info.result.begin(),
+                        worker_info.result.end());
+}
 
+std::vector<const GameState*> Evaluator::FilterKnownStates(
+    const std::vector<const GameState*>& states, int model_id,
+    uint64_t version, std::vector<float>* scores, std::vector<bool>* is_set) {
+  std::vector<const GameState*> batch;
+  for (size_t i = 0; i < states.size(); i++) {
+    if (states[i]->IsDraw()) {
+      (*scores)[i] = 0;
+      (*is_set)[i] = true;
+      continue;
+    }
+
+    if (states[i]->GetLegalMoves().empty()) {
+      (*scores)[i] = -1;
+      (*is_set)[i] = true;
+      continue;
+    }
+
+    if (auto cached = LookupCache(*states[i], model_id, version)) {
+      (*scores)[i] = cached.value();
+      (*is_set)[i] = true;
+      continue;
+    }
+
+    batch.push_back(states[i]);
+  }
+
+  return batch;
+}
+
+void Evaluator::MergeInferenceResult(
+    const std::vector<const GameState*>& states,
+    const std::vector<bool>& is_set, const std::vector<float>& result,
+    int model_id, uint64_t version, std::vector<float>* scores) {
   size_t score_index = 0, batch_index = 0;
   while (score_index < states.size()) {
     if (is_set[score_index]) {
@@ -178,86 +319,500 @@ std::vector<float> Evaluator::EvaluateAsyncBatch(
       continue;
     }
 
-    scores[score_index] = worker_info.result[batch_index];
+    (*scores)[score_index] = result[batch_index];
+    InsertCache(*states[score_index], model_id, version,
+                (*scores)[score_index]);
     score_index++;
     batch_index++;
   }
+}
 
-  return scores;
+std::vector<float> Evaluator::EvaluateThroughWorker(
+    const std::vector<const GameState*>& states, int worker_id, int model_id,
+    InferencePriority priority) {
+  auto& worker_info = worker_info_[worker_id];
+  ModelQueue& queue = GetModelQueue(model_id, priority);
+  const int capacity = batching_policy_.MaxBatchSize();
+
+  std::vector<float> result;
+  result.reserve(states.size());
+
+  // Requests larger than the staging buffer are sent in chunks.
+  for (size_t chunk_start = 0; chunk_start < states.size();
+       chunk_start += capacity) {
+    const int num_rows =
+        std::min<int>(capacity, states.size() - chunk_start);
+
+    const auto request_start = BatchingPolicy::Clock::now();
+
+    auto [buffer, start_row] =
+        ReserveRows(&queue, priority, num_rows, worker_id);
+    for (int i = 0; i < num_rows; i++) {
+      torch::Tensor row = buffer->input[start_row + i];
+      GameStateToTensor(*states[chunk_start + i], &row);
+    }
+
+    worker_info.completion.Reset();
+    SubmitRows(buffer, num_rows);
+
+    // Wait until the inference is done.
+    worker_info.completion.Wait();
+
+    RecordLatency(priority,
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      BatchingPolicy::Clock::now() - request_start));
+
+    assert(worker_info.result.size() == static_cast<size_t>(num_rows));
+    result.insert(result.end(), worker_info.result.begin(),
+                  worker_info.result.end());
+  }
+
+  return result;
+}
+
+std::pair<StagingBuffer*, int> Evaluator::ReserveRows(
+    ModelQueue* queue, InferencePriority priority, int num_rows,
+    int worker_id) {
+  const uint32_t capacity = batching_policy_.MaxBatchSize();
+
+  // Counted before the rows can be sealed, so SealActiveBuffer() never takes
+  // away more than is counted. Sequentially consistent; Together with the ones
+  // in WaitForRequests, either the parked worker sees the new states, or
+  // SubmitRows() sees the parked worker and wakes it up.
+  queue->num_states.fetch_add(num_rows);
+  if (priority == InferencePriority::kInteractive) {
+    interactive_num_states_.fetch_add(num_rows);
+  }
+  batch_queue_num_states_.fetch_add(num_rows);
+
+  while (true) {
+    const int active = queue->active_buffer.load(std::memory_order_acquire);
+    StagingBuffer* buffer = queue->staging_buffers[active].get();
+
+    // Sealed buffer never gets the reservation; It is released only after it
+    // is reactivated by the inference worker.
+    uint32_t reserved = buffer->reserved.load(std::memory_order_acquire);
+    while (!(reserved & StagingBuffer::kSealed) &&
+           reserved + num_rows <= capacity) {
+      if (buffer->reserved.compare_exchange_weak(reserved, reserved + num_rows,
+                                                 std::memory_order_acq_rel)) {
+        buffer->reservations[reserved] = std::make_pair(worker_id, num_rows);
+        return std::make_pair(buffer, static_cast<int>(reserved));
+      }
+    }
+
+    // Either the buffer is full or the worker is switching the buffers.
+    std::this_thread::yield();
+  }
+}
+
+void Evaluator::SubmitRows(StagingBuffer* buffer, int num_rows) {
+  buffer->written.fetch_add(num_rows, std::memory_order_release);
+  total_queued_states_.fetch_add(num_rows, std::memory_order_relaxed);
+
+  // The states are counted by ReserveRows(), so the parked worker may have
+  // already taken them; Waking it up is harmless either way.
+  if (num_parked_workers_.load() > 0) {
+    std::lock_guard<std::mutex> lk(batch_queue_m_);
+    batch_queue_cv_.notify_all();
+  }
+}
+
+int Evaluator::NextModelToInference(int start_model_id,
+                                    InferencePriority priority) {
+  int best_model_id = start_model_id;
+  int best_num_states = -1;
+
+  for (int i = 0; i < NumModels(); i++) {
+    const int model_id = (start_model_id + i) % NumModels();
+    const int num_states = GetModelQueue(model_id, priority).num_states.load();
+    if (num_states > best_num_states) {
+      best_model_id = model_id;
+      best_num_states = num_states;
+    }
+  }
+
+  return best_model_id;
+}
+
+std::pair<StagingBuffer*, int> Evaluator::SealActiveBuffer(
+    ModelQueue* queue, InferencePriority priority, int max_rows) {
+  std::lock_guard<std::mutex> lk(staging_m_);
+
+  StagingBuffer* buffer =
+      queue->staging_buffers[queue->active_buffer.load()].get();
+
+  // Other worker may have already taken it.
+  uint32_t reserved = buffer->reserved.load();
+  do {
+    if (reserved == 0 || reserved > static_cast<uint32_t>(max_rows)) {
+      return std::make_pair(nullptr, 0);
+    }
+  } while (!buffer->reserved.compare_exchange_weak(
+      reserved, reserved | StagingBuffer::kSealed));
+
+  const int num_rows = reserved;
+  buffer->in_flight = true;
+
+  // There is one more buffer than the workers, so at least one is free.
+  for (size_t i = 0; i < queue->staging_buffers.size(); i++) {
+    if (!queue->staging_buffers[i]->in_flight) {
+      queue->staging_buffers[i]->reserved.store(0, std::memory_order_release);
+      queue->active_buffer.store(i, std::memory_order_release);
+      break;
+    }
+  }
+
+  // Every reserved row is already counted by ReserveRows().
+  queue->num_states.fetch_sub(num_rows);
+  if (priority == InferencePriority::kInteractive) {
+    interactive_num_states_.fetch_sub(num_rows);
+  }
+  batch_queue_num_states_.fetch_sub(num_rows);
+
+  return std::make_pair(buffer, num_rows);
+}
+
+void Evaluator::ReleaseBuffer(StagingBuffer* buffer) {
+  std::lock_guard<std::mutex> lk(staging_m_);
+  buffer->written.store(0, std::memory_order_relaxed);
+  buffer->in_flight = false;
+}
+
+void Evaluator::RecordLatency(InferencePriority priority,
+                              std::chrono::microseconds latency) {
+  if (worker_manager_ == nullptr) {
+    return;
+  }
+
+  auto& info = worker_manager_->GetInferenceLatencyInfo(priority);
+  info.total_num_request.fetch_add(1, std::memory_order_relaxed);
+  info.total_latency_us.fetch_add(latency.count(), std::memory_order_relaxed);
+
+  uint64_t max_latency = info.max_latency_us.load(std::memory_order_relaxed);
+  while (static_cast<uint64_t>(latency.count()) > max_latency &&
+         !info.max_latency_us.compare_exchange_weak(
+             max_latency, latency.count(), std::memory_order_relaxed)) {
+  }
+
+  if (priority == InferencePriority::kInteractive &&
+      latency.count() > config_->interactive_inference_deadline_us) {
+    info.total_deadline_miss.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::shared_ptr<const ModelSnapshot> Evaluator::GetSnapshot(int model_id) {
+  PublishedModel& published = *published_models_[model_id];
+
+  std::lock_guard<std::mutex> lk(published.m);
+  return published.snapshot;
+}
+
+std::optional<float> Evaluator::LookupCache(const GameState& state,
+                                            int model_id, uint64_t version) {
+  if (!eval_cache_.Enabled()) {
+    return std::nullopt;
+  }
+
+  std::optional<float> value =
+      eval_cache_.Lookup(HashCombine(HashCombine(state.Hash(), model_id),
+                                     version));
+
+  if (worker_manager_ != nullptr) {
+    auto& info = worker_manager_->GetEvalCacheInfo();
+    if (value) {
+      info.total_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      info.total_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  return value;
+}
+
+void Evaluator::InsertCache(const GameState& state, int model_id,
+                            uint64_t version, float value) {
+  eval_cache_.Insert(HashCombine(HashCombine(state.Hash(), model_id), version),
+                     value);
+}
+
+bool Evaluator::WaitForRequests(
+    int min_states, std::optional<BatchingPolicy::Clock::time_point> deadline) {
+  // Interactive requests do not wait for the batch to fill.
+  auto is_ready = [this, min_states]() {
+    return batch_queue_num_states_.load() >= min_states ||
+           interactive_num_states_.load() > 0 || should_finish_inference_;
+  };
+
+  // Requests usually arrive shortly; Spin for a while before parking.
+  for (int i = 0; i < SpinCountBeforePark(1024); i++) {
+    if (is_ready()) {
+      return true;
+    }
+    CpuRelax();
+  }
+
+  std::unique_lock<std::mutex> lk(batch_queue_m_);
+  num_parked_workers_.fetch_add(1);
+
+  bool ready = true;
+  if (deadline) {
+    ready = batch_queue_cv_.wait_until(lk, deadline.value(), is_ready);
+  } else {
+    batch_queue_cv_.wait(lk, is_ready);
+  }
+
+  num_parked_workers_.fetch_sub(1);
+  return ready;
 }
 
 void Evaluator::InferenceWorker(int worker_id) {
+  if (config_->evaluator_intra_op_threads > 0) {
+    torch::set_num_threads(config_->evaluator_intra_op_threads);
+
+    if (config_->pin_evaluator_worker_cores &&
+        !PinCurrentThreadToCores(
+            worker_id * config_->evaluator_intra_op_threads,
+            config_->evaluator_intra_op_threads)) {
+      std::cerr << "Failed to pin inference worker " << worker_id << std::endl;
+    }
+  }
+
+  torch::NoGradGuard no_grad;
+
+  // Where the worker starts looking for the model to inference. Rotates so that
+  // the models with the same # of queued states take turns.
+  int start_model_id = worker_id % NumModels();
+
   while (!should_finish_inference_) {
-    std::unique_lock<std::mutex> lk(batch_queue_m_);
-    batch_queue_cv_.wait(lk, [this]() {
-      return !batch_queue_.empty() || should_finish_inference_;
-    });
+    WaitForRequests(1);
+
+    // Wait a bit more until the batch is large enough.
+    int target_batch_size = 0;
+    {
+      std::lock_guard<std::mutex> lk(batching_policy_m_);
+      target_batch_size = batching_policy_.TargetBatchSize();
+    }
 
-    std::vector<torch::Tensor> batches;
-    std::vector<std::pair</*worker_id=*/int, /*batch_size=*/int>> workers;
+    const auto wait_start = BatchingPolicy::Clock::now();
 
-    batches.reserve(batch_queue_.size());
-    workers.reserve(batch_queue_.size());
-    for (auto [tensor, worker_id] : batch_queue_) {
-      batches.push_back(tensor);
-      workers.push_back(std::make_pair(worker_id, tensor.sizes()[0]));
+    bool reached_target = true;
+    if (batching_policy_.Enabled()) {
+      reached_target = WaitForRequests(
+          target_batch_size, wait_start + batching_policy_.MaxWait());
+    }
+
+    const auto wait_end = BatchingPolicy::Clock::now();
+
+    // Interactive requests go first. The rest of the batch is filled with the
+    // background requests of the same model (if they fit).
+    const InferencePriority priority = interactive_num_states_.load() > 0
+                                           ? InferencePriority::kInteractive
+                                           : InferencePriority::kBackground;
+
+    const int model_id = NextModelToInference(start_model_id, priority);
+    start_model_id = (start_model_id + 1) % NumModels();
+
+    std::vector<std::pair<StagingBuffer*, int>> sealed;
+    int batch_size = 0;
+
+    auto [buffer, buffer_rows] =
+        SealActiveBuffer(&GetModelQueue(model_id, priority), priority);
+    if (buffer != nullptr) {
+      sealed.push_back(std::make_pair(buffer, buffer_rows));
+      batch_size += buffer_rows;
+
+      if (priority == InferencePriority::kInteractive) {
+        auto [background_buffer, background_rows] = SealActiveBuffer(
+            &GetModelQueue(model_id, InferencePriority::kBackground),
+            InferencePriority::kBackground,
+            batching_policy_.MaxBatchSize() - batch_size);
+        if (background_buffer != nullptr) {
+          sealed.push_back(
+              std::make_pair(background_buffer, background_rows));
+          batch_size += background_rows;
+        }
+      }
     }
 
-    batch_queue_.clear();
-    lk.unlock();
+    // Leftovers can be picked up by other parked workers.
+    if (batch_queue_num_states_.load() > 0 && num_parked_workers_.load() > 0) {
+      std::lock_guard<std::mutex> lk(batch_queue_m_);
+      batch_queue_cv_.notify_one();
+    }
 
-    if (batches.empty()) {
+    if (sealed.empty()) {
       continue;
     }
 
-    torch::Tensor batch_tensor = torch::cat(batches).to(config_->device);
+    // Some requesters may be still encoding their rows.
+    for (auto [sealed_buffer, sealed_rows] : sealed) {
+      while (sealed_buffer->written.load(std::memory_order_acquire) <
+             sealed_rows) {
+        std::this_thread::yield();
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lk(batching_policy_m_);
+
+      const uint64_t total_queued_states =
+          total_queued_states_.load(std::memory_order_relaxed);
+      batching_policy_.RecordArrival(total_queued_states -
+                                     last_total_queued_states_);
+      last_total_queued_states_ = total_queued_states;
+
+      batching_policy_.RecordDispatch(wait_end);
+    }
+
+    // On CPU, a single staging buffer is used as is (no copy).
+    torch::Tensor batch_tensor;
+    if (sealed.size() == 1) {
+      batch_tensor = buffer->input.narrow(0, 0, batch_size);
+    } else {
+      std::vector<torch::Tensor> inputs;
+      for (auto [sealed_buffer, sealed_rows] : sealed) {
+        inputs.push_back(sealed_buffer->input.narrow(0, 0, sealed_rows));
+      }
+      batch_tensor = torch::cat(inputs);
+    }
+    batch_tensor = batch_tensor.to(config_->device);
 
     if (worker_manager_ != nullptr) {
-      worker_manager_->GetInferenceWorkerInfo(worker_id)
-          .total_inference_batch_size += batch_tensor.sizes()[0];
-      worker_manager_->GetInferenceWorkerInfo(worker_id).total_num_inference++;
+      auto& info = worker_manager_->GetInferenceWorkerInfo(worker_id);
+      info.total_inference_batch_size += batch_size;
+      info.total_num_inference++;
+
+      if (batching_policy_.Enabled()) {
+        if (reached_target) {
+          info.total_flush_by_target++;
+        } else {
+          info.total_flush_by_deadline++;
+        }
+
+        info.total_batch_wait_us +=
+            std::chrono::duration_cast<std::chrono::microseconds>(wait_end -
+                                                                  wait_start)
+                .count();
+        info.current_target_batch_size = target_batch_size;
+      }
     }
 
-    torch::Tensor value_tensor = chess_net_->GetValue(batch_tensor);
+    const auto forward_start = BatchingPolicy::Clock::now();
 
-    torch::Device device(torch::kCPU);
-    torch::Tensor cpu_tensor = value_tensor.to(device);
+    // Switch to the latest snapshot (if published) between the batches. The
+    // old one is freed when the last worker that runs on it is done.
+    std::shared_ptr<const ModelSnapshot> snapshot = GetSnapshot(model_id);
 
-    int batch_index = 0;
-    for (size_t worker_index = 0; worker_index < workers.size();
-         worker_index++) {
-      auto& worker_info = worker_info_[workers[worker_index].first];
-      worker_info.result.clear();
+    torch::Tensor cpu_tensor;
+    {
+      ReducedPrecisionGuard precision_guard(config_);
+      torch::Tensor value_tensor =
+          snapshot->replicas[worker_id]->GetValue(batch_tensor);
 
-      const int worker_batch_size = workers[worker_index].second;
-      worker_info.result.reserve(worker_batch_size);
+      torch::Device device(torch::kCPU);
+      cpu_tensor = value_tensor.to(device, torch::kFloat);
+    }
 
-      for (int i = 0; i < worker_batch_size; i++) {
-        worker_info.result.push_back(cpu_tensor.data_ptr<float>()[batch_index]);
-        batch_index++;
+    {
+      std::lock_guard<std::mutex> lk(batching_policy_m_);
+      batching_policy_.RecordForwardLatency(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              BatchingPolicy::Clock::now() - forward_start));
+    }
+
+    const float* values = cpu_tensor.data_ptr<float>();
+    for (auto [sealed_buffer, sealed_rows] : sealed) {
+      int row = 0;
+      while (row < sealed_rows) {
+        auto [requester_id, num_rows] = sealed_buffer->reservations[row];
+
+        auto& worker_info = worker_info_[requester_id];
+        worker_info.result.assign(values + row, values + row + num_rows);
+        worker_info.completion.Complete();
+
+        row += num_rows;
       }
 
-      worker_info.result_is_set = true;
-      worker_info.cv_inference.notify_one();
-    }
+      assert(row == sealed_rows);
+      values += sealed_rows;
 
-    assert(batch_index == cpu_tensor.sizes()[0]);
+      ReleaseBuffer(sealed_buffer);
+    }
   }
 }
 
 void Evaluator::StartInferenceWorker() {
-  // TODO Does multiple inference worker work?
+  // Pinned memory makes the host to device copy faster.
+  const int capacity = batching_policy_.MaxBatchSize();
+  auto options = torch::TensorOptions().dtype(torch::kFloat).pinned_memory(
+      config_->device.is_cuda());
+
+  // Queue of each (model, priority); See GetModelQueue().
+  for (int queue_index = 0; queue_index < NumModels() * kNumInferencePriorities;
+       queue_index++) {
+    auto queue = std::make_unique<ModelQueue>();
+    for (int i = 0; i < config_->evaluator_worker_count + 1; i++) {
+      auto buffer = std::make_unique<StagingBuffer>();
+      buffer->input =
+          torch::zeros({capacity, kNumStatePlanes, 8, 8}, options);
+      buffer->reservations.resize(capacity);
+      queue->staging_buffers.push_back(std::move(buffer));
+    }
+
+    // The first buffer accepts the reservations.
+    queue->staging_buffers[0]->reserved.store(0);
+    model_queues_.push_back(std::move(queue));
+  }
+
   for (int i = 0; i < config_->evaluator_worker_count; i++) {
     inference_workers_.push_back(
         std::thread(&Evaluator::InferenceWorker, this, i));
   }
 }
 
+uint64_t Evaluator::PublishModel(int model_id, ChessNN model) {
+  // Sharing a single model across the workers makes them contend on the same
+  // forward, so every worker gets its own replica.
+  auto snapshot = std::make_shared<ModelSnapshot>();
+  for (int i = 0; i < std::max(1, config_->evaluator_worker_count); i++) {
+    snapshot->replicas.push_back(CloneChessNN(model));
+  }
+
+  PublishedModel& published = *published_models_[model_id];
+
+  // The old snapshot is released outside of the lock.
+  std::shared_ptr<const ModelSnapshot> old_snapshot;
+  uint64_t version = 0;
+  {
+    std::lock_guard<std::mutex> lk(published.m);
+    version = published.version.load() + 1;
+    snapshot->version = version;
+
+    old_snapshot = std::move(published.snapshot);
+    published.snapshot = std::move(snapshot);
+    published.version.store(version, std::memory_order_release);
+  }
+
+  return version;
+}
+
+void Evaluator::SyncModelReplicas() {
+  for (int model_id = 0; model_id < NumModels(); model_id++) {
+    if (!models_[model_id].is_empty()) {
+      PublishModel(model_id, models_[model_id]);
+    }
+  }
+}
+
 Evaluator::~Evaluator() {
   should_finish_inference_ = true;
   if (!inference_workers_.empty()) {
     std::cerr << "Deleting evaluators.." << std::endl;
-    batch_queue_cv_.notify_all();
+    {
+      std::lock_guard<std::mutex> lk(batch_queue_m_);
+      batch_queue_cv_.notify_all();
+    }
 
     for (auto& worker : inference_workers_) {
       worker.join();
@@ -4,64 +4,295 @@
 #include <torch/torch.h>
 
 #include <future>
+#include <limits>
+#include <memory>
+#include <optional>
 
+#include "batching_policy.h"
+#include "completion_slot.h"
 #include "config.h"
+#include "eval_cache.h"
 #include "game_state.h"
+#include "inference_priority.h"
 #include "nn/chess_nn.h"
 #include "worker_manager.h"
 
 namespace chess {
 
-struct EvaluatorWorkerInfo {
-  // Condition variable to wait for the inference to finish.
-  std::condition_variable cv_inference;
+// Request of SubmitAsyncBatch() that TakeAsyncBatchResult() collects.
+struct PendingBatch {
+  std::vector<const GameState*> states;
+  int model_id = 0;
+  InferencePriority priority = InferencePriority::kBackground;
+  uint64_t version = 0;
+
+  // Values of the states. is_set[i] is true if the state i needs no inference.
+  std::vector<float> scores;
+  std::vector<bool> is_set;
 
-  // Mutex for cv.
-  std::mutex m_cv;
+  // States that go through the inference worker, # of them sent so far and
+  // the values received so far.
+  std::vector<const GameState*> batch;
+  size_t num_sent = 0;
+  std::vector<float> result;
 
-  // True if the result is set.
-  bool result_is_set = false;
+  // When the chunk in flight was sent.
+  BatchingPolicy::Clock::time_point chunk_start;
+};
+
+struct EvaluatorWorkerInfo {
+  // Completed when the result of the inference is set.
+  CompletionSlot completion;
 
   // Hold the result of the inference.
   std::vector<float> result;
+
+  PendingBatch pending;
+};
+
+// Preallocated input batch of the async inference. Requesters reserve rows of
+// the buffer and encode their states directly into them, so the inference
+// worker can run the forward on the buffer as is.
+struct StagingBuffer {
+  // Set on reserved when the buffer does not accept the reservation.
+  static constexpr uint32_t kSealed = 1u << 31;
+
+  // N * 119 * 8 * 8
+  torch::Tensor input;
+
+  // # of reserved rows (with kSealed bit).
+  std::atomic<uint32_t> reserved = kSealed;
+
+  // # of rows that are encoded by the requesters.
+  std::atomic<int> written = 0;
+
+  // (worker_id, # of rows) of the reservation that starts at each row.
+  std::vector<std::pair<int, int>> reservations;
+
+  // True while the inference worker is running the forward on this buffer.
+  // Guarded by Evaluator::staging_m_.
+  bool in_flight = false;
 };
 
+// Immutable weights of a model published to the Evaluator. Every async worker
+// runs on its own replica, and the snapshot is freed once the last batch that
+// uses it finishes.
+struct ModelSnapshot {
+  // Increases on every publish of the model.
+  uint64_t version = 0;
+
+  // replicas[worker_id]. The sync evaluations use the first replica.
+  std::vector<ChessNN> replicas;
+};
+
+// The latest snapshot of a model.
+struct PublishedModel {
+  std::mutex m;
+  std::shared_ptr<const ModelSnapshot> snapshot;
+
+  // Version of the snapshot. Requesters read this without taking the mutex.
+  std::atomic<uint64_t> version = 0;
+};
+
+// Async requests of a single model and priority.
+struct ModelQueue {
+  // One more staging buffer than the async workers so that there is always a
+  // buffer to accept the reservations while others are in flight.
+  std::vector<std::unique_ptr<StagingBuffer>> staging_buffers;
+  std::atomic<int> active_buffer = 0;
+
+  // # of states reserved in the active staging buffer (or waiting for a
+  // buffer to reserve in).
+  std::atomic<int> num_states = 0;
+};
+
+// Evaluates the game states with one or more models. Every method takes the
+// index of the model (in the order given to the constructor) to use.
 class Evaluator {
  public:
   Evaluator(ChessNN chess_net, const Config* config,
             WorkerManager* worker_manager)
-      : chess_net_(chess_net),
-        config_(config),
-        worker_info_(config_->num_threads),
-        worker_manager_(worker_manager) {}
+      : Evaluator(std::vector<ChessNN>{chess_net}, config, worker_manager) {}
+
+  // Host several models at once. The async workers are shared by the models, so
+  // each model gets fuller batches than it would with its own Evaluator.
+  Evaluator(std::vector<ChessNN> models, const Config* config,
+            WorkerManager* worker_manager);
 
-  virtual float Evalulate(const GameState& board);
+  virtual float Evalulate(const GameState& board, int model_id = 0);
   virtual std::vector<float> EvalulateBatch(
-      std::vector<const GameState*> boards);
+      std::vector<const GameState*> boards, int model_id = 0);
 
   // When used, every other EvaluateAsync that are fired at the similar
   // time will be batched together.
-  virtual float EvaluateAsync(const GameState& state, int worker_id);
+  virtual float EvaluateAsync(
+      const GameState& state, int worker_id, int model_id = 0,
+      InferencePriority priority = InferencePriority::kBackground);
   virtual std::vector<float> EvaluateAsyncBatch(
-      const std::vector<const GameState*>& states, int worker_id);
+      const std::vector<const GameState*>& states, int worker_id,
+      int model_id = 0,
+      InferencePriority priority = InferencePriority::kBackground);
+
+  // Non-blocking version of EvaluateAsyncBatch() (see CoroutineSelfPlay).
+  // Sends the states through the requester slot of worker_id and returns
+  // right away. PollAsyncBatch() returns true once the values are ready, and
+  // TakeAsyncBatchResult() returns them (waiting if not ready yet). A worker id
+  // has at most one batch in flight.
+  virtual void SubmitAsyncBatch(
+      const std::vector<const GameState*>& states, int worker_id,
+      int model_id = 0,
+      InferencePriority priority = InferencePriority::kBackground);
+  virtual bool PollAsyncBatch(int worker_id);
+  virtual std::vector<float> TakeAsyncBatchResult(int worker_id);
+
+  int NumModels() const { return models_.size(); }
+
+  // Worker id reserved for the interactive requester (e.g. the server), which
+  // runs alongside the num_threads self-play workers.
+  int InteractiveWorkerId() const { return config_->num_threads; }
+
+  // Each worker id owns max(mcts_search_threads, coroutine_batches_in_flight)
+  // requester slots, one per search thread of its MCTS (or per batch in flight
+  // of CoroutineSelfPlay). The first search thread uses the worker id itself.
+  int SearchThreadWorkerId(int worker_id, int search_thread) const {
+    return worker_id + search_thread * (config_->num_threads + 1);
+  }
 
   void InferenceWorker(int worker_id);
-  void StartInferenceWorker();
+  virtual void StartInferenceWorker();
+
+  // Copy the current weights of the model into a new snapshot and switch the
+  // model_id th model to it. The workers pick it up from their next batch, so
+  // this can be called while the evaluations are in flight, as long as the
+  // model itself is not being updated. Returns the version of the snapshot.
+  virtual uint64_t PublishModel(int model_id, ChessNN model);
+
+  // Publish every model given to the constructor.
+  void SyncModelReplicas();
+
+  virtual uint64_t ModelVersion(int model_id) const {
+    return published_models_[model_id]->version.load(
+        std::memory_order_acquire);
+  }
+
+  const EvalCache& GetEvalCache() const { return eval_cache_; }
 
   // Join inference worker.
-  ~Evaluator();
+  virtual ~Evaluator();
+
+ protected:
+  // Evaluate the states (which are not terminal) through the inference worker.
+  virtual std::vector<float> EvaluateThroughWorker(
+      const std::vector<const GameState*>& states, int worker_id, int model_id,
+      InferencePriority priority);
 
  private:
-  ChessNN chess_net_;
+  ModelQueue& GetModelQueue(int model_id, InferencePriority priority) {
+    return *model_queues_[model_id * kNumInferencePriorities +
+                          static_cast<int>(priority)];
+  }
+
+  // Fill the values of the states that need no inference (the terminal and the
+  // cached ones) and return the rest.
+  std::vector<const GameState*> FilterKnownStates(
+      const std::vector<const GameState*>& states, int model_id,
+      uint64_t version, std::vector<float>* scores,
+      std::vector<bool>* is_set);
+
+  // Put the result of the inference of the remaining states (see
+  // FilterKnownStates()) into scores and the cache.
+  void MergeInferenceResult(const std::vector<const GameState*>& states,
+                            const std::vector<bool>& is_set,
+                            const std::vector<float>& result, int model_id,
+                            uint64_t version, std::vector<float>* scores);
+
+  // Send the next chunk of the pending batch of the worker to the inference
+  // worker, and collect the result of the chunk that is done.
+  void SendNextChunk(int worker_id);
+  void CollectChunk(int worker_id);
+
+  // Reserve num_rows consecutive rows in the active staging buffer of the
+  // queue. Returns the buffer and the first reserved row. The rows are
+  // counted as queued from here, and SealActiveBuffer() uncounts them.
+  std::pair<StagingBuffer*, int> ReserveRows(ModelQueue* queue,
+                                             InferencePriority priority,
+                                             int num_rows, int worker_id);
+
+  // Mark the reserved rows as written and wake up the parked inference worker
+  // (if any).
+  void SubmitRows(StagingBuffer* buffer, int num_rows);
+
+  // Model that has the most states queued in the given priority. Ties are
+  // broken in the round robin starting from start_model_id.
+  int NextModelToInference(int start_model_id, InferencePriority priority);
+
+  // Stop accepting reservations on the active staging buffer of the queue and
+  // switch to the free one. Returns the sealed buffer and its # of rows. Does
+  // nothing (returns nullptr) if the buffer is empty or has more than max_rows.
+  std::pair<StagingBuffer*, int> SealActiveBuffer(
+      ModelQueue* queue, InferencePriority priority,
+      int max_rows = std::numeric_limits<int>::max());
+
+  // Return the sealed buffer to the free list.
+  void ReleaseBuffer(StagingBuffer* buffer);
+
+  void RecordLatency(InferencePriority priority,
+                     std::chrono::microseconds latency);
+
+  std::shared_ptr<const ModelSnapshot> GetSnapshot(int model_id);
+
+  // Returns the cached value of the state (if any). Values of the different
+  // versions of the model are cached separately.
+  std::optional<float> LookupCache(const GameState& state, int model_id,
+                                   uint64_t version);
+  void InsertCache(const GameState& state, int model_id, uint64_t version,
+                   float value);
+
+  // Wait until at least min_states are queued (or until the deadline). Returns
+  // true if enough states are queued.
+  bool WaitForRequests(
+      int min_states,
+      std::optional<BatchingPolicy::Clock::time_point> deadline = std::nullopt);
+
+  std::vector<ChessNN> models_;
   const Config* config_;
 
+  // Snapshot that is currently used for each model.
+  std::vector<std::unique_ptr<PublishedModel>> published_models_;
+
+  // Shared by the models; The key includes the model id.
+  EvalCache eval_cache_;
+
+  // Queue of each (model, priority).
+  std::vector<std::unique_ptr<ModelQueue>> model_queues_;
+
+  // Taken only by the inference workers when they switch the buffers.
+  std::mutex staging_m_;
+
+  // Total # of states queued (see ModelQueue::num_states) of every model.
+  std::atomic<int> batch_queue_num_states_ = 0;
+
+  // Among them, # of interactive states. Workers stop waiting for the batch to
+  // fill as soon as this is positive.
+  std::atomic<int> interactive_num_states_ = 0;
+
+  // Total # of states ever queued.
+  std::atomic<uint64_t> total_queued_states_ = 0;
+
+  // Inference workers park here only when there is nothing to do for a while;
+  // requesters take the mutex only if some worker is parked.
   std::mutex batch_queue_m_;
   std::condition_variable batch_queue_cv_;
-  std::deque<std::pair<torch::Tensor, int>> batch_queue_;
+  std::atomic<int> num_parked_workers_ = 0;
+
+  // Decides how long the async workers wait for the batch to be filled.
+  std::mutex batching_policy_m_;
+  BatchingPolicy batching_policy_;
+  uint64_t last_total_queued_states_ = 0;
 
   std::vector<EvaluatorWorkerInfo> worker_info_;
 
-  bool should_finish_inference_ = false;
+  std::atomic<bool> should_finish_inference_ = false;
   std::vector<std::thread> inference_workers_;
 
   WorkerManager* worker_manager_;
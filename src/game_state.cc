@@ -88,6 +88,11 @@ GameState::GameState(const Board& board, PieceSide who_is_moving,
       who_is_moving_(who_is_moving),
       prev_state_(nullptr) {}
 
+GameState::GameState(const GameState& state, const GameState* prev_state)
+    : GameState(state) {
+  prev_state_ = prev_state;
+}
+
 GameState::GameState(const GameState* prev_state, Move move)
     : current_board_(prev_state->GetBoard().DoMove(move)),
       last_move_(move),
@@ -342,6 +347,50 @@ bool GameState::IsDraw() const {
   return false;
 }
 
+uint64_t GameState::Hash() const {
+  return hash_.Get([this]() {
+    uint64_t hash = 0;
+
+    const GameState* current = this;
+    for (int i = 0; current && i < 8; i++) {
+      hash = HashCombine(hash, current->GetBoard().Hash());
+      hash = HashCombine(hash, current->RepititionCount());
+      current = current->PrevState();
+    }
+
+    auto [white_oo, white_ooo] = CanWhiteCastle();
+    auto [black_oo, black_ooo] = CanBlackCastle();
+    const uint64_t castle =
+        white_oo | (white_ooo << 1) | (black_oo << 2) | (black_ooo << 3);
+
+    hash = HashCombine(hash, castle);
+    hash = HashCombine(hash, static_cast<uint64_t>(who_is_moving_));
+    hash = HashCombine(hash, total_move_);
+    hash = HashCombine(hash, no_progress_count_);
+
+    return hash;
+  });
+}
+
+uint64_t GameState::PositionHash() const {
+  uint64_t hash = HashCombine(current_board_.Hash(), rep_count_);
+
+  auto [white_oo, white_ooo] = CanWhiteCastle();
+  auto [black_oo, black_ooo] = CanBlackCastle();
+  const uint64_t castle =
+      white_oo | (white_ooo << 1) | (black_oo << 2) | (black_ooo << 3);
+
+  hash = HashCombine(hash, castle);
+  hash = HashCombine(hash, static_cast<uint64_t>(who_is_moving_));
+
+  // The pawn that can be captured en passant.
+  uint64_t en_passant = 0;
+  if (auto pawn = DidPawnMoveTwoSquares(prev_state_, last_move_); pawn) {
+    en_passant = 1 + pawn->first * 8 + pawn->second;
+  }
+  return HashCombine(hash, en_passant);
+}
+
 GameStateSerialized GameState::GetGameStateSerialized() const {
   GameStateSerialized seralized;
 
@@ -39,6 +39,10 @@ class GameState {
 
   GameState(const GameState* prev_state, Move move);
 
+  // Copy of the state that follows prev_state, which should be a copy of
+  // state.PrevState().
+  GameState(const GameState& state, const GameState* prev_state);
+
   const Board& GetBoard() const { return current_board_; }
   const GameState* PrevState() const { return prev_state_; }
   const Move& LastMove() const { return last_move_; }
@@ -59,6 +63,16 @@ class GameState {
 
   GameStateSerialized GetGameStateSerialized() const;
 
+  // Hash of everything that the network sees from this state (last 8 boards
+  // with their repetition counts, castling availability, side to move and the
+  // move counters). Two states with the same hash get the same evaluation.
+  uint64_t Hash() const;
+
+  // Hash of the position alone (the board with its repetition count, castling
+  // availability, side to move and the en passant pawn), which is the same
+  // for the transpositions that are reached by different move orders.
+  uint64_t PositionHash() const;
+
  private:
   // Should be only used by factory.
   GameState(const Board& board, PieceSide who_is_moving, Move last_move);
@@ -93,6 +107,8 @@ class GameState {
 
   // Get legal moves. Once computed, it is cached here.
   mutable LazyGet<std::vector<Move>> legal_moves_;
+
+  mutable LazyGet<uint64_t> hash_;
 };
 
 }  // namespace chess
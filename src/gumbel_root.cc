@@ -0,0 +1,182 @@
+#include "gumbel_root.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace chess {
+namespace {
+
+// Keeps the log of the tiny priors finite.
+constexpr float kMinPrior = 1e-8;
+
+std::vector<float> Softmax(const std::vector<float>& logits) {
+  const float max_logit = *std::max_element(logits.begin(), logits.end());
+
+  std::vector<float> probs;
+  probs.reserve(logits.size());
+
+  float total = 0;
+  for (float logit : logits) {
+    probs.push_back(std::exp(logit - max_logit));
+    total += probs.back();
+  }
+
+  for (float& prob : probs) {
+    prob /= total;
+  }
+  return probs;
+}
+
+}  // namespace
+
+GumbelRoot::GumbelRoot(const MCTSTree& tree, NodeIndex root,
+                       const Params& params, int num_simulations,
+                       std::mt19937* gen)
+    : root_(root), params_(params), num_simulations_(num_simulations) {
+  const NodeIndex first_child = tree.FirstChild(root);
+  const int num_children = tree.NumChildren(root);
+
+  std::extreme_value_distribution<float> gumbel(0, 1);
+  for (int i = 0; i < num_children; i++) {
+    gumbel_.push_back(gumbel(*gen));
+    const float prior = tree.Prior(first_child + i);
+    logit_.push_back(std::log(std::max(prior, kMinPrior)));
+  }
+
+  // Top num_considered children by g + logit.
+  for (int i = 0; i < num_children; i++) {
+    remaining_.push_back(i);
+  }
+  std::sort(remaining_.begin(), remaining_.end(), [this](int a, int b) {
+    return gumbel_[a] + logit_[a] > gumbel_[b] + logit_[b];
+  });
+  remaining_.resize(
+      std::min<int>(std::max(params_.num_considered, 1), num_children));
+
+  num_phases_ = std::max(
+      1, static_cast<int>(std::ceil(std::log2(remaining_.size()))));
+}
+
+NodeIndex GumbelRoot::NextChild(const MCTSTree& tree) {
+  std::lock_guard<std::mutex> lk(m_);
+
+  const int num_remaining = remaining_.size();
+  const int visits_per_child =
+      std::max(1, num_simulations_ / (num_phases_ * num_remaining));
+  if (num_remaining > 1 &&
+      phase_simulations_ >= visits_per_child * num_remaining) {
+    Halve(tree);
+    phase_simulations_ = 0;
+  }
+
+  const int child = remaining_[phase_simulations_ % remaining_.size()];
+  phase_simulations_++;
+
+  return tree.FirstChild(root_) + child;
+}
+
+NodeIndex GumbelRoot::BestChild(const MCTSTree& tree) const {
+  std::lock_guard<std::mutex> lk(m_);
+
+  const std::vector<float> completed_q = CompletedQ(tree);
+  const int best = *std::max_element(
+      remaining_.begin(), remaining_.end(), [&](int a, int b) {
+        return Score(tree, completed_q, a) < Score(tree, completed_q, b);
+      });
+
+  return tree.FirstChild(root_) + best;
+}
+
+std::vector<std::pair<Move, float>> GumbelRoot::ImprovedPolicy(
+    const MCTSTree& tree) const {
+  const NodeIndex first_child = tree.FirstChild(root_);
+  const std::vector<float> completed_q = CompletedQ(tree);
+
+  std::vector<float> logits;
+  logits.reserve(logit_.size());
+  for (size_t i = 0; i < logit_.size(); i++) {
+    logits.push_back(logit_[i] + Sigma(tree, completed_q[i]));
+  }
+
+  const std::vector<float> probs = Softmax(logits);
+
+  std::vector<std::pair<Move, float>> policy;
+  policy.reserve(probs.size());
+  for (size_t i = 0; i < probs.size(); i++) {
+    policy.push_back(std::make_pair(tree.GetMove(first_child + i), probs[i]));
+  }
+  return policy;
+}
+
+std::vector<float> GumbelRoot::CompletedQ(const MCTSTree& tree) const {
+  const NodeIndex first_child = tree.FirstChild(root_);
+  const std::vector<float> prior = Softmax(logit_);
+
+  std::vector<float> q(logit_.size(), 0);
+  std::vector<bool> visited(logit_.size(), false);
+
+  // Q of the children are from the perspective of the root, as is V.
+  float total_visit = 0, visited_prior = 0, weighted_q = 0;
+  for (size_t i = 0; i < q.size(); i++) {
+    const int visit = tree.Visit(first_child + i);
+    if (visit == 0) {
+      continue;
+    }
+
+    q[i] = tree.Q(first_child + i);
+    visited[i] = true;
+
+    total_visit += visit;
+    visited_prior += prior[i];
+    weighted_q += prior[i] * q[i];
+  }
+
+  const float v = tree.Computed(root_) ? tree.V(root_) : 0;
+  float v_mix = v;
+  if (visited_prior > 0) {
+    v_mix = (v + total_visit * weighted_q / visited_prior) / (1 + total_visit);
+  }
+
+  for (size_t i = 0; i < q.size(); i++) {
+    if (!visited[i]) {
+      q[i] = v_mix;
+    }
+  }
+  return q;
+}
+
+float GumbelRoot::Sigma(const MCTSTree& tree, float q) const {
+  const NodeIndex first_child = tree.FirstChild(root_);
+
+  int max_visit = 0;
+  for (size_t i = 0; i < logit_.size(); i++) {
+    max_visit = std::max(max_visit, tree.Visit(first_child + i));
+  }
+
+  return (params_.c_visit + max_visit) * params_.c_scale * (q + 1) / 2;
+}
+
+float GumbelRoot::Score(const MCTSTree& tree,
+                        const std::vector<float>& completed_q, int i) const {
+  return gumbel_[i] + logit_[i] + Sigma(tree, completed_q[i]);
+}
+
+void GumbelRoot::Halve(const MCTSTree& tree) {
+  const std::vector<float> completed_q = CompletedQ(tree);
+
+  std::vector<std::pair<float, int>> scores;
+  scores.reserve(remaining_.size());
+  for (int child : remaining_) {
+    scores.push_back(std::make_pair(Score(tree, completed_q, child), child));
+  }
+
+  std::sort(scores.begin(), scores.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+
+  remaining_.clear();
+  for (size_t i = 0; i < (scores.size() + 1) / 2; i++) {
+    remaining_.push_back(scores[i].second);
+  }
+}
+
+}  // namespace chess
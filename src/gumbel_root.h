@@ -0,0 +1,83 @@
+#ifndef GUMBEL_ROOT_H
+#define GUMBEL_ROOT_H
+
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "mcts_tree.h"
+#include "move.h"
+
+namespace chess {
+
+// Search of the root in the style of Gumbel MuZero, which gives good policies
+// with a few simulations (where PUCT with the noise does not).
+//
+// The top num_considered children of the root by g + logit (g is the Gumbel
+// noise, and the logit is the log of the prior) are searched with the
+// sequential halving: The budget is split into ceil(log2(num_considered))
+// phases, each of which visits the remaining children evenly and then drops
+// the worse half by g + logit + sigma(q). The last one standing is the move.
+//
+//   sigma(q) = (c_visit + max_b N(b)) * c_scale * (q + 1) / 2
+//
+// The unvisited children get the completed Q (see CompletedQ()).
+class GumbelRoot {
+ public:
+  struct Params {
+    int num_considered = 16;
+    float c_visit = 50;
+    float c_scale = 1;
+  };
+
+  // The root must be expanded. num_simulations is the budget of the search.
+  GumbelRoot(const MCTSTree& tree, NodeIndex root, const Params& params,
+             int num_simulations, std::mt19937* gen);
+
+  // The child of the root that the next simulation goes through. Thread safe.
+  NodeIndex NextChild(const MCTSTree& tree);
+
+  // The best child among the remaining ones.
+  NodeIndex BestChild(const MCTSTree& tree) const;
+
+  // softmax(logit + sigma(completed Q)) over every child of the root. This is
+  // the policy target that improves on the prior.
+  std::vector<std::pair<Move, float>> ImprovedPolicy(
+      const MCTSTree& tree) const;
+
+  // Q of each child of the root. Unvisited children get the mix of the value
+  // of the root and the prior weighted Q of the visited ones.
+  std::vector<float> CompletedQ(const MCTSTree& tree) const;
+
+ private:
+  float Sigma(const MCTSTree& tree, float q) const;
+
+  // g + logit + sigma(completed Q) of the i th child.
+  float Score(const MCTSTree& tree, const std::vector<float>& completed_q,
+              int i) const;
+
+  // Keep the better half of the remaining children.
+  void Halve(const MCTSTree& tree);
+
+  NodeIndex root_;
+  Params params_;
+  int num_simulations_;
+  int num_phases_;
+
+  // Of every child of the root.
+  std::vector<float> gumbel_;
+  std::vector<float> logit_;
+
+  mutable std::mutex m_;
+
+  // Indices (from the first child) of the remaining children.
+  std::vector<int> remaining_;
+
+  // Simulations of the current phase so far.
+  int phase_simulations_ = 0;
+};
+
+}  // namespace chess
+
+#endif
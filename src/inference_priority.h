@@ -0,0 +1,16 @@
+#ifndef INFERENCE_PRIORITY_H
+#define INFERENCE_PRIORITY_H
+
+namespace chess {
+
+// Priority class of the inference request. Interactive requests (e.g. the
+// moves of the server games) are latency sensitive; They are inferenced as soon
+// as they arrive, ahead of the background requests (e.g. the self-play) which
+// only care about the throughput.
+enum class InferencePriority { kBackground = 0, kInteractive = 1 };
+
+constexpr int kNumInferencePriorities = 2;
+
+}  // namespace chess
+
+#endif
@@ -3,6 +3,10 @@
 #include <absl/strings/str_join.h>
 #include <fmt/ranges.h>
 
+#include <algorithm>
+#include <functional>
+#include <thread>
+
 #include "nn/nn_util.h"
 
 namespace chess {
@@ -13,25 +17,28 @@ float ComputePrior(float p_a, float dirchlet) {
   return 0.75 * p_a + 0.25 * dirchlet;
 }
 
-std::vector<std::vector<const GameState*>> CreateBatches(MCTSNode* node,
-                                                         size_t batch_size,
-                                                         size_t total_baches) {
-  std::vector<std::vector<const GameState*>> batches;
+std::vector<std::vector<NodeIndex>> CreateBatches(const MCTSTree& tree,
+                                                   NodeIndex node,
+                                                   size_t batch_size,
+                                                   size_t total_baches) {
+  std::vector<std::vector<NodeIndex>> batches;
   size_t current_batch_num = 0;
+  const NodeIndex first_child = tree.FirstChild(node);
+  const size_t num_children = tree.NumChildren(node);
   size_t child_index = 0;
 
   while (current_batch_num < total_baches) {
     batches.emplace_back();
 
-    std::vector<const GameState*>& batch = batches.back();
+    std::vector<NodeIndex>& batch = batches.back();
     while (batches.back().size() < batch_size) {
-      if (child_index >= node->Children().size()) {
+      if (child_index >= num_children) {
         return batches;
       }
 
       // Only add ones that are not computed to the batch.
-      if (!node->Children()[child_index].first->Computed()) {
-        batch.push_back(&node->Children()[child_index].first->State());
+      if (!tree.Computed(first_child + child_index)) {
+        batch.push_back(first_child + child_index);
       }
 
       child_index++;
@@ -41,231 +48,537 @@ std::vector<std::vector<const GameState*>> CreateBatches(MCTSNode* node,
   return batches;
 }
 
-void PreComputeBatches(
-    MCTSNode* current, Evaluator* evaluator,
-    const std::vector<std::vector<const GameState*>>& batches) {
-  size_t child_index = 0;
-  size_t batch_index = 0;
-
-  while (batch_index < batches.size()) {
-    std::vector<float> values = evaluator->EvalulateBatch(batches[batch_index]);
-
-    size_t i = 0;
-    while (i < values.size()) {
-      if (current->Children()[child_index].first->Computed()) {
-        child_index++;
-        continue;
-      }
-
-      current->Children()[child_index].first->SetValueOfThisState(values[i]);
-      i++;
-      child_index++;
+// The other search threads may compute some of the nodes meanwhile; They get
+// the same value again.
+void PreComputeBatches(Evaluator* evaluator, int model_id, MCTSTree* tree,
+                       const std::vector<std::vector<NodeIndex>>& batches) {
+  for (const auto& batch : batches) {
+    std::vector<const GameState*> states;
+    states.reserve(batch.size());
+    for (NodeIndex node : batch) {
+      states.push_back(&tree->MaterializeState(node));
     }
 
-    batch_index++;
+    std::vector<float> values = evaluator->EvalulateBatch(states, model_id);
+    for (size_t i = 0; i < values.size(); i++) {
+      tree->SetValueOfThisState(batch[i], values[i]);
+    }
   }
 }
 
 }  // namespace
 
 MCTS::MCTS(const GameState* state, Evaluator* evaluator, Distribution* dist,
-           Config* config, int worker_id)
-    : evaluator_(evaluator),
+           Config* config, int worker_id, int model_id,
+           InferencePriority priority)
+    : arena_(std::make_unique<SearchArena>(config->mcts_arena_huge_pages)),
+      spare_arena_(
+          std::make_unique<SearchArena>(config->mcts_arena_huge_pages)),
+      evaluator_(evaluator),
       dist_(dist),
       config_(config),
-      worker_id_(worker_id) {
-  nodes_.push_back(std::make_unique<MCTSNode>(
-      std::make_unique<GameState>(*state), /*parent=*/nullptr, /*prior=*/1));
+      worker_id_(worker_id),
+      model_id_(model_id),
+      priority_(priority) {
+  Reset(state);
+}
 
-  root_ = nodes_.back().get();
+void MCTS::Reset(const GameState* state) {
+  tree_.reset();
+  arena_->Reset();
+  previous_root_states_.clear();
+
+  tree_ = std::make_unique<MCTSTree>(config_->mcts_virtual_loss, arena_.get());
+  root_ = tree_->CreateRoot(*state);
+  root_source_ = state;
+  current_iter_ = 0;
+  controller_.reset();
+  gumbel_.reset();
+  transpositions_.Clear();
 }
 
-// Run selection - eval - expand - backup once.
-void MCTS::RunMCTS() {
-  if (config_->do_batch_mcts) {
-    DoBatchRun();
+void MCTS::EndGame() { root_source_ = nullptr; }
+
+void MCTS::ReRoot(const Move& move) {
+  NodeIndex new_root = kNoNode;
+  const NodeIndex first_child = tree_->FirstChild(root_);
+  for (int i = 0; i < tree_->NumChildren(root_); i++) {
+    if (tree_->GetMove(first_child + i) == move) {
+      new_root = first_child + i;
+      break;
+    }
+  }
+
+  // The state of the new root refers to the one of the old root.
+  previous_root_states_.push_back(
+      std::make_unique<GameState>(tree_->State(root_)));
+  const GameState* old_root_state = previous_root_states_.back().get();
+
+  // Only the kept subtree is copied to the tree in the spare arena, so that
+  // the rest is dropped at once by resetting the current arena.
+  auto tree = std::make_unique<MCTSTree>(config_->mcts_virtual_loss,
+                                         spare_arena_.get());
+  if (new_root == kNoNode) {
+    // The root was not expanded yet.
+    root_ = tree->CreateRoot(GameState(old_root_state, move));
   } else {
-    DoSingleRun();
-  }
-}
-
-void MCTS::DoBatchRun() {
-  const int batch_leaf_size = config_->mcts_batch_leaf_node_size;
-  while (current_iter_ < config_->num_mcts_iteration) {
-    std::vector<MCTSNode*> batch_leaf_nodes;
-    batch_leaf_nodes.reserve(batch_leaf_size);
-
-    int current_batch_count = 0;
-    while (current_batch_count < batch_leaf_size &&
-           current_iter_ < config_->num_mcts_iteration) {
-      MCTSNode* leaf = Select();
-
-      Expand(leaf);
-
-      // If the leaf node is already computed, then no need to use the virtual
-      // loss.
-      if (leaf->Computed()) {
-        // Evaluate the current position from the perspective of the current
-        // player of leaf. If it is good, then it means it is bad for the
-        // previous player. So when we backpropagate, we alternate the sign of
-        // q.
-        float q = Evaluate(leaf);
-        leaf->SetValueOfThisState(q);
-
-        Backup(leaf);
-      } else {
-        // If the node is not computed yet, then we add to the batch_nodes and
-        // specify the virtual loss instead.
-        BackupVirtual(leaf, config_->mcts_virtual_loss);
-        batch_leaf_nodes.push_back(leaf);
-        current_batch_count++;
-      }
+    tree_->MaterializeState(new_root);
+    root_ = tree_->CopySubtreeTo(new_root, tree.get(), old_root_state);
+  }
+
+  tree_ = std::move(tree);
+  arena_->Reset();
+  std::swap(arena_, spare_arena_);
+
+  // Same priors as the fresh MCTS of the new root would give.
+  tree_->SetPrior(root_, 1);
+
+  const NodeIndex new_first_child = tree_->FirstChild(root_);
+  const int num_children = tree_->NumChildren(root_);
+  std::vector<float> dist = dist_->GetDistribution(num_children);
+  for (int i = 0; i < num_children; i++) {
+    tree_->SetPrior(new_first_child + i,
+                    ComputePrior(tree_->Prior(root_), dist[i]));
+  }
+
+  root_source_ = nullptr;
+  current_iter_ = 0;
+  controller_.reset();
+  gumbel_.reset();
+  transpositions_.Clear();
+}
 
-      current_iter_++;
+bool MCTS::AdvanceTo(const GameState& state) {
+  if (root_source_ == nullptr) {
+    return false;
+  }
+
+  std::vector<Move> moves;
+  const GameState* current = &state;
+  while (current != root_source_) {
+    if (current == nullptr) {
+      return false;
     }
 
-    if (!batch_leaf_nodes.empty()) {
-      std::vector<const GameState*> states;
-      states.reserve(batch_leaf_nodes.size());
+    moves.push_back(current->LastMove());
+    current = current->PrevState();
+  }
 
-      for (MCTSNode* leaf_node : batch_leaf_nodes) {
-        states.push_back(&leaf_node->State());
-      }
+  for (auto it = moves.rbegin(); it != moves.rend(); it++) {
+    ReRoot(*it);
+  }
 
-      std::vector<float> q_s;
-      if (config_->use_async_inference) {
-        q_s = evaluator_->EvaluateAsyncBatch(states, worker_id_);
-      } else {
-        q_s = evaluator_->EvalulateBatch(states);
-      }
+  root_source_ = &state;
+  current_iter_ = 0;
+  controller_.reset();
+  return true;
+}
+
+void MCTS::RunMCTS() { RunMCTS(SearchLimits::FromConfig(*config_)); }
+
+// Run selection - eval - expand - backup until the controller stops.
+void MCTS::RunMCTS(const SearchLimits& limits) {
+  SearchController controller(limits, current_iter_);
+  num_batch_leaves_ = 0;
+  num_collisions_ = 0;
+  num_transposed_visits_ = 0;
+  BeginGumbelRoot(limits);
+
+  if (config_->mcts_search_threads > 1) {
+    DoParallelRun(controller);
+  } else if (config_->do_batch_mcts) {
+    DoBatchRun(controller);
+  } else {
+    DoSingleRun(controller);
+  }
+}
+
+bool MCTS::ShouldStop(const SearchController& controller,
+                      int iteration) const {
+  return controller.ShouldStop(iteration, *tree_, root_);
+}
+
+void MCTS::DoParallelRun(const SearchController& controller) {
+  // Every search would collide on the root until it is expanded.
+  if (!tree_->Expanded(root_) && !ShouldStop(controller, current_iter_)) {
+    NodeIndex leaf = Select();
+    Expand(leaf);
+    tree_->SetValueOfThisState(leaf, Evaluate(leaf, worker_id_));
+    Backup(leaf);
+    current_iter_++;
+  }
+
+  std::vector<std::thread> search_threads;
+  for (int i = 1; i < config_->mcts_search_threads; i++) {
+    search_threads.push_back(std::thread(
+        &MCTS::DoParallelSearch, this, std::cref(controller),
+        evaluator_->SearchThreadWorkerId(worker_id_, i)));
+  }
+
+  DoParallelSearch(controller, worker_id_);
 
-      for (size_t i = 0; i < q_s.size(); i++) {
-        batch_leaf_nodes[i]->SetValueOfThisState(q_s[i]);
-        Backup(batch_leaf_nodes[i]);
-        ClearVirtual(batch_leaf_nodes[i]);
+  for (auto& thread : search_threads) {
+    thread.join();
+  }
+}
+
+void MCTS::DoParallelSearch(const SearchController& controller,
+                            int search_worker_id) {
+  torch::NoGradGuard no_grad;
+
+  while (!ShouldStop(controller, current_iter_.fetch_add(1))) {
+    // The virtual loss steers the other threads away from this path while the
+    // leaf is evaluated.
+    NodeIndex leaf = Select();
+    BackupVirtual(leaf);
+
+    // If another thread is expanding the leaf, this just evaluates it again.
+    Expand(leaf);
+
+    float q = Evaluate(leaf, search_worker_id);
+    tree_->SetValueOfThisState(leaf, q);
+
+    RemoveVirtual(leaf);
+    Backup(leaf);
+  }
+
+  // The iteration that was claimed to be stopped is not run.
+  current_iter_--;
+}
+
+void MCTS::DoBatchRun(const SearchController& controller) {
+  while (!ShouldStop(controller, current_iter_)) {
+    std::vector<NodeIndex> batch_leaf_nodes =
+        CollectLeaves(controller, config_->mcts_batch_leaf_node_size,
+                      /*precompute_children=*/true);
+    if (batch_leaf_nodes.empty()) {
+      continue;
+    }
+
+    std::vector<const GameState*> states;
+    states.reserve(batch_leaf_nodes.size());
+
+    for (NodeIndex leaf_node : batch_leaf_nodes) {
+      states.push_back(&tree_->State(leaf_node));
+    }
+
+    std::vector<float> q_s;
+    if (config_->use_async_inference) {
+      q_s = evaluator_->EvaluateAsyncBatch(states, worker_id_, model_id_,
+                                           priority_);
+    } else {
+      q_s = evaluator_->EvalulateBatch(states, model_id_);
+    }
+
+    ApplyValues(batch_leaf_nodes, q_s);
+  }
+}
+
+std::vector<NodeIndex> MCTS::CollectLeaves(const SearchController& controller,
+                                           int max_leaves,
+                                           bool precompute_children) {
+  std::vector<NodeIndex> batch_leaf_nodes;
+  batch_leaf_nodes.reserve(max_leaves);
+
+  // Leaves that were selected again while they wait for the evaluation.
+  std::vector<NodeIndex> collisions;
+
+  while (static_cast<int>(batch_leaf_nodes.size()) < max_leaves &&
+         !ShouldStop(controller, current_iter_)) {
+    NodeIndex leaf = Select();
+
+    if (!tree_->Computed(leaf) && tree_->VirtualVisit(leaf) > 0) {
+      // Another virtual visit steers the next selection away from the leaf.
+      // It is not an iteration, and is undone once the batch is collected.
+      BackupVirtual(leaf);
+      collisions.push_back(leaf);
+      if (static_cast<int>(collisions.size()) >
+          config_->mcts_max_batch_collisions) {
+        break;
       }
+      continue;
+    }
+
+    Expand(leaf, precompute_children);
+
+    // If the leaf node is already computed, then no need to use the virtual
+    // loss.
+    if (tree_->Computed(leaf)) {
+      // Evaluate the current position from the perspective of the current
+      // player of leaf. If it is good, then it means it is bad for the
+      // previous player. So when we backpropagate, we alternate the sign of
+      // q.
+      float q = Evaluate(leaf, worker_id_);
+      tree_->SetValueOfThisState(leaf, q);
+
+      Backup(leaf);
+    } else {
+      // If the node is not computed yet, then we add to the batch_nodes and
+      // specify the virtual loss instead.
+      BackupVirtual(leaf);
+      batch_leaf_nodes.push_back(leaf);
     }
+
+    current_iter_++;
+  }
+
+  for (NodeIndex leaf : collisions) {
+    RemoveVirtual(leaf);
+  }
+
+  num_batch_leaves_ += batch_leaf_nodes.size();
+  num_collisions_ += collisions.size();
+
+  return batch_leaf_nodes;
+}
+
+void MCTS::ApplyValues(const std::vector<NodeIndex>& leaves,
+                       const std::vector<float>& values) {
+  for (size_t i = 0; i < values.size(); i++) {
+    tree_->SetValueOfThisState(leaves[i], values[i]);
+    Backup(leaves[i]);
+
+    // Only the virtual visits of this leaf; The other leaves of the batch may
+    // share the path.
+    RemoveVirtual(leaves[i]);
   }
 }
 
-void MCTS::DoSingleRun() {
-  for (; current_iter_ < config_->num_mcts_iteration; current_iter_++) {
-    MCTSNode* leaf = Select();
+float MCTS::CollisionRate() const {
+  const int64_t num_selections = num_batch_leaves_ + num_collisions_;
+  return num_selections == 0
+             ? 0
+             : static_cast<float>(num_collisions_) / num_selections;
+}
+
+void MCTS::BeginSearch(const SearchLimits& limits) {
+  controller_.emplace(limits, current_iter_);
+  num_batch_leaves_ = 0;
+  num_collisions_ = 0;
+  num_transposed_visits_ = 0;
+  BeginGumbelRoot(limits);
+}
+
+void MCTS::BeginGumbelRoot(const SearchLimits& limits) {
+  gumbel_.reset();
+  if (!config_->mcts_gumbel_root) {
+    return;
+  }
+
+  gumbel_simulations_ = std::max(1, limits.num_iterations - current_iter_);
+
+  // Otherwise it is created when the root is expanded.
+  if (tree_->Expanded(root_)) {
+    std::lock_guard<std::mutex> lk(expand_m_);
+    CreateGumbelRoot();
+  }
+}
+
+void MCTS::CreateGumbelRoot() {
+  if (tree_->NumChildren(root_) == 0) {
+    return;
+  }
+
+  GumbelRoot::Params params;
+  params.num_considered = config_->mcts_gumbel_num_considered;
+  params.c_visit = config_->mcts_gumbel_c_visit;
+  params.c_scale = config_->mcts_gumbel_c_scale;
+
+  gumbel_ = std::make_unique<GumbelRoot>(*tree_, root_, params,
+                                         gumbel_simulations_,
+                                         &config_->rand_gen);
+}
+
+std::vector<NodeIndex> MCTS::CollectLeaves(int max_leaves) {
+  // The children are batched with the leaves of the other trees instead of
+  // being precomputed on their own.
+  return CollectLeaves(*controller_, max_leaves,
+                       /*precompute_children=*/false);
+}
+
+bool MCTS::SearchDone() const {
+  return !controller_.has_value() || ShouldStop(*controller_, current_iter_);
+}
+
+void MCTS::DoSingleRun(const SearchController& controller) {
+  for (; !ShouldStop(controller, current_iter_); current_iter_++) {
+    NodeIndex leaf = Select();
 
     Expand(leaf);
 
     // Evaluate the current position from the perspective of the current player
     // of leaf. If it is good, then it means it is bad for the previous player.
     // So when we backpropagate, we alternate the sign of q.
-    float q = Evaluate(leaf);
-    leaf->SetValueOfThisState(q);
+    float q = Evaluate(leaf, worker_id_);
+    tree_->SetValueOfThisState(leaf, q);
 
     Backup(leaf);
   }
 }
 
 // Select the leaf node to expand.
-MCTSNode* MCTS::Select() {
-  MCTSNode* current = root_;
+NodeIndex MCTS::Select() {
+  NodeIndex current = root_;
 
-  // Find the leaf node.
+  // The Gumbel root chooses the child of the root by itself.
+  if (tree_->Expanded(root_) && gumbel_ != nullptr) {
+    current = gumbel_->NextChild(*tree_);
+  }
+
+  // Find the leaf node. Nodes that are being expanded by the other search
+  // threads are also leaves, and so are the proven ones (their value is exact,
+  // so there is nothing to search below).
   while (true) {
-    if (current->Children().empty()) {
+    if (!tree_->Expanded(current) || tree_->NumChildren(current) == 0 ||
+        tree_->Proven(current) != ProvenValue::kUnknown) {
       break;
     }
 
-    // If not empty, then find the one with the largest Q + U.
-    MCTSNode* max_elem = nullptr;
-    float max_score = -10000000;
-
-    for (auto& [node, action] : current->Children()) {
-      if (node->Visit() == 0) {
-        max_elem = node;
-        break;
-      }
-
-      // Compute Q(s,a) + U(s,a). Note that the state "node" represents is s',
-      // not s.
-      float q_plus_u = node->PUCT(current->Visit()) + node->Q();
-      if (max_elem == nullptr || q_plus_u > max_score) {
-        max_elem = node;
-        max_score = q_plus_u;
-      }
-    }
-
-    current = max_elem;
+    // If not empty, then find the one with the largest Q + U. The children are
+    // contiguous in the tree, so this is a vectorized scan.
+    current = tree_->SelectChild(current);
   }
 
+  // States of the children are created only when the selection reaches them.
+  tree_->MaterializeState(current);
   return current;
 }
 
-void MCTS::Expand(MCTSNode* node) {
+void MCTS::Expand(NodeIndex node, bool precompute_children) {
+  // Only one search thread expands the node.
+  if (!tree_->TryStartExpansion(node)) {
+    return;
+  }
+
   // Expand the node by adding the child (node, actions).
-  const GameState& state = node->State();
+  const GameState& state = tree_->State(node);
 
   // If current state is draw, then it is over.
   if (state.IsDraw()) {
+    if (config_->mcts_solver) {
+      tree_->SetProven(node, ProvenValue::kDraw);
+    }
+    tree_->FinishExpansion(node);
     return;
   }
 
+  // Only the moves are stored; The states of the children are materialized
+  // when they are selected (or precomputed).
   std::vector<Move> possible_moves = state.GetLegalMoves();
-  std::vector<float> dist = dist_->GetDistribution(possible_moves.size());
 
-  for (size_t i = 0; i < possible_moves.size(); i++) {
-    const Move& move = possible_moves[i];
-    float noise = dist[i];
+  // Checkmate (the stalemate is a draw above).
+  if (possible_moves.empty() && config_->mcts_solver) {
+    tree_->SetProven(node, ProvenValue::kLoss);
+    tree_->FinishExpansion(node);
+    return;
+  }
+
+  if (config_->mcts_transpositions && Transpose(node)) {
+    tree_->AbortExpansion(node);
+    return;
+  }
+
+  {
+    // The distribution, the random generator and the allocation of the tree
+    // are shared by the search threads.
+    std::lock_guard<std::mutex> lk(expand_m_);
+
+    // Shuffle the ordering of the child node visit (for the randomization).
+    std::shuffle(possible_moves.begin(), possible_moves.end(),
+                 config_->rand_gen);
+
+    std::vector<float> dist = dist_->GetDistribution(possible_moves.size());
+
+    std::vector<float> priors;
+    priors.reserve(possible_moves.size());
+    for (size_t i = 0; i < possible_moves.size(); i++) {
+      priors.push_back(ComputePrior(tree_->Prior(node), dist[i]));
+    }
+
+    tree_->AddChildren(node, possible_moves, priors);
 
-    nodes_.push_back(
-        std::make_unique<MCTSNode>(std::make_unique<GameState>(&state, move),
-                                   node, ComputePrior(node->Prior(), noise)));
-    node->AddChildNode(nodes_.back().get(), move);
+    if (node == root_ && config_->mcts_gumbel_root) {
+      CreateGumbelRoot();
+    }
   }
 
-  // Shuffle the ordering of the child node visit (for the randomization).
-  std::shuffle(node->Children().begin(), node->Children().end(),
-               config_->rand_gen);
+  tree_->FinishExpansion(node);
+
+  if (!precompute_children) {
+    return;
+  }
 
   // For the root node, evey child will be visited anyway. So we just batch run
   // every nodes.
   if (root_ == node) {
-    std::vector<std::vector<const GameState*>> batches = CreateBatches(
-        node, config_->mcts_inference_batch_size, possible_moves.size());
-    PreComputeBatches(node, evaluator_, batches);
-  } else if (node->Parent()->Visit() >=
+    std::vector<std::vector<NodeIndex>> batches =
+        CreateBatches(*tree_, node, config_->mcts_inference_batch_size,
+                      possible_moves.size());
+    PreComputeBatches(evaluator_, model_id_, tree_.get(), batches);
+  } else if (tree_->Visit(tree_->Parent(node)) >=
              config_->precompute_batch_parent_min_visit_count) {
     // If the parent was visited more than 2 times before, then it is likely
     // that every child node of this parent will get visited too. Hence let's
     // just precompute all the values of child.
-    std::vector<std::vector<const GameState*>> batches =
-        CreateBatches(node->Parent(), config_->mcts_inference_batch_size,
+    std::vector<std::vector<NodeIndex>> batches =
+        CreateBatches(*tree_, tree_->Parent(node),
+                      config_->mcts_inference_batch_size,
                       config_->mcts_inference_batch_size);
-    PreComputeBatches(node->Parent(), evaluator_, batches);
+    PreComputeBatches(evaluator_, model_id_, tree_.get(), batches);
   }
 }
 
-float MCTS::Evaluate(const MCTSNode* node) {
-  if (node->Computed()) {
-    return node->V();
+bool MCTS::Transpose(NodeIndex node) {
+  const NodeIndex transposition =
+      transpositions_.FindOrInsert(tree_->State(node).PositionHash(), node);
+  if (transposition == node || node == root_ ||
+      !tree_->Computed(transposition)) {
+    return false;
+  }
+
+  auto num_visit = [this](NodeIndex n) {
+    return tree_->Visit(n) - tree_->VirtualVisit(n);
+  };
+
+  if (num_visit(node) >= num_visit(transposition)) {
+    // Searched on its own from now on, but the position is evaluated already.
+    if (!tree_->Computed(node)) {
+      tree_->SetValueOfThisState(node, tree_->V(transposition));
+    }
+    return false;
+  }
+
+  tree_->SetValueOfThisState(node, tree_->MeanValue(transposition));
+  num_transposed_visits_++;
+  return true;
+}
+
+float MCTS::Evaluate(NodeIndex node, int worker_id) {
+  if (tree_->Computed(node)) {
+    return tree_->V(node);
   }
 
   if (config_->use_async_inference) {
-    return evaluator_->EvaluateAsync(node->State(), worker_id_);
+    return evaluator_->EvaluateAsync(tree_->State(node), worker_id, model_id_,
+                                     priority_);
   }
 
   // std::cout << "Evaluating " << std::endl;
-  return evaluator_->Evalulate(node->State());
+  return evaluator_->Evalulate(tree_->State(node), model_id_);
 }
 
-void MCTS::Backup(MCTSNode* leaf_node) {
+void MCTS::Backup(NodeIndex leaf_node) {
+  Prove(leaf_node);
+
   // Negate the value estimate as this is measured from the perspective of
   // curret node's player. However, Q(s,a) is computed from the perspective of
   // previous player. So we simply negate the value.
-  float q = -leaf_node->V();
-  MCTSNode* current = leaf_node;
+  float q = -tree_->V(leaf_node);
+  NodeIndex current = leaf_node;
 
-  while (current) {
-    current->UpdateQ(q);
-    current = current->Parent();
+  while (current != kNoNode) {
+    tree_->UpdateQ(current, q);
+    current = tree_->Parent(current);
 
     // Since the player alternates by the state, we have to negate the sign
     // every time.
@@ -273,38 +586,71 @@ void MCTS::Backup(MCTSNode* leaf_node) {
   }
 }
 
-void MCTS::ClearVirtual(MCTSNode* leaf_node) {
-  MCTSNode* current = leaf_node;
-  while (current) {
-    current->ClearVirtualLoss();
-    current = current->Parent();
+void MCTS::Prove(NodeIndex node) {
+  while (tree_->Proven(node) != ProvenValue::kUnknown) {
+    node = tree_->Parent(node);
+    if (node == kNoNode || tree_->Proven(node) != ProvenValue::kUnknown) {
+      return;
+    }
+
+    const ProvenValue value = tree_->ProveFromChildren(node);
+    if (value == ProvenValue::kUnknown) {
+      return;
+    }
+    tree_->SetProven(node, value);
+  }
+}
+
+void MCTS::RemoveVirtual(NodeIndex leaf_node) {
+  NodeIndex current = leaf_node;
+  while (current != kNoNode) {
+    tree_->RemoveVirtualLoss(current);
+    current = tree_->Parent(current);
   }
 }
 
-void MCTS::BackupVirtual(MCTSNode* leaf_node, float virtual_loss) {
+void MCTS::BackupVirtual(NodeIndex leaf_node) {
   // Virtual loss is added so that the same path is not visited again during the
   // batch MCTS.
-  MCTSNode* current = leaf_node;
+  NodeIndex current = leaf_node;
 
-  while (current) {
-    current->AddVirtualLoss(virtual_loss);
-    current = current->Parent();
+  while (current != kNoNode) {
+    tree_->AddVirtualLoss(current);
+    current = tree_->Parent(current);
   }
 }
 
 torch::Tensor MCTS::GetPolicyVector() const {
+  if (gumbel_ != nullptr) {
+    return MoveToTensor(gumbel_->ImprovedPolicy(*tree_)).flatten(0);
+  }
+
+  const NodeIndex first_child = tree_->FirstChild(root_);
+  const int num_children = tree_->NumChildren(root_);
+
   std::vector<std::pair<Move, float>> move_and_prob;
-  move_and_prob.reserve(root_->Children().size());
+  move_and_prob.reserve(num_children);
 
   float total_visit = 0;
-  for (const auto& [child_node, move] : root_->Children()) {
-    move_and_prob.push_back(std::make_pair(move, child_node->Visit()));
-    total_visit += child_node->Visit();
+  for (NodeIndex child = first_child; child < first_child + num_children;
+       child++) {
+    total_visit += tree_->Visit(child);
   }
 
-  // Now we normalize the visit count.
+  // If no child is visited (e.g. the search ran a single iteration), the priors
+  // are the policy instead.
+  float total = 0;
+  for (NodeIndex child = first_child; child < first_child + num_children;
+       child++) {
+    const float weight =
+        total_visit > 0 ? tree_->Visit(child) : tree_->Prior(child);
+    move_and_prob.push_back(std::make_pair(tree_->GetMove(child), weight));
+    total += weight;
+  }
+
+  // Now we normalize the visit count (or the priors).
   for (auto& [move, prob] : move_and_prob) {
-    prob = prob / total_visit;
+    prob = prob / total;
   }
 
   torch::Tensor policy = MoveToTensor(move_and_prob);
@@ -314,21 +660,51 @@ torch::Tensor MCTS::GetPolicyVector() const {
 }
 
 Move MCTS::MoveToMake(bool choose_best_move) const {
+  const NodeIndex first_child = tree_->FirstChild(root_);
+  const NodeIndex last_child = first_child + tree_->NumChildren(root_);
+
+  // A proven win is played no matter how it was visited.
+  for (NodeIndex child = first_child; child < last_child; child++) {
+    if (tree_->Proven(child) == ProvenValue::kLoss) {
+      return tree_->GetMove(child);
+    }
+  }
+
+  if (gumbel_ != nullptr) {
+    return tree_->GetMove(gumbel_->BestChild(*tree_));
+  }
+
+  // Proven losses are avoided while any visited move is not one.
+  bool avoid_losses = false;
+  for (NodeIndex child = first_child; child < last_child; child++) {
+    if (tree_->Proven(child) != ProvenValue::kWin && tree_->Visit(child) > 0) {
+      avoid_losses = true;
+      break;
+    }
+  }
+  auto skip = [&](NodeIndex child) {
+    return avoid_losses && tree_->Proven(child) == ProvenValue::kWin;
+  };
+
   if (choose_best_move) {
     std::optional<Move> best_move;
 
     int max_visit = 0;
     float max_value = -1000;
 
-    for (const auto& [child_node, move] : root_->Children()) {
-      if (child_node->Visit() == max_visit) {
-        if (child_node->Q() >= max_value) {
-          best_move = move;
-          max_value = child_node->Q();
+    for (NodeIndex child = first_child; child < last_child; child++) {
+      if (skip(child)) {
+        continue;
+      }
+
+      if (tree_->Visit(child) == max_visit) {
+        if (tree_->Q(child) >= max_value) {
+          best_move = tree_->GetMove(child);
+          max_value = tree_->Q(child);
         }
-      } else if (child_node->Visit() > max_visit) {
-        max_visit = child_node->Visit();
-        best_move = move;
+      } else if (tree_->Visit(child) > max_visit) {
+        max_visit = tree_->Visit(child);
+        best_move = tree_->GetMove(child);
       }
     }
 
@@ -337,9 +713,19 @@ Move MCTS::MoveToMake(bool choose_best_move) const {
 
   int current_count = 0;
   std::vector<std::pair<Move, int>> move_and_cumulative_count;
-  for (const auto& [child_node, move] : root_->Children()) {
-    current_count += child_node->Visit();
-    move_and_cumulative_count.push_back(std::make_pair(move, current_count));
+  for (NodeIndex child = first_child; child < last_child; child++) {
+    if (skip(child)) {
+      continue;
+    }
+
+    current_count += tree_->Visit(child);
+    move_and_cumulative_count.push_back(
+        std::make_pair(tree_->GetMove(child), current_count));
+  }
+
+  // Nothing to sample from if no child is visited.
+  if (current_count == 0) {
+    return MoveToMake(/*choose_best_move=*/true);
   }
 
   std::uniform_int_distribution<> distrib(0, current_count - 1);
@@ -355,35 +741,42 @@ Move MCTS::MoveToMake(bool choose_best_move) const {
   return move_and_cumulative_count[0].first;
 }
 
-void MCTS::ShowPath(MCTSNode* node) const {
-  std::vector<MCTSNode*> path;
+void MCTS::ShowPath(NodeIndex node) const {
+  std::vector<NodeIndex> path;
 
-  MCTSNode* current = node;
-  while (current) {
+  NodeIndex current = node;
+  while (current != kNoNode) {
     path.push_back(current);
-    current = current->Parent();
+    current = tree_->Parent(current);
   }
 
   std::vector<std::string> moves;
-  for (int i = path.size() - 1; i >= 1; i--) {
-    // Find a path from path[i] to path[i - 1];
-    const auto& children = path[i]->Children();
-    for (const auto& [node, move] : children) {
-      if (node == path[i - 1]) {
-        auto s = fmt::format("{} (Q {} N {} VL {})", move.Str(), node->Q(),
-                             node->Visit(), node->VirtualLoss());
-        moves.push_back(s);
-      }
-    }
+  for (int i = static_cast<int>(path.size()) - 2; i >= 0; i--) {
+    auto s = fmt::format("{} (Q {} N {} VL {})",
+                         tree_->GetMove(path[i]).Str(), tree_->Q(path[i]),
+                         tree_->Visit(path[i]), tree_->VirtualLoss(path[i]));
+    moves.push_back(s);
   }
 
   fmt::print("[Worker {}] {} \n", worker_id_, absl::StrJoin(moves, " -> "));
 }
 
-void MCTS::DumpDebugInfo() const { DumpDebugInfo(root_, 0); }
+void MCTS::DumpDebugInfo() const {
+  DumpDebugInfo(root_, 0);
+
+  if (num_batch_leaves_ + num_collisions_ > 0) {
+    fmt::print("Batched leaves {} Collisions {} ({:.1f}%) \n",
+               num_batch_leaves_, num_collisions_, 100 * CollisionRate());
+  }
 
-void MCTS::DumpDebugInfo(MCTSNode* node, int depth) const {
-  if (node->Visit() == 0) {
+  if (config_->mcts_transpositions) {
+    fmt::print("Transposed visits {} Positions {} \n",
+               num_transposed_visits_.load(), transpositions_.Size());
+  }
+}
+
+void MCTS::DumpDebugInfo(NodeIndex node, int depth) const {
+  if (tree_->Visit(node) == 0) {
     return;
   }
 
@@ -392,27 +785,25 @@ void MCTS::DumpDebugInfo(MCTSNode* node, int depth) const {
   }
 
   if (node == root_) {
-    fmt::print("{:02} Root {} ", depth, node->Q());
+    fmt::print("{:02} Root {} ", depth, tree_->Q(node));
   } else {
-    fmt::print("{:02} {} {} ", depth, node->State().LastMove().Str(),
-               node->Q());
+    fmt::print("{:02} {} {} ", depth, tree_->GetMove(node).Str(),
+               tree_->Q(node));
   }
 
-  node->DumpDebugInfo();
-  for (const auto& n : node->Children()) {
-    DumpDebugInfo(n.first, depth + 1);
+  tree_->DumpDebugInfo(node);
+
+  const NodeIndex first_child = tree_->FirstChild(node);
+  const NodeIndex last_child = first_child + tree_->NumChildren(node);
+  for (NodeIndex child = first_child; child < last_child; child++) {
+    DumpDebugInfo(child, depth + 1);
   }
 
   // Best moves.
   if (node == root_) {
-    std::vector<std::pair<MCTSNode*, Move>> children = root_->Children();
-    if (children.empty()) {
-      return;
-    }
-
-    for (auto [node, m] : children) {
-      fmt::print("{} : ", m.Str());
-      node->DumpDebugInfo();
+    for (NodeIndex child = first_child; child < last_child; child++) {
+      fmt::print("{} : ", tree_->GetMove(child).Str());
+      tree_->DumpDebugInfo(child);
     }
   }
 }
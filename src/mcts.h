@@ -1,73 +1,205 @@
 #ifndef MCTS_H
 #define MCTS_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 #include "config.h"
 #include "distribution.h"
 #include "evaluator.h"
-#include "mcts_node.h"
+#include "gumbel_root.h"
+#include "mcts_tree.h"
+#include "search_control.h"
+#include "transposition_table.h"
 
 namespace chess {
 
 class MCTS {
  public:
-  // Create MCTS with starting game state.
+  // Create MCTS with starting game state. Evaluates the states with the
+  // model_id th model of the evaluator.
   MCTS(const GameState* state, Evaluator* evaluator, Distribution* dist,
-       Config* config, int worker_id);
+       Config* config, int worker_id, int model_id = 0,
+       InferencePriority priority = InferencePriority::kBackground);
 
+  // Search within the limits of the config.
   void RunMCTS();
+  void RunMCTS(const SearchLimits& limits);
+
+  // Search step by step, for the drivers that interleave several trees on a
+  // thread (see SelfPlayDriver). BeginSearch() starts the search within the
+  // limits. CollectLeaves() then selects up to max_leaves leaves that need the
+  // evaluation, and ApplyValues() backs up their values (values[i] is the
+  // value of the state of leaves[i]). The search is over once SearchDone().
+  void BeginSearch(const SearchLimits& limits);
+  std::vector<NodeIndex> CollectLeaves(int max_leaves);
+  void ApplyValues(const std::vector<NodeIndex>& leaves,
+                   const std::vector<float>& values);
+  bool SearchDone() const;
+
+  // Start over the search from the state (see the constructor), reusing the
+  // memory of the previous search.
+  void Reset(const GameState* state);
+
+  // The states of the game are going away; AdvanceTo() fails until Reset().
+  void EndGame();
+
+  // Move the root to the child that is reached by the move, keeping the visits
+  // and values of its subtree and releasing the others. The noise is re-applied
+  // to the priors of the children of the new root. The next RunMCTS() runs
+  // num_mcts_iteration more iterations on top of the carried over visits.
+  void ReRoot(const Move& move);
+
+  // If the state continues the game from the state that the root was created
+  // (or last advanced) from, re-root along the moves in between and return
+  // true. The states of the game should be alive while the tree is used.
+  bool AdvanceTo(const GameState& state);
+
+  const MCTSTree& Tree() const { return *tree_; }
+  NodeIndex Root() const { return root_; }
+  size_t NumNodes() const { return tree_->NumNodes(); }
 
   // Get the policy vector. Policy vector is the flattened 1d vector of 73 * 8
-  // * 8 (= 1 * 4672).
+  // * 8 (= 1 * 4672). With mcts_gumbel_root, this is the improved policy of
+  // the completed Q instead of the visit distribution.
   torch::Tensor GetPolicyVector() const;
 
   // Return the move that corresponds to most visited node.
   // If best_move is true, then it will select the move with the highest visit
   // count. Otherwise, it will sample the move based on the probability of each
-  // move.
+  // move. With mcts_gumbel_root, it is always the move that the sequential
+  // halving chose (the Gumbel noise already randomizes it). Either way, a
+  // proven win is always played, and the proven losses are not unless every
+  // visited move loses.
   Move MoveToMake(bool choose_best_move = false) const;
 
+  // # of the visits of the last search that took the value of a transposition
+  // instead of searching the node (see mcts_transpositions).
+  int64_t NumTransposedVisits() const { return num_transposed_visits_; }
+
+  // Fraction of the batched selections (see CollectLeaves()) of the last search
+  // that hit a leaf which was already waiting for the evaluation. Such
+  // selections are retried and are not counted as iterations.
+  float CollisionRate() const;
+
   void DumpDebugInfo() const;
 
   // Show the path from the root to the node.
-  void ShowPath(MCTSNode* node) const;
+  void ShowPath(NodeIndex node) const;
 
  private:
-  void DoSingleRun();
-  void DoBatchRun();
+  void DoSingleRun(const SearchController& controller);
+  void DoBatchRun(const SearchController& controller);
+
+  // mcts_search_threads threads search the tree together. Each runs
+  // DoParallelSearch with its own requester slot of the evaluator.
+  void DoParallelRun(const SearchController& controller);
+  void DoParallelSearch(const SearchController& controller,
+                        int search_worker_id);
+
+  bool ShouldStop(const SearchController& controller, int iteration) const;
+
+  // Prepare the Gumbel root search (if mcts_gumbel_root) of the search that
+  // runs within the limits. The root is searched by gumbel_ once it is
+  // expanded.
+  void BeginGumbelRoot(const SearchLimits& limits);
+
+  // Requires expand_m_ (for the random generator).
+  void CreateGumbelRoot();
+
+  // Select up to max_leaves distinct leaves that are not computed yet, under
+  // the virtual loss. Leaves that are already computed are backed up right
+  // away. Stops early after mcts_max_batch_collisions collisions.
+  std::vector<NodeIndex> CollectLeaves(const SearchController& controller,
+                                       int max_leaves,
+                                       bool precompute_children);
 
   // Select the node to expand.
-  MCTSNode* Select();
+  NodeIndex Select();
+
+  // Expand the leaf node. If precompute_children is true, the children that are
+  // likely to be visited are evaluated right away (with the sync evaluation).
+  void Expand(NodeIndex node, bool precompute_children = true);
 
-  // Expand the leaf node.
-  void Expand(MCTSNode* node);
+  // Look up the position of the node in transpositions_. If the node of the
+  // position is searched more than this node is, the node takes its mean value
+  // instead of being expanded (returns true), so the edge catches up without
+  // the evaluations nor the nodes. Otherwise the node is expanded as usual,
+  // with the value of the position if it is already evaluated.
+  bool Transpose(NodeIndex node);
 
-  // Evaluate the node and return value estimate of the node.
-  float Evaluate(const MCTSNode* node);
+  // Evaluate the node (through the requester slot of worker_id) and return
+  // value estimate of the node.
+  float Evaluate(NodeIndex node, int worker_id);
 
   // Backup starting from the leaf node with the value.
-  void Backup(MCTSNode* leaf_node);
+  void Backup(NodeIndex leaf_node);
+
+  // If the node is proven, prove its ancestors that it decides (see
+  // MCTSTree::ProveFromChildren).
+  void Prove(NodeIndex node);
 
   // Backup using the virtual loss.
-  void BackupVirtual(MCTSNode* leaf_node, float virtual_loss);
+  void BackupVirtual(NodeIndex leaf_node);
+
+  // Remove only the virtual loss that was added by BackupVirtual of the leaf
+  // (the ones of the other pending leaves on the path are kept).
+  void RemoveVirtual(NodeIndex leaf_node);
 
-  // Clear virtual loss set by leaf node.
-  void ClearVirtual(MCTSNode* leaf_node);
+  void DumpDebugInfo(NodeIndex node, int depth) const;
 
-  void DumpDebugInfo(MCTSNode* node, int depth) const;
+  // tree_ lives in arena_. ReRoot() copies the kept subtree to spare_arena_
+  // and swaps the two.
+  std::unique_ptr<SearchArena> arena_;
+  std::unique_ptr<SearchArena> spare_arena_;
 
   // NOTE: Since we shuffle the child nodes, the ordering of moves may be
   // different from the ordering returned from state.PossibleMoves().
-  std::vector<std::unique_ptr<MCTSNode>> nodes_;
+  std::unique_ptr<MCTSTree> tree_;
+
+  // Guards the allocation of tree_ (and the distribution) while the search
+  // threads expand.
+  std::mutex expand_m_;
+
+  // States of the previous roots. Kept since the state of the root refers to
+  // them as the previous states.
+  std::vector<std::unique_ptr<GameState>> previous_root_states_;
+
+  NodeIndex root_;
+
+  // State (owned by the caller) that the root represents. nullptr once the root
+  // is moved by ReRoot() alone.
+  const GameState* root_source_;
 
-  MCTSNode* root_;
   Evaluator* evaluator_;
   Distribution* dist_;
 
+  // Batched leaves and collisions of the last search.
+  int64_t num_batch_leaves_ = 0;
+  int64_t num_collisions_ = 0;
+
+  // Nodes of the positions of tree_ if mcts_transpositions.
+  TranspositionTable transpositions_;
+  std::atomic<int64_t> num_transposed_visits_ = 0;
+
+  // Picks the children of the root if mcts_gumbel_root. Set before the root
+  // becomes expanded, so the search threads can read it once Expanded(root_).
+  std::unique_ptr<GumbelRoot> gumbel_;
+
+  // # of iterations of the search that gumbel_ allocates.
+  int gumbel_simulations_ = 0;
+
+  // Controller of the search that BeginSearch() started.
+  std::optional<SearchController> controller_;
+
   Config* config_;
-  int current_iter_ = 0;
+  std::atomic<int> current_iter_ = 0;
   int worker_id_;
+  int model_id_;
+  InferencePriority priority_;
 };
 
 }  // namespace chess
@@ -0,0 +1,348 @@
+#include "mcts_tree.h"
+
+#include <fmt/core.h>
+
+#include <cassert>
+#include <deque>
+#include <type_traits>
+
+namespace chess {
+namespace {
+
+// The selection kernel reads the atomic statistics as the plain arrays.
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t) &&
+              std::atomic<int32_t>::is_always_lock_free);
+static_assert(sizeof(std::atomic<float>) == sizeof(float) &&
+              std::atomic<float>::is_always_lock_free);
+
+void AtomicAdd(std::atomic<float>* target, float value) {
+  float current = target->load(std::memory_order_relaxed);
+  while (!target->compare_exchange_weak(current, current + value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+MCTSTree::MCTSTree(float virtual_loss, SearchArena* arena)
+    : virtual_loss_(virtual_loss),
+      arena_(arena),
+      chunks_(static_cast<NodeChunk**>(arena->Allocate(
+          sizeof(NodeChunk*) * kMaxChunks, alignof(NodeChunk*)))) {}
+
+NodeIndex MCTSTree::CreateRoot(const GameState& state) {
+  assert(num_nodes_ == 0);
+
+  NodeIndex root = Allocate(1);
+  InitNode(root, kNoNode, Move(0, 0), /*prior=*/1,
+           arena_->New<GameState>(state));
+  return root;
+}
+
+NodeIndex MCTSTree::AddChildren(NodeIndex parent,
+                                const std::vector<Move>& moves,
+                                const std::vector<float>& priors) {
+  if (moves.empty()) {
+    return kNoNode;
+  }
+
+  NodeIndex first_child = Allocate(moves.size());
+  for (size_t i = 0; i < moves.size(); i++) {
+    InitNode(first_child + i, parent, moves[i], priors[i],
+             /*state=*/nullptr);
+  }
+
+  Get(parent).first_child = first_child;
+  Get(parent).num_children = moves.size();
+  return first_child;
+}
+
+NodeIndex MCTSTree::Allocate(uint32_t num_nodes) {
+  assert(num_nodes <= kChunkSize);
+
+  // Children never span two chunks so that they stay contiguous.
+  if (next_offset_ + num_nodes > kChunkSize) {
+    if (num_chunks_ == kMaxChunks) {
+      fmt::print("MCTSTree is full ({} nodes) \n", num_nodes_.load());
+      std::abort();
+    }
+
+    // The chunks are dropped by the arena without the destructor.
+    static_assert(std::is_trivially_destructible_v<NodeChunk>);
+    chunks_[num_chunks_++] = arena_->New<NodeChunk>();
+    next_offset_ = 0;
+  }
+
+  NodeIndex first = ((num_chunks_ - 1) << kChunkBits) | next_offset_;
+  next_offset_ += num_nodes;
+  num_nodes_.fetch_add(num_nodes, std::memory_order_relaxed);
+  return first;
+}
+
+void MCTSTree::InitNode(NodeIndex node, NodeIndex parent, const Move& move,
+                        float prior, GameState* state) {
+  NodeChunk& chunk = Chunk(node);
+  const uint32_t offset = Offset(node);
+
+  chunk.prior[offset] = prior;
+  chunk.n_s_a[offset].store(0, std::memory_order_relaxed);
+  chunk.w_s_a[offset].store(0, std::memory_order_relaxed);
+  chunk.virtual_visit[offset].store(0, std::memory_order_relaxed);
+  chunk.move[offset] = move.Encode();
+  chunk.v[offset].store(0, std::memory_order_relaxed);
+  chunk.computed[offset].store(false, std::memory_order_relaxed);
+  chunk.proven[offset].store(ProvenValue::kUnknown, std::memory_order_relaxed);
+  chunk.expand_state[offset].store(kNotExpanded, std::memory_order_relaxed);
+
+  NodeInfo& info = chunk.info[offset];
+  if (state != nullptr) {
+    num_states_.fetch_add(1, std::memory_order_relaxed);
+  }
+  info.state.store(state, std::memory_order_relaxed);
+  info.parent = parent;
+  info.first_child = kNoNode;
+  info.num_children = 0;
+}
+
+const GameState& MCTSTree::MaterializeState(NodeIndex node) {
+  NodeInfo& info = Get(node);
+
+  GameState* state = info.state.load(std::memory_order_acquire);
+  if (state != nullptr) {
+    return *state;
+  }
+
+  // If the other thread creates the state first, this one is just left in the
+  // arena.
+  GameState* new_state =
+      arena_->New<GameState>(&State(info.parent), GetMove(node));
+  if (info.state.compare_exchange_strong(state, new_state,
+                                         std::memory_order_acq_rel)) {
+    num_states_.fetch_add(1, std::memory_order_relaxed);
+    return *new_state;
+  }
+
+  return *state;
+}
+
+int MCTSTree::Visit(NodeIndex node) const {
+  const NodeChunk& chunk = Chunk(node);
+  const uint32_t offset = Offset(node);
+  return chunk.n_s_a[offset].load(std::memory_order_relaxed) +
+         chunk.virtual_visit[offset].load(std::memory_order_relaxed);
+}
+
+float MCTSTree::Q(NodeIndex node) const {
+  return Chunk(node).w_s_a[Offset(node)].load(std::memory_order_relaxed) /
+             Visit(node) +
+         VirtualLoss(node);
+}
+
+NodeIndex MCTSTree::SelectChild(NodeIndex node) const {
+  const NodeIndex first_child = FirstChild(node);
+  const NodeChunk& chunk = Chunk(first_child);
+  const uint32_t offset = Offset(first_child);
+
+  const ChildStats stats = {
+      chunk.prior.data() + offset,
+      reinterpret_cast<const int32_t*>(chunk.n_s_a.data() + offset),
+      reinterpret_cast<const float*>(chunk.w_s_a.data() + offset),
+      reinterpret_cast<const int32_t*>(chunk.virtual_visit.data() + offset)};
+
+  return first_child + SelectPUCT(stats, NumChildren(node), Visit(node),
+                                  virtual_loss_);
+}
+
+void MCTSTree::UpdateQ(NodeIndex node, float value) {
+  NodeChunk& chunk = Chunk(node);
+  AtomicAdd(&chunk.w_s_a[Offset(node)], value);
+  chunk.n_s_a[Offset(node)].fetch_add(1, std::memory_order_relaxed);
+}
+
+float MCTSTree::V(NodeIndex node) const {
+  return Chunk(node).v[Offset(node)].load(std::memory_order_relaxed);
+}
+
+void MCTSTree::SetValueOfThisState(NodeIndex node, float value) {
+  NodeChunk& chunk = Chunk(node);
+  chunk.v[Offset(node)].store(value, std::memory_order_relaxed);
+  chunk.computed[Offset(node)].store(true, std::memory_order_release);
+}
+
+bool MCTSTree::Computed(NodeIndex node) const {
+  return Chunk(node).computed[Offset(node)].load(std::memory_order_acquire);
+}
+
+float MCTSTree::MeanValue(NodeIndex node) const {
+  const NodeChunk& chunk = Chunk(node);
+  const int n_s_a = chunk.n_s_a[Offset(node)].load(std::memory_order_relaxed);
+  if (n_s_a == 0) {
+    return V(node);
+  }
+
+  // W(s,a) is from the perspective of the previous player.
+  return -chunk.w_s_a[Offset(node)].load(std::memory_order_relaxed) / n_s_a;
+}
+
+ProvenValue MCTSTree::Proven(NodeIndex node) const {
+  return Chunk(node).proven[Offset(node)].load(std::memory_order_acquire);
+}
+
+void MCTSTree::SetProven(NodeIndex node, ProvenValue value) {
+  switch (value) {
+    case ProvenValue::kWin:
+      SetValueOfThisState(node, 1);
+      break;
+    case ProvenValue::kLoss:
+      SetValueOfThisState(node, -1);
+      break;
+    case ProvenValue::kDraw:
+      SetValueOfThisState(node, 0);
+      break;
+    case ProvenValue::kUnknown:
+      break;
+  }
+
+  Chunk(node).proven[Offset(node)].store(value, std::memory_order_release);
+}
+
+ProvenValue MCTSTree::ProveFromChildren(NodeIndex node) const {
+  const int num_children = NumChildren(node);
+  if (!Expanded(node) || num_children == 0) {
+    return ProvenValue::kUnknown;
+  }
+
+  bool all_proven = true, any_draw = false;
+  for (NodeIndex child = FirstChild(node);
+       child < FirstChild(node) + num_children; child++) {
+    switch (Proven(child)) {
+      case ProvenValue::kLoss:
+        // The player to move wins by moving to the child.
+        return ProvenValue::kWin;
+      case ProvenValue::kDraw:
+        any_draw = true;
+        break;
+      case ProvenValue::kUnknown:
+        all_proven = false;
+        break;
+      case ProvenValue::kWin:
+        break;
+    }
+  }
+
+  if (!all_proven) {
+    return ProvenValue::kUnknown;
+  }
+  return any_draw ? ProvenValue::kDraw : ProvenValue::kLoss;
+}
+
+int MCTSTree::VirtualVisit(NodeIndex node) const {
+  return Chunk(node).virtual_visit[Offset(node)].load(
+      std::memory_order_relaxed);
+}
+
+float MCTSTree::VirtualLoss(NodeIndex node) const {
+  return virtual_loss_ * VirtualVisit(node);
+}
+
+void MCTSTree::AddVirtualLoss(NodeIndex node) {
+  Chunk(node).virtual_visit[Offset(node)].fetch_add(1,
+                                                    std::memory_order_relaxed);
+}
+
+void MCTSTree::RemoveVirtualLoss(NodeIndex node) {
+  Chunk(node).virtual_visit[Offset(node)].fetch_sub(1,
+                                                    std::memory_order_relaxed);
+}
+
+bool MCTSTree::TryStartExpansion(NodeIndex node) {
+  uint8_t expected = kNotExpanded;
+  return Chunk(node).expand_state[Offset(node)].compare_exchange_strong(
+      expected, kExpanding, std::memory_order_acquire);
+}
+
+void MCTSTree::FinishExpansion(NodeIndex node) {
+  Chunk(node).expand_state[Offset(node)].store(kExpanded,
+                                               std::memory_order_release);
+}
+
+void MCTSTree::AbortExpansion(NodeIndex node) {
+  Chunk(node).expand_state[Offset(node)].store(kNotExpanded,
+                                               std::memory_order_release);
+}
+
+bool MCTSTree::Expanded(NodeIndex node) const {
+  return Chunk(node).expand_state[Offset(node)].load(
+             std::memory_order_acquire) == kExpanded;
+}
+
+NodeIndex MCTSTree::CopySubtreeTo(NodeIndex node, MCTSTree* tree,
+                                  const GameState* root_prev_state) const {
+  auto copy_stats = [this, tree](NodeIndex from, NodeIndex to) {
+    const NodeChunk& from_chunk = Chunk(from);
+    NodeChunk& to_chunk = tree->Chunk(to);
+    const uint32_t from_offset = Offset(from), to_offset = Offset(to);
+
+    to_chunk.n_s_a[to_offset].store(from_chunk.n_s_a[from_offset].load());
+    to_chunk.w_s_a[to_offset].store(from_chunk.w_s_a[from_offset].load());
+    to_chunk.v[to_offset].store(from_chunk.v[from_offset].load());
+    to_chunk.computed[to_offset].store(from_chunk.computed[from_offset].load());
+    to_chunk.proven[to_offset].store(from_chunk.proven[from_offset].load());
+    to_chunk.expand_state[to_offset].store(
+        from_chunk.expand_state[from_offset].load());
+  };
+
+  const NodeIndex root = tree->Allocate(1);
+  tree->InitNode(root, kNoNode, GetMove(node), Prior(node),
+                 tree->arena_->New<GameState>(State(node), root_prev_state));
+  copy_stats(node, root);
+
+  // Breadth first, so that the children of each node stay contiguous.
+  std::deque<std::pair<NodeIndex, NodeIndex>> to_visit = {{node, root}};
+  while (!to_visit.empty()) {
+    auto [from, to] = to_visit.front();
+    to_visit.pop_front();
+
+    const int num_children = NumChildren(from);
+    if (num_children == 0) {
+      continue;
+    }
+
+    const NodeIndex from_child = FirstChild(from);
+    const NodeIndex to_child = tree->Allocate(num_children);
+    for (int i = 0; i < num_children; i++) {
+      // The copied state follows the copy of its parent.
+      GameState* state = nullptr;
+      if (HasState(from_child + i)) {
+        state = tree->arena_->New<GameState>(State(from_child + i),
+                                             &tree->State(to));
+      }
+
+      tree->InitNode(to_child + i, to, GetMove(from_child + i),
+                     Prior(from_child + i), state);
+      copy_stats(from_child + i, to_child + i);
+      to_visit.push_back({from_child + i, to_child + i});
+    }
+
+    tree->Get(to).first_child = to_child;
+    tree->Get(to).num_children = num_children;
+  }
+
+  return root;
+}
+
+void MCTSTree::DumpDebugInfo(NodeIndex node) const {
+  const NodeChunk& chunk = Chunk(node);
+  const float w_s_a = chunk.w_s_a[Offset(node)].load();
+  const int n_s_a = chunk.n_s_a[Offset(node)].load();
+  if (n_s_a != 0) {
+    fmt::print(
+        "W(s,a)=[{}] N(s,a)=[{}] Q(s,a)=[{}] Value=[{}] Prior=[{}]\n",
+        w_s_a, n_s_a, w_s_a / n_s_a, V(node), Prior(node));
+  } else {
+    fmt::print("W(s,a)=[{}] N(s,a)=[{}] Value=[{}] Prior=[{}] \n", w_s_a,
+               n_s_a, V(node), Prior(node));
+  }
+}
+
+}  // namespace chess
@@ -0,0 +1,249 @@
+#ifndef MCTS_TREE_H
+#define MCTS_TREE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "game_state.h"
+#include "move.h"
+#include "puct_select.h"
+#include "search_arena.h"
+
+namespace chess {
+
+// Index of the node in MCTSTree.
+using NodeIndex = uint32_t;
+constexpr NodeIndex kNoNode = std::numeric_limits<NodeIndex>::max();
+
+// Game theoretic value of the state of a node, from the perspective of the
+// player to move (as V).
+enum class ProvenValue : int8_t {
+  kUnknown = 0,
+  kWin,
+  kLoss,
+  kDraw,
+};
+
+// Nodes of MCTS in the structure-of-arrays layout. Each node also contains the
+// information about the branch (edge) that leads from the parent state to the
+// state that the node represents:
+//
+//           (Parent; state s)
+//                     /
+// ------------------------------------------
+// |                 /                      |
+// |                /  (s, a) <-- Branch    |
+// |               /                        | <-- Node
+// |              /                         |
+// |   (Current node; state s')             |
+// |                                        |
+// ------------------------------------------
+//
+// Thus, the Q(s,a) and N(s,a) associated with the branch is stored at the
+// index of the node. Children of a node are allocated as a contiguous block of
+// indices, so the selection scans the priors and the visit counts of the
+// siblings sequentially.
+//
+// Nodes and states are allocated from the SearchArena of the tree, and are
+// dropped together when the arena is reset (the tree does not free anything).
+// Nodes live in fixed size chunks that are never moved, so the search threads
+// can read the nodes while the others allocate. Statistics are atomics; The
+// children are added only by the thread that claimed the expansion (see
+// TryStartExpansion) and are read only after Expanded() is true.
+class MCTSTree {
+ public:
+  static constexpr int kChunkBits = 12;
+  static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+  static constexpr uint32_t kMaxChunks = 4096;
+
+  // Every virtual visit adds virtual_loss to Q of the node. The arena should
+  // outlive the tree.
+  MCTSTree(float virtual_loss, SearchArena* arena);
+
+  // Create the root node with the copy of the state. Must be the first node.
+  NodeIndex CreateRoot(const GameState& state);
+
+  // Add the children of the parent (one for each move) and return the index of
+  // the first one. The states of the children are not created until
+  // MaterializeState(). Called by the thread that expands the parent, before
+  // FinishExpansion().
+  NodeIndex AddChildren(NodeIndex parent, const std::vector<Move>& moves,
+                        const std::vector<float>& priors);
+
+  size_t NumNodes() const { return num_nodes_.load(); }
+
+  // Number of the nodes whose state is created.
+  size_t NumStates() const { return num_states_.load(); }
+
+  // Structure.
+  NodeIndex Parent(NodeIndex node) const { return Get(node).parent; }
+  NodeIndex FirstChild(NodeIndex node) const { return Get(node).first_child; }
+  int NumChildren(NodeIndex node) const { return Get(node).num_children; }
+  Move GetMove(NodeIndex node) const {
+    return Move::Decode(Chunk(node).move[Offset(node)]);
+  }
+
+  // Make the node the root of its subtree.
+  void DetachFromParent(NodeIndex node) { Get(node).parent = kNoNode; }
+
+  // Create the state of the node (from the state of the parent) if it is not
+  // created yet. Safe to call from multiple search threads; Only one of the
+  // created states is kept.
+  const GameState& MaterializeState(NodeIndex node);
+  bool HasState(NodeIndex node) const {
+    return Get(node).state.load(std::memory_order_acquire) != nullptr;
+  }
+
+  // Get the state represented by this node. The state must be materialized.
+  const GameState& State(NodeIndex node) const {
+    return *Get(node).state.load(std::memory_order_acquire);
+  }
+
+  float Prior(NodeIndex node) const { return Chunk(node).prior[Offset(node)]; }
+  void SetPrior(NodeIndex node, float prior) {
+    Chunk(node).prior[Offset(node)] = prior;
+  }
+
+  // Total number of visit of this node (including the virtual visits).
+  int Visit(NodeIndex node) const;
+
+  // Returns Q(s,a), which is W(s,a) / N(s,a). Note that s is a previous state.
+  float Q(NodeIndex node) const;
+
+  // The child of the node with the largest Q + U (see SelectPUCT). The node
+  // must have a child.
+  NodeIndex SelectChild(NodeIndex node) const;
+
+  // Update the Q(s,a) where s is the previous state.
+  void UpdateQ(NodeIndex node, float value);
+
+  // Value estimate of the current state (from the estimation of NN).
+  float V(NodeIndex node) const;
+  void SetValueOfThisState(NodeIndex node, float value);
+  bool Computed(NodeIndex node) const;
+
+  // Value of the state of the node (from the perspective of the player to
+  // move, as V) averaged over the backups through the node, without the
+  // virtual visits. V if there is none yet.
+  float MeanValue(NodeIndex node) const;
+
+  // Proven nodes are not searched further; Their value is exact.
+  ProvenValue Proven(NodeIndex node) const;
+
+  // Also sets the value of the state to the exact one (1, -1 or 0).
+  void SetProven(NodeIndex node, ProvenValue value);
+
+  // The value of the node that its children prove: A win if any child is a
+  // loss (for the opponent), a loss if every child is a win, and a draw if
+  // every child is proven and the best of them is a draw. kUnknown otherwise.
+  ProvenValue ProveFromChildren(NodeIndex node) const;
+
+  // # of the evaluations in flight that go through the edge.
+  int VirtualVisit(NodeIndex node) const;
+  float VirtualLoss(NodeIndex node) const;
+  void AddVirtualLoss(NodeIndex node);
+
+  // Remove the virtual visit that was added by AddVirtualLoss (the ones of the
+  // other pending evaluations are kept).
+  void RemoveVirtualLoss(NodeIndex node);
+
+  // Returns true if the caller should expand the node. Only one caller gets
+  // true, and it must call FinishExpansion() once the children are added.
+  bool TryStartExpansion(NodeIndex node);
+  void FinishExpansion(NodeIndex node);
+
+  // Give up the expansion that TryStartExpansion() claimed, without adding the
+  // children. The node can be claimed again.
+  void AbortExpansion(NodeIndex node);
+  bool Expanded(NodeIndex node) const;
+
+  // Copy the subtree of the node into the empty tree (with the copies of the
+  // created states) and return the root of the copy. The state of the node
+  // must be created; Its copy follows root_prev_state in the history.
+  NodeIndex CopySubtreeTo(NodeIndex node, MCTSTree* tree,
+                          const GameState* root_prev_state) const;
+
+  void DumpDebugInfo(NodeIndex node) const;
+
+ private:
+  static constexpr uint8_t kNotExpanded = 0;
+  static constexpr uint8_t kExpanding = 1;
+  static constexpr uint8_t kExpanded = 2;
+
+  // Rarely touched during the selection.
+  struct NodeInfo {
+    // Allocated from the arena. nullptr until the state is materialized.
+    std::atomic<GameState*> state = nullptr;
+    NodeIndex parent = kNoNode;
+    NodeIndex first_child = kNoNode;
+    uint16_t num_children = 0;
+  };
+
+  // Every node (which is also the edge to it) takes kBytesPerNode bytes,
+  // whether it is ever expanded or not:
+  //   16  prior, n_s_a, w_s_a and virtual_visit (scanned by the selection)
+  //    2  move
+  //    7  v, computed, proven and expand_state
+  //   24  info (18 bytes padded to the alignment of the state pointer)
+  // That is ~196KB per chunk.
+  static constexpr size_t kBytesPerNode = 49;
+
+  struct NodeChunk {
+    // Hot data of the edges that the selection scans.
+    std::array<float, kChunkSize> prior;
+    std::array<std::atomic<int32_t>, kChunkSize> n_s_a;
+    std::array<std::atomic<float>, kChunkSize> w_s_a;
+    std::array<std::atomic<int32_t>, kChunkSize> virtual_visit;
+
+    std::array<uint16_t, kChunkSize> move;
+
+    // Value of the node estimated by the neural net.
+    std::array<std::atomic<float>, kChunkSize> v;
+    std::array<std::atomic<bool>, kChunkSize> computed;
+    std::array<std::atomic<ProvenValue>, kChunkSize> proven;
+    std::array<std::atomic<uint8_t>, kChunkSize> expand_state;
+
+    std::array<NodeInfo, kChunkSize> info;
+  };
+
+  static_assert(sizeof(NodeChunk) == kBytesPerNode * kChunkSize,
+                "Update kBytesPerNode along with the layout of NodeChunk.");
+
+  static uint32_t Offset(NodeIndex node) { return node & (kChunkSize - 1); }
+
+  NodeChunk& Chunk(NodeIndex node) { return *chunks_[node >> kChunkBits]; }
+  const NodeChunk& Chunk(NodeIndex node) const {
+    return *chunks_[node >> kChunkBits];
+  }
+
+  NodeInfo& Get(NodeIndex node) { return Chunk(node).info[Offset(node)]; }
+  const NodeInfo& Get(NodeIndex node) const {
+    return Chunk(node).info[Offset(node)];
+  }
+
+  // Reserve num_nodes contiguous nodes (within a single chunk).
+  NodeIndex Allocate(uint32_t num_nodes);
+
+  // Set every field of the node.
+  void InitNode(NodeIndex node, NodeIndex parent, const Move& move,
+                float prior, GameState* state);
+
+  float virtual_loss_;
+  SearchArena* arena_;
+
+  // Allocation is serialized by the caller (see MCTS::Expand); Readers only see
+  // the nodes that are published through FinishExpansion().
+  NodeChunk** chunks_;
+  uint32_t num_chunks_ = 0;
+  uint32_t next_offset_ = kChunkSize;
+  std::atomic<size_t> num_nodes_ = 0;
+  std::atomic<size_t> num_states_ = 0;
+};
+
+}  // namespace chess
+
+#endif
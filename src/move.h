@@ -26,6 +26,15 @@ class Move {
 
   static Move MoveFromString(std::string_view s);
 
+  // 16 bit encoding of the move ([promotion][from][to]).
+  constexpr uint16_t Encode() const {
+    return from_to_ | (static_cast<uint16_t>(promotion_) << 12);
+  }
+  static constexpr Move Decode(uint16_t encoded) {
+    return Move((encoded >> 6) & 0b111111, encoded & 0b111111,
+                static_cast<Promotion>(encoded >> 12));
+  }
+
   constexpr int From() const { return static_cast<char>(from_to_ >> 6); }
   constexpr int To() const { return static_cast<char>(from_to_ & 0b111111); }
 
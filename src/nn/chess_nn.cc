@@ -5,7 +5,11 @@ namespace chess {
 // Number of 8*8 planes in the input state.
 constexpr int kStateSize = 119;
 
-ChessNNImpl::ChessNNImpl(int num_layer, int num_filter) {
+ChessNNImpl::ChessNNImpl(int num_layer, int num_filter,
+                         bool use_conv_policy_head)
+    : num_layer_(num_layer),
+      num_filter_(num_filter),
+      use_conv_policy_head_(use_conv_policy_head) {
   conv_input_to_block_ = register_module(
       "conv_input_to_block",
       torch::nn::Conv2d(torch::nn::Conv2dOptions(kStateSize, num_filter, 3)
@@ -21,13 +25,30 @@ ChessNNImpl::ChessNNImpl(int num_layer, int num_filter) {
 
   register_module("chess_net", layers_);
 
-  conv_policy_ = register_module(
-      "conv_policy",
-      torch::nn::Conv2d(torch::nn::Conv2dOptions(num_filter, 73, {3, 3})
-                            .stride(1)
-                            .padding(1)));
-  fc_policy_ =
-      register_module("fc_policy", torch::nn::Linear(73 * 8 * 8, 73 * 8 * 8));
+  if (use_conv_policy_head_) {
+    // Each of 73 output planes directly corresponds to the move type from the
+    // square, so the logits can be computed without the 4672 * 4672 dense
+    // layer.
+    conv_policy_hidden_ = register_module(
+        "conv_policy_hidden",
+        torch::nn::Conv2d(
+            torch::nn::Conv2dOptions(num_filter, num_filter, {3, 3})
+                .stride(1)
+                .padding(1)));
+    batch_norm_policy_ = register_module("batch_norm_policy",
+                                         torch::nn::BatchNorm2d(num_filter));
+    conv_policy_ = register_module(
+        "conv_policy",
+        torch::nn::Conv2d(torch::nn::Conv2dOptions(num_filter, 73, {1, 1})));
+  } else {
+    conv_policy_ = register_module(
+        "conv_policy",
+        torch::nn::Conv2d(torch::nn::Conv2dOptions(num_filter, 73, {3, 3})
+                              .stride(1)
+                              .padding(1)));
+    fc_policy_ = register_module("fc_policy",
+                                 torch::nn::Linear(73 * 8 * 8, 73 * 8 * 8));
+  }
 
   conv_value_ = register_module(
       "conv_value",
@@ -46,13 +67,27 @@ torch::Tensor ChessNNImpl::GetPolicy(torch::Tensor state) {
 
   auto x = layers_->forward(state);
 
-  // policy : N * 73 * 8 * 8
-  auto policy = conv_policy_->forward(x);
-  policy = torch::relu(policy);
+  torch::Tensor policy;
+  if (use_conv_policy_head_) {
+    policy = conv_policy_hidden_->forward(x);
+    policy = batch_norm_policy_->forward(policy);
+    policy = torch::relu(policy);
+
+    // policy : N * 73 * 8 * 8 (logits).
+    policy = conv_policy_->forward(policy);
+
+    // policy : N * (73 * 8 * 8)
+    policy = policy.flatten(1);
+  } else {
+    // policy : N * 73 * 8 * 8
+    policy = conv_policy_->forward(x);
+    policy = torch::relu(policy);
+
+    // policy : N * (73 * 8 * 8)
+    policy = policy.flatten(1);
+    policy = fc_policy_->forward(policy);
+  }
 
-  // policy : N * (73 * 8 * 8)
-  policy = policy.flatten(1);
-  policy = fc_policy_->forward(policy);
   policy = torch::nn::functional::softmax(
       policy, torch::nn::functional::SoftmaxFuncOptions(1));
 
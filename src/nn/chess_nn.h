@@ -7,18 +7,30 @@ namespace chess {
 
 class ChessNNImpl : public torch::nn::Module {
  public:
-  ChessNNImpl(int num_layer, int num_filter);
+  // If use_conv_policy_head is set, the policy logits (73 * 8 * 8) are
+  // produced directly by the convolutions without the dense layer at the end.
+  ChessNNImpl(int num_layer, int num_filter, bool use_conv_policy_head = false);
 
   virtual torch::Tensor GetPolicy(torch::Tensor state);
   virtual torch::Tensor GetValue(torch::Tensor state);
 
+  int NumLayer() const { return num_layer_; }
+  int NumFilter() const { return num_filter_; }
+  bool UseConvPolicyHead() const { return use_conv_policy_head_; }
+
  private:
   torch::nn::Sequential layers_;
   torch::nn::Conv2d conv_input_to_block_{nullptr};
   torch::nn::Conv2d conv_policy_{nullptr};
+  torch::nn::Conv2d conv_policy_hidden_{nullptr};
+  torch::nn::BatchNorm2d batch_norm_policy_{nullptr};
   torch::nn::Conv2d conv_value_{nullptr};
   torch::nn::Linear fc_policy_{nullptr};
   torch::nn::Linear fc_value_{nullptr};
+
+  int num_layer_;
+  int num_filter_;
+  bool use_conv_policy_head_;
 };
 
 TORCH_MODULE(ChessNN);
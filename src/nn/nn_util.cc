@@ -1,5 +1,7 @@
 #include "nn_util.h"
 
+#include <ATen/autocast_mode.h>
+
 namespace chess {
 namespace {
 
@@ -9,6 +11,7 @@ using ::at::indexing::Slice;
 constexpr int kNumFeaturesPerHistory = 14;
 constexpr int kNumMaxHistory = 8;
 constexpr int kTotalNumFeatures = kNumFeaturesPerHistory * kNumMaxHistory + 7;
+static_assert(kTotalNumFeatures == kNumStatePlanes);
 
 constexpr int kQueenMoveN = 0;
 constexpr int kQueenMoveNE = 1 * 7;
@@ -175,14 +178,21 @@ void SetPolicyTensor(Move m, float prob, torch::Tensor* tensor) {
 // Needs 8 previous board states. (Newest is the last element).
 torch::Tensor GameStateToTensor(const GameState& current_state) {
   torch::Tensor tensor = torch::zeros({kTotalNumFeatures, 8, 8});
+  GameStateToTensor(current_state, &tensor);
+
+  return tensor;
+}
+
+void GameStateToTensor(const GameState& current_state, torch::Tensor* tensor) {
+  tensor->zero_();
 
   // Scan entire board and construct the board.
   int n_th = 0;
   const GameState* current = &current_state;
   while (current) {
     SetPieceOnTensor(current->GetBoard(), current_state.WhoIsMoving(), n_th,
-                     &tensor);
-    SetRepititionsOnTensor(current->RepititionCount(), n_th, &tensor);
+                     tensor);
+    SetRepititionsOnTensor(current->RepititionCount(), n_th, tensor);
 
     n_th++;
     if (n_th >= kNumMaxHistory) {
@@ -205,10 +215,8 @@ torch::Tensor GameStateToTensor(const GameState& current_state) {
 
   SetAuxiliaryData(current_state.TotalMoveCount(),
                    current_state.NoProgressCount(), current_state.WhoIsMoving(),
-                   &tensor);
-  SetCastling(p1_castle, p2_castle, &tensor);
-
-  return tensor;
+                   tensor);
+  SetCastling(p1_castle, p2_castle, tensor);
 }
 
 torch::Tensor GameStateSerializedToTensor(
@@ -241,6 +249,30 @@ int GetModelNumParams(ChessNN m) {
   return total_params;
 }
 
+ChessNN CloneChessNN(ChessNN source) {
+  ChessNN replica(source->NumLayer(), source->NumFilter(),
+                  source->UseConvPolicyHead());
+  replica->to(source->parameters().front().device());
+  replica->train(source->is_training());
+
+  CopyChessNNWeights(source, replica);
+  return replica;
+}
+
+void CopyChessNNWeights(ChessNN from, ChessNN to) {
+  torch::NoGradGuard no_grad;
+
+  auto to_params = to->named_parameters();
+  for (const auto& item : from->named_parameters()) {
+    to_params[item.key()].copy_(item.value());
+  }
+
+  auto to_buffers = to->named_buffers();
+  for (const auto& item : from->named_buffers()) {
+    to_buffers[item.key()].copy_(item.value());
+  }
+}
+
 torch::Tensor MoveToTensor(std::vector<std::pair<Move, float>> move_and_prob) {
   torch::Tensor policy = torch::zeros({73, 8, 8});
 
@@ -274,4 +306,62 @@ torch::Tensor NormalizePolicy(const GameState& game_state,
 
   return policy;
 }
+
+bool IsReducedPrecisionSupported(torch::Device device) {
+  if (device.is_cuda()) {
+    return torch::cuda::is_available();
+  }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+  // Without the native bf16 instructions, bf16 matmul is emulated and is
+  // slower than fp32.
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512bf16") ||
+         __builtin_cpu_supports("amx-bf16");
+#else
+  return false;
+#endif
+}
+
+ReducedPrecisionGuard::ReducedPrecisionGuard(const Config* config)
+    : is_cuda_(config->device.is_cuda()) {
+  if (!config->use_reduced_precision ||
+      !IsReducedPrecisionSupported(config->device)) {
+    return;
+  }
+
+  // Autocast state is thread local, so nesting it is only a problem when the
+  // caller already enabled it.
+  if (is_cuda_) {
+    if (at::autocast::is_enabled()) {
+      return;
+    }
+    at::autocast::set_autocast_gpu_dtype(at::kHalf);
+    at::autocast::set_enabled(true);
+  } else {
+    if (at::autocast::is_cpu_enabled()) {
+      return;
+    }
+    at::autocast::set_autocast_cpu_dtype(at::kBFloat16);
+    at::autocast::set_cpu_enabled(true);
+  }
+
+  enabled_ = true;
+}
+
+ReducedPrecisionGuard::~ReducedPrecisionGuard() {
+  if (!enabled_) {
+    return;
+  }
+
+  if (is_cuda_) {
+    at::autocast::set_enabled(false);
+  } else {
+    at::autocast::set_cpu_enabled(false);
+  }
+
+  // Drop the casted copies of the weights.
+  at::autocast::clear_cache();
+}
+
 }  // namespace chess
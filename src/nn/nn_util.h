@@ -5,13 +5,22 @@
 
 #include <vector>
 
+#include "config.h"
 #include "game_state.h"
 #include "nn/chess_nn.h"
 
 namespace chess {
 
+// Number of 8 * 8 planes that encode the game state.
+constexpr int kNumStatePlanes = 14 * 8 + 7;
+
 // Convert board to tensor.
 torch::Tensor GameStateToTensor(const GameState& current_state);
+
+// Same as above, but encode into the existing 119 * 8 * 8 tensor (which can be
+// a view of the larger batch tensor).
+void GameStateToTensor(const GameState& current_state, torch::Tensor* tensor);
+
 torch::Tensor GameStateSerializedToTensor(
     const GameStateSerialized& serialized);
 
@@ -20,10 +29,36 @@ torch::Tensor MoveToTensor(std::vector<std::pair<Move, float>> move_and_prob);
 
 int GetModelNumParams(ChessNN m);
 
+// Create a new ChessNN that has the same architecture and weights as the
+// source. The replica lives on the same device as the source.
+ChessNN CloneChessNN(ChessNN source);
+
+// Copy the weights (parameters and buffers) of from to to. Both should have the
+// same architecture.
+void CopyChessNNWeights(ChessNN from, ChessNN to);
+
 // From the given policy vector, we have to mask out the impossible actions.
 torch::Tensor NormalizePolicy(const GameState& game_state,
                               torch::Tensor policy);
 
+// Whether the device can run the reduced precision (bfloat16 on CPU, float16
+// on CUDA) forward pass efficiently.
+bool IsReducedPrecisionSupported(torch::Device device);
+
+// While alive, the forward pass of the current thread runs under the autocast
+// with the reduced precision if config->use_reduced_precision is set. Weights
+// stay in fp32 and the outputs should be converted back with
+// .to(torch::kFloat) before reading them.
+class ReducedPrecisionGuard {
+ public:
+  ReducedPrecisionGuard(const Config* config);
+  ~ReducedPrecisionGuard();
+
+ private:
+  bool enabled_ = false;
+  bool is_cuda_ = false;
+};
+
 }  // namespace chess
 
 #endif
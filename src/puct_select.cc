@@ -0,0 +1,267 @@
+#include "puct_select.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PUCT_SELECT_X86
+#endif
+
+namespace chess {
+namespace {
+
+constexpr float kInf = std::numeric_limits<float>::infinity();
+
+// Score of the child i. Unvisited children get the infinite score.
+inline float PUCTScore(const ChildStats& stats, int i, float sqrt_total,
+                       float virtual_loss) {
+  const int32_t virtual_visit = stats.virtual_visit[i];
+  const int32_t visit = stats.n_s_a[i] + virtual_visit;
+  if (visit == 0) {
+    return kInf;
+  }
+
+  const float visit_f = static_cast<float>(visit);
+  const float u = stats.prior[i] * sqrt_total / (1.0f + visit_f);
+  const float q = stats.w_s_a[i] / visit_f +
+                  static_cast<float>(virtual_visit) * virtual_loss;
+  return u + q;
+}
+
+// Continue the scan of the children from i with the scalar code.
+int SelectPUCTTail(const ChildStats& stats, int i, int num_children,
+                   float sqrt_total, float virtual_loss, int best_index,
+                   float best_score) {
+  for (; i < num_children; i++) {
+    const float score = PUCTScore(stats, i, sqrt_total, virtual_loss);
+    if (best_index < 0 || score > best_score) {
+      best_index = i;
+      best_score = score;
+    }
+  }
+
+  return best_index;
+}
+
+int SelectPUCTScalar(const ChildStats& stats, int num_children,
+                     int total_visit, float virtual_loss) {
+  const float sqrt_total = std::sqrt(static_cast<float>(total_visit));
+  return SelectPUCTTail(stats, 0, num_children, sqrt_total, virtual_loss,
+                        /*best_index=*/-1, /*best_score=*/-kInf);
+}
+
+#ifdef PUCT_SELECT_X86
+
+// Reduce the per lane maximums; The smaller index wins the ties.
+template <int kLanes>
+int ReduceLanes(const float* scores, const int32_t* indices) {
+  int best_index = -1;
+  float best_score = -kInf;
+  for (int lane = 0; lane < kLanes; lane++) {
+    if (indices[lane] < 0) {
+      continue;
+    }
+
+    if (best_index < 0 || scores[lane] > best_score ||
+        (scores[lane] == best_score && indices[lane] < best_index)) {
+      best_index = indices[lane];
+      best_score = scores[lane];
+    }
+  }
+
+  return best_index;
+}
+
+// FMA is left out so that the products are rounded as the scalar code does.
+__attribute__((target("avx2"))) inline __m256 ScoreAvx2(
+    __m256 prior, __m256 w_s_a, __m256i n_s_a, __m256i virtual_visit,
+    __m256 sqrt_total, float virtual_loss) {
+  const __m256 visit =
+      _mm256_cvtepi32_ps(_mm256_add_epi32(n_s_a, virtual_visit));
+  const __m256 u = _mm256_div_ps(_mm256_mul_ps(prior, sqrt_total),
+                                 _mm256_add_ps(_mm256_set1_ps(1.0f), visit));
+  const __m256 q = _mm256_add_ps(
+      _mm256_div_ps(w_s_a, visit),
+      _mm256_mul_ps(_mm256_cvtepi32_ps(virtual_visit),
+                    _mm256_set1_ps(virtual_loss)));
+
+  const __m256 unvisited =
+      _mm256_cmp_ps(visit, _mm256_setzero_ps(), _CMP_EQ_OQ);
+  return _mm256_blendv_ps(_mm256_add_ps(u, q), _mm256_set1_ps(kInf),
+                          unvisited);
+}
+
+__attribute__((target("avx2"))) int SelectPUCTAvx2(const ChildStats& stats,
+                                                   int num_children,
+                                                   int total_visit,
+                                                   float virtual_loss) {
+  const __m256 sqrt_total =
+      _mm256_set1_ps(std::sqrt(static_cast<float>(total_visit)));
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  __m256 best = _mm256_set1_ps(-kInf);
+  __m256i best_index = _mm256_set1_epi32(-1);
+
+  for (int i = 0; i < num_children; i += 8) {
+    const __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), lanes);
+
+    __m256 score;
+    __m256 valid;
+    if (i + 8 <= num_children) {
+      score = ScoreAvx2(
+          _mm256_loadu_ps(stats.prior + i), _mm256_loadu_ps(stats.w_s_a + i),
+          _mm256_loadu_si256(
+              reinterpret_cast<const __m256i*>(stats.n_s_a + i)),
+          _mm256_loadu_si256(
+              reinterpret_cast<const __m256i*>(stats.virtual_visit + i)),
+          sqrt_total, virtual_loss);
+      valid = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    } else {
+      // Remaining children; The lanes past the end are not loaded.
+      const __m256i mask = _mm256_cmpgt_epi32(
+          _mm256_set1_epi32(num_children - i), lanes);
+      score = ScoreAvx2(
+          _mm256_maskload_ps(stats.prior + i, mask),
+          _mm256_maskload_ps(stats.w_s_a + i, mask),
+          _mm256_maskload_epi32(stats.n_s_a + i, mask),
+          _mm256_maskload_epi32(stats.virtual_visit + i, mask), sqrt_total,
+          virtual_loss);
+      valid = _mm256_castsi256_ps(mask);
+    }
+
+    const __m256 greater =
+        _mm256_and_ps(_mm256_cmp_ps(score, best, _CMP_GT_OQ), valid);
+    best = _mm256_blendv_ps(best, score, greater);
+    best_index = _mm256_castps_si256(
+        _mm256_blendv_ps(_mm256_castsi256_ps(best_index),
+                         _mm256_castsi256_ps(index), greater));
+  }
+
+  alignas(32) float scores[8];
+  alignas(32) int32_t indices[8];
+  _mm256_store_ps(scores, best);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(indices), best_index);
+
+  // The scalar code that follows would pay for the dirty upper halves.
+  _mm256_zeroupper();
+  return ReduceLanes<8>(scores, indices);
+}
+
+// The maskz variant, since _mm512_cvtepi32_ps trips -Wmaybe-uninitialized of
+// GCC 12.
+__attribute__((target("avx512f"))) inline __m512 ToFloat(__m512i v) {
+  return _mm512_maskz_cvtepi32_ps(0xFFFF, v);
+}
+
+__attribute__((target("avx512f"))) int SelectPUCTAvx512(
+    const ChildStats& stats, int num_children, int total_visit,
+    float virtual_loss) {
+  const __m512 sqrt_total =
+      _mm512_set1_ps(std::sqrt(static_cast<float>(total_visit)));
+  const __m512 one = _mm512_set1_ps(1.0f);
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 inf = _mm512_set1_ps(kInf);
+  const __m512 virtual_loss_v = _mm512_set1_ps(virtual_loss);
+  const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                          11, 12, 13, 14, 15);
+
+  __m512 best = _mm512_set1_ps(-kInf);
+  __m512i best_index = _mm512_set1_epi32(-1);
+
+  for (int i = 0; i < num_children; i += 16) {
+    // The lanes past the end are not loaded.
+    const __mmask16 valid =
+        num_children - i >= 16 ? 0xFFFF : (1u << (num_children - i)) - 1;
+
+    const __m512 prior = _mm512_maskz_loadu_ps(valid, stats.prior + i);
+    const __m512 w_s_a = _mm512_maskz_loadu_ps(valid, stats.w_s_a + i);
+    const __m512i n_s_a = _mm512_maskz_loadu_epi32(valid, stats.n_s_a + i);
+    const __m512i virtual_visit =
+        _mm512_maskz_loadu_epi32(valid, stats.virtual_visit + i);
+
+    const __m512 visit = ToFloat(_mm512_add_epi32(n_s_a, virtual_visit));
+    const __m512 u = _mm512_div_ps(_mm512_mul_ps(prior, sqrt_total),
+                                   _mm512_add_ps(one, visit));
+    const __m512 q = _mm512_add_ps(
+        _mm512_div_ps(w_s_a, visit),
+        _mm512_mul_ps(ToFloat(virtual_visit), virtual_loss_v));
+
+    __m512 score = _mm512_add_ps(u, q);
+    score = _mm512_mask_blend_ps(
+        _mm512_cmp_ps_mask(visit, zero, _CMP_EQ_OQ), score, inf);
+
+    const __mmask16 greater =
+        _mm512_mask_cmp_ps_mask(valid, score, best, _CMP_GT_OQ);
+    best = _mm512_mask_blend_ps(greater, best, score);
+    best_index = _mm512_mask_blend_epi32(
+        greater, best_index, _mm512_add_epi32(_mm512_set1_epi32(i), lanes));
+  }
+
+  alignas(64) float scores[16];
+  alignas(64) int32_t indices[16];
+  _mm512_store_ps(scores, best);
+  _mm512_store_si512(indices, best_index);
+
+  _mm256_zeroupper();
+  return ReduceLanes<16>(scores, indices);
+}
+
+#endif
+
+}  // namespace
+
+std::string_view PUCTKernelName(PUCTKernel kernel) {
+  switch (kernel) {
+    case PUCTKernel::kScalar:
+      return "scalar";
+    case PUCTKernel::kAvx2:
+      return "avx2";
+    case PUCTKernel::kAvx512:
+      return "avx512";
+  }
+  return "";
+}
+
+bool IsPUCTKernelSupported(PUCTKernel kernel) {
+  switch (kernel) {
+    case PUCTKernel::kScalar:
+      return true;
+#ifdef PUCT_SELECT_X86
+    case PUCTKernel::kAvx2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+    case PUCTKernel::kAvx512:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+PUCTKernel BestPUCTKernel() {
+  // AVX-512 does not win over AVX2 at the usual branching factor (~35) since
+  // the divisions dominate and the wider units lower the clock. Check with
+  // app/puct_benchmark on the host before switching.
+  if (IsPUCTKernelSupported(PUCTKernel::kAvx2)) {
+    return PUCTKernel::kAvx2;
+  }
+  return PUCTKernel::kScalar;
+}
+
+int SelectPUCT(PUCTKernel kernel, const ChildStats& stats, int num_children,
+               int total_visit, float virtual_loss) {
+  switch (kernel) {
+#ifdef PUCT_SELECT_X86
+    case PUCTKernel::kAvx2:
+      return SelectPUCTAvx2(stats, num_children, total_visit, virtual_loss);
+    case PUCTKernel::kAvx512:
+      return SelectPUCTAvx512(stats, num_children, total_visit, virtual_loss);
+#endif
+    default:
+      return SelectPUCTScalar(stats, num_children, total_visit, virtual_loss);
+  }
+}
+
+}  // namespace chess
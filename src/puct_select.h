@@ -0,0 +1,51 @@
+#ifndef PUCT_SELECT_H
+#define PUCT_SELECT_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace chess {
+
+// Statistics of the contiguous children of a node (see MCTSTree).
+struct ChildStats {
+  const float* prior;
+  const int32_t* n_s_a;
+  const float* w_s_a;
+  const int32_t* virtual_visit;
+};
+
+enum class PUCTKernel {
+  kScalar,
+  kAvx2,
+  kAvx512,
+};
+
+std::string_view PUCTKernelName(PUCTKernel kernel);
+
+// Whether the CPU can run the kernel.
+bool IsPUCTKernelSupported(PUCTKernel kernel);
+
+// The kernel that SelectPUCT() uses by default.
+PUCTKernel BestPUCTKernel();
+
+// Returns the index of the child with the largest Q(s,a) + U(s,a), where
+//
+//   Q = W / visit + virtual_visit * virtual_loss
+//   U = prior * sqrt(total_visit) / (1 + visit)
+//   visit = N + virtual_visit
+//
+// The first child without any visit is chosen right away, and the first one
+// wins the ties. Every kernel computes the same float arithmetic, so they pick
+// the same child.
+int SelectPUCT(PUCTKernel kernel, const ChildStats& stats, int num_children,
+               int total_visit, float virtual_loss);
+
+inline int SelectPUCT(const ChildStats& stats, int num_children,
+                      int total_visit, float virtual_loss) {
+  static const PUCTKernel kernel = BestPUCTKernel();
+  return SelectPUCT(kernel, stats, num_children, total_visit, virtual_loss);
+}
+
+}  // namespace chess
+
+#endif
@@ -0,0 +1,110 @@
+#include "search_arena.h"
+
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace chess {
+namespace {
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+SearchArena::SearchArena(bool use_huge_pages)
+    : use_huge_pages_(use_huge_pages) {}
+
+SearchArena::~SearchArena() {
+  Reset();
+
+  for (const Block& block : blocks_) {
+    std::free(block.data);
+  }
+}
+
+void* SearchArena::Allocate(size_t size, size_t alignment) {
+  std::lock_guard<std::mutex> lk(m_);
+
+  while (true) {
+    if (current_block_ < blocks_.size()) {
+      const Block& block = blocks_[current_block_];
+      const size_t offset = AlignUp(offset_, alignment);
+      if (offset + size <= block.size) {
+        offset_ = offset + size;
+        return block.data + offset;
+      }
+
+      // Move on to the next block (that was kept by Reset()).
+      if (current_block_ + 1 < blocks_.size()) {
+        used_before_current_ += offset_;
+        current_block_++;
+        offset_ = 0;
+        continue;
+      }
+
+      used_before_current_ += offset_;
+    }
+
+    blocks_.push_back(NewBlock(size + alignment));
+    current_block_ = blocks_.size() - 1;
+    offset_ = 0;
+  }
+}
+
+SearchArena::Block SearchArena::NewBlock(size_t min_size) {
+  const size_t size = AlignUp(min_size, kBlockSize);
+
+  // Aligned to the block size so that the huge pages can back the whole block.
+  char* data = static_cast<char*>(std::aligned_alloc(kBlockSize, size));
+  if (data == nullptr) {
+    std::cerr << "Failed to allocate the search arena block of " << size
+              << " bytes" << std::endl;
+    std::abort();
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (use_huge_pages_) {
+    madvise(data, size, MADV_HUGEPAGE);
+  }
+#endif
+
+  return {data, size};
+}
+
+void SearchArena::AddCleanup(void* object, void (*destructor)(void*)) {
+  std::lock_guard<std::mutex> lk(m_);
+  cleanups_.push_back({object, destructor});
+}
+
+void SearchArena::Reset() {
+  std::lock_guard<std::mutex> lk(m_);
+
+  for (auto it = cleanups_.rbegin(); it != cleanups_.rend(); it++) {
+    it->second(it->first);
+  }
+  cleanups_.clear();
+
+  current_block_ = 0;
+  offset_ = 0;
+  used_before_current_ = 0;
+}
+
+size_t SearchArena::BytesUsed() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return used_before_current_ + offset_;
+}
+
+size_t SearchArena::BytesReserved() const {
+  std::lock_guard<std::mutex> lk(m_);
+
+  size_t reserved = 0;
+  for (const Block& block : blocks_) {
+    reserved += block.size;
+  }
+  return reserved;
+}
+
+}  // namespace chess
@@ -0,0 +1,81 @@
+#ifndef SEARCH_ARENA_H
+#define SEARCH_ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace chess {
+
+// Bump allocator that owns the nodes and the states of a search. Nothing is
+// freed individually; Reset() drops every object at once and keeps the blocks
+// for the next search, so there is no free storm between the moves.
+//
+// Objects that are not trivially destructible (e.g. GameState, which owns the
+// vector of legal moves) are destructed by Reset().
+class SearchArena {
+ public:
+  // Also the size of the transparent huge page on x86-64.
+  static constexpr size_t kBlockSize = 2 << 20;
+
+  // If use_huge_pages is true, the blocks are advised to be backed by the
+  // transparent huge pages.
+  explicit SearchArena(bool use_huge_pages = false);
+  ~SearchArena();
+
+  SearchArena(const SearchArena&) = delete;
+  SearchArena& operator=(const SearchArena&) = delete;
+
+  // Thread safe.
+  void* Allocate(size_t size, size_t alignment);
+
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    T* object = new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      AddCleanup(object, [](void* o) { static_cast<T*>(o)->~T(); });
+    }
+    return object;
+  }
+
+  // Destruct every object and rewind to the first block. None of the objects
+  // should be used afterwards.
+  void Reset();
+
+  size_t BytesUsed() const;
+  size_t BytesReserved() const;
+
+ private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  // Allocate a block that can hold at least min_size bytes.
+  Block NewBlock(size_t min_size);
+
+  void AddCleanup(void* object, void (*destructor)(void*));
+
+  const bool use_huge_pages_;
+
+  mutable std::mutex m_;
+
+  std::vector<Block> blocks_;
+
+  // Allocation happens at blocks_[current_block_] starting from offset_.
+  size_t current_block_ = 0;
+  size_t offset_ = 0;
+
+  // Bytes used by the blocks before the current one.
+  size_t used_before_current_ = 0;
+
+  std::vector<std::pair<void*, void (*)(void*)>> cleanups_;
+};
+
+}  // namespace chess
+
+#endif
@@ -0,0 +1,124 @@
+#include "search_control.h"
+
+#include <algorithm>
+
+namespace chess {
+
+SearchLimits SearchLimits::FromConfig(const Config& config) {
+  SearchLimits limits;
+  limits.num_iterations = config.num_mcts_iteration;
+  limits.move_time = std::chrono::milliseconds(config.mcts_move_time_ms);
+  limits.max_nodes = config.mcts_max_nodes;
+  limits.smart_pruning = config.mcts_smart_pruning && !config.mcts_gumbel_root;
+  return limits;
+}
+
+SearchController::SearchController(const SearchLimits& limits,
+                                   int start_iteration)
+    : limits_(limits),
+      start_iteration_(start_iteration),
+      start_(Clock::now()),
+      deadline_(start_ + limits.move_time) {}
+
+bool SearchController::ShouldStop(int iteration, const MCTSTree& tree,
+                                  NodeIndex root) const {
+  if (iteration >= limits_.num_iterations) {
+    return true;
+  }
+
+  // Always runs the first iteration, so that the root is expanded.
+  if (iteration == start_iteration_) {
+    return false;
+  }
+
+  // The search can not change the game theoretic value of the root.
+  if (tree.Proven(root) != ProvenValue::kUnknown) {
+    return true;
+  }
+
+  // The move (and the policy) are chosen from the visits of the children, so
+  // the budgets and the pruning wait until one of them is visited.
+  if (!RootChildVisited(tree, root)) {
+    return false;
+  }
+
+  if (limits_.max_nodes > 0 && tree.NumNodes() >= limits_.max_nodes) {
+    return true;
+  }
+
+  const Clock::time_point now = Clock::now();
+  if (limits_.move_time.count() > 0 && now >= deadline_) {
+    return true;
+  }
+
+  return limits_.smart_pruning &&
+         !CanBestMoveChange(RemainingIterations(iteration, now), tree, root);
+}
+
+bool SearchController::RootChildVisited(const MCTSTree& tree,
+                                        NodeIndex root) const {
+  if (!tree.Expanded(root)) {
+    return false;
+  }
+
+  const NodeIndex first_child = tree.FirstChild(root);
+  const int num_children = tree.NumChildren(root);
+  if (num_children == 0) {
+    // The end of the game; There is nothing to visit.
+    return true;
+  }
+
+  for (int i = 0; i < num_children; i++) {
+    if (tree.Visit(first_child + i) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int SearchController::RemainingIterations(int iteration,
+                                          Clock::time_point now) const {
+  int remaining = limits_.num_iterations - iteration;
+  if (limits_.move_time.count() == 0) {
+    return remaining;
+  }
+
+  // Assumes that the rest of the search runs as fast as it has so far.
+  const double elapsed = std::chrono::duration<double>(now - start_).count();
+  const double left = std::chrono::duration<double>(deadline_ - now).count();
+  if (elapsed > 0) {
+    const double rate = (iteration - start_iteration_) / elapsed;
+    remaining = std::min<double>(remaining, rate * left);
+  }
+  return remaining;
+}
+
+bool SearchController::CanBestMoveChange(int remaining, const MCTSTree& tree,
+                                         NodeIndex root) const {
+  if (!tree.Expanded(root)) {
+    return true;
+  }
+
+  const NodeIndex first_child = tree.FirstChild(root);
+  const int num_children = tree.NumChildren(root);
+  if (num_children <= 1) {
+    // The only move (or the end of the game).
+    return false;
+  }
+
+  int best = 0, second = 0;
+  for (int i = 0; i < num_children; i++) {
+    const int visit = tree.Visit(first_child + i);
+    if (visit > best) {
+      second = best;
+      best = visit;
+    } else if (visit > second) {
+      second = visit;
+    }
+  }
+
+  // Even if every remaining iteration goes to the second best, it stays behind.
+  return second + remaining >= best;
+}
+
+}  // namespace chess
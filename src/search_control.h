@@ -0,0 +1,60 @@
+#ifndef SEARCH_CONTROL_H
+#define SEARCH_CONTROL_H
+
+#include <chrono>
+
+#include "config.h"
+#include "mcts_tree.h"
+
+namespace chess {
+
+// Limits of a single RunMCTS(). The search stops at whichever comes first.
+struct SearchLimits {
+  // Total iterations since the root was set (including the ones of the
+  // previous RunMCTS() on the same root).
+  int num_iterations = 0;
+
+  // No deadline if zero.
+  std::chrono::milliseconds move_time{0};
+
+  // No limit if zero.
+  size_t max_nodes = 0;
+
+  // Stop once the most visited child of the root can not be overtaken.
+  bool smart_pruning = false;
+
+  // Limits of the search from the config (mcts_* fields).
+  static SearchLimits FromConfig(const Config& config);
+};
+
+// Decides when the search stops. Thread safe.
+class SearchController {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // start_iteration is the iteration that the search starts from.
+  SearchController(const SearchLimits& limits, int start_iteration);
+
+  // Whether the search should stop before running the iteration th iteration.
+  bool ShouldStop(int iteration, const MCTSTree& tree, NodeIndex root) const;
+
+ private:
+  // # of iterations that the search can still run (from iteration) within the
+  // iteration budget and the deadline.
+  int RemainingIterations(int iteration, Clock::time_point now) const;
+
+  // Whether a child of the root is visited (or the root has no children).
+  bool RootChildVisited(const MCTSTree& tree, NodeIndex root) const;
+
+  bool CanBestMoveChange(int remaining, const MCTSTree& tree,
+                         NodeIndex root) const;
+
+  SearchLimits limits_;
+  int start_iteration_;
+  Clock::time_point start_;
+  Clock::time_point deadline_;
+};
+
+}  // namespace chess
+
+#endif
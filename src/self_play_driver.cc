@@ -0,0 +1,127 @@
+#include "self_play_driver.h"
+
+#include <algorithm>
+
+namespace chess {
+
+SelfPlayDriver::SelfPlayDriver(Distribution* dist, Config* config,
+                               Evaluator* evaluator, int worker_id,
+                               int model_id)
+    : dist_(dist),
+      config_(config),
+      evaluator_(evaluator),
+      worker_id_(worker_id),
+      model_id_(model_id),
+      games_(std::max(config->self_play_games_per_thread, 1)) {}
+
+void SelfPlayDriver::Run(const StartGame& start_game,
+                         const FinishGame& finish_game) {
+  int num_playing = 0;
+  for (Game& game : games_) {
+    if (StartNewGame(&game, start_game)) {
+      num_playing++;
+    }
+  }
+
+  while (num_playing > 0) {
+    // Leaves of every game go to the evaluator as a single batch.
+    std::vector<const GameState*> states;
+    for (Game& game : games_) {
+      if (!game.playing) {
+        continue;
+      }
+
+      game.leaves =
+          game.mcts->CollectLeaves(config_->mcts_batch_leaf_node_size);
+      for (NodeIndex leaf : game.leaves) {
+        states.push_back(&game.mcts->Tree().State(leaf));
+      }
+    }
+
+    std::vector<float> values = Evaluate(states);
+
+    auto game_values = values.begin();
+    for (Game& game : games_) {
+      if (!game.playing) {
+        continue;
+      }
+
+      game.mcts->ApplyValues(
+          game.leaves, std::vector<float>(game_values,
+                                          game_values + game.leaves.size()));
+      game_values += game.leaves.size();
+
+      if (!game.mcts->SearchDone() || PlayMove(&game)) {
+        continue;
+      }
+
+      finish_game(game.experiences);
+      game.experiences.clear();
+
+      if (!StartNewGame(&game, start_game)) {
+        num_playing--;
+      }
+    }
+  }
+}
+
+bool SelfPlayDriver::StartNewGame(Game* game, const StartGame& start_game) {
+  // States of the previous game are gone.
+  if (game->mcts != nullptr) {
+    game->mcts->EndGame();
+  }
+
+  game->playing = start_game();
+  if (!game->playing) {
+    return false;
+  }
+
+  game->current =
+      std::make_unique<GameState>(GameState::CreateInitGameState());
+  game->num_move = 0;
+
+  BeginSearch(game);
+  return true;
+}
+
+bool SelfPlayDriver::PlayMove(Game* game) {
+  Move move = game->mcts->MoveToMake(/*choose_best_move=*/false);
+  game->experiences.push_back(std::make_unique<Experience>(
+      std::move(game->current), game->mcts->GetPolicyVector(), 0));
+
+  game->current = std::make_unique<GameState>(
+      game->experiences.back()->state.get(), move);
+  game->num_move++;
+
+  if (IsSelfPlayOver(*game->current, game->num_move, *config_)) {
+    SetSelfPlayResult(*game->current, game->num_move, *config_,
+                      &game->experiences);
+    return false;
+  }
+
+  BeginSearch(game);
+  return true;
+}
+
+void SelfPlayDriver::BeginSearch(Game* game) {
+  if (game->mcts == nullptr) {
+    game->mcts = std::make_unique<MCTS>(game->current.get(), evaluator_,
+                                        dist_, config_, worker_id_, model_id_);
+  } else if (!config_->reuse_mcts_tree ||
+             !game->mcts->AdvanceTo(*game->current)) {
+    game->mcts->Reset(game->current.get());
+  }
+
+  game->mcts->BeginSearch(SearchLimits::FromConfig(*config_));
+}
+
+std::vector<float> SelfPlayDriver::Evaluate(
+    const std::vector<const GameState*>& states) {
+  if (config_->use_async_inference) {
+    return evaluator_->EvaluateAsyncBatch(states, worker_id_, model_id_);
+  }
+
+  return evaluator_->EvalulateBatch(states, model_id_);
+}
+
+}  // namespace chess
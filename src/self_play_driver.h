@@ -0,0 +1,71 @@
+#ifndef SELF_PLAY_DRIVER_H
+#define SELF_PLAY_DRIVER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "agent.h"
+#include "config.h"
+#include "distribution.h"
+#include "evaluator.h"
+#include "mcts.h"
+
+namespace chess {
+
+// Plays self_play_games_per_thread self-play games at once on a single
+// thread. Every round collects the leaves of every game into one batch, so
+// the thread does not block on the evaluation of each game separately.
+class SelfPlayDriver {
+ public:
+  using StartGame = std::function<bool()>;
+  using FinishGame =
+      std::function<void(std::vector<std::unique_ptr<Experience>>&)>;
+
+  // The games are evaluated with the model_id th model of the evaluator,
+  // through the requester slot of worker_id.
+  SelfPlayDriver(Distribution* dist, Config* config, Evaluator* evaluator,
+                 int worker_id, int model_id = 0);
+
+  // Play until every game is over and start_game() does not allow a new game.
+  // start_game() is called before each game, and finish_game() gets the
+  // experiences of each finished game.
+  void Run(const StartGame& start_game, const FinishGame& finish_game);
+
+ private:
+  struct Game {
+    std::unique_ptr<MCTS> mcts;
+    std::unique_ptr<GameState> current;
+    std::vector<std::unique_ptr<Experience>> experiences;
+    int num_move = 0;
+
+    // Leaves of the current round that wait for the evaluation.
+    std::vector<NodeIndex> leaves;
+
+    bool playing = false;
+  };
+
+  // Start a new game if start_game() allows. Returns whether it started.
+  bool StartNewGame(Game* game, const StartGame& start_game);
+
+  // Play the move that the finished search chose. Returns false if the game
+  // is over.
+  bool PlayMove(Game* game);
+
+  // Start the search of the current state (reusing the tree if possible).
+  void BeginSearch(Game* game);
+
+  std::vector<float> Evaluate(const std::vector<const GameState*>& states);
+
+  Distribution* dist_;
+  Config* config_;
+  Evaluator* evaluator_;
+  int worker_id_;
+  int model_id_;
+
+  std::vector<Game> games_;
+};
+
+}  // namespace chess
+
+#endif
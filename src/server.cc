@@ -1,5 +1,6 @@
 #include "server.h"
 
+#include <absl/strings/numbers.h>
 #include <nlohmann/json.hpp>
 
 #include "util.h"
@@ -18,6 +19,29 @@ std::optional<std::string> GetFromJson(const json& j,
   return j[field].get<std::string>();
 }
 
+// Integer field of the request, which may also be sent as the string of the
+// integer. nullopt if the field is missing.
+absl::StatusOr<std::optional<int64_t>> GetIntFromJson(
+    const json& j, const std::string& field) {
+  if (!j.count(field)) {
+    return std::optional<int64_t>();
+  }
+
+  const json& value = j[field];
+  if (value.is_number_integer()) {
+    return std::optional<int64_t>(value.get<int64_t>());
+  }
+
+  int64_t parsed = 0;
+  if (value.is_string() &&
+      absl::SimpleAtoi(value.get<std::string>(), &parsed)) {
+    return std::optional<int64_t>(parsed);
+  }
+
+  return absl::InvalidArgumentError(
+      absl::StrCat("Invalid ", field, " [", value.dump(), "]"));
+}
+
 std::string MoveToJsonString(Move m) {
   return absl::StrCat("{'move' : '", m.Str(), "'}");
 }
@@ -74,7 +98,8 @@ void Server::ServerRunner() {
   evaluator_->StartInferenceWorker();
 
   agent_ = std::make_unique<Agent>(&dist_, config_, evaluator_.get(),
-                                   /*worker_manager=*/nullptr, 0);
+                                   /*worker_manager=*/nullptr, 0, 0,
+                                   InferencePriority::kInteractive);
 
   zmq::context_t context(1);
   zmq::socket_t socket(context, ZMQ_REP);
@@ -118,9 +143,14 @@ absl::StatusOr<std::string> Server::HandleRequest(
 
   if (action == "Create") {
     RETURN_ERROR_IF_MISSING(request, client_side);
+    absl::StatusOr<SearchLimits> limits = GetSearchLimits(request);
+    if (!limits.ok()) {
+      return limits.status();
+    }
+
     PieceSide side = client_side == "white" ? WHITE : BLACK;
 
-    absl::StatusOr<Move> move = CreateNewGame(game_id, side);
+    absl::StatusOr<Move> move = CreateNewGame(game_id, side, limits.value());
     if (!move.ok()) {
       return move.status();
     }
@@ -128,7 +158,12 @@ absl::StatusOr<std::string> Server::HandleRequest(
     return MoveToJsonString(move.value());
   } else if (action == "Move") {
     RETURN_ERROR_IF_MISSING(request, move);
-    return DoMove(game_id, Move::MoveFromString(move));
+    absl::StatusOr<SearchLimits> limits = GetSearchLimits(request);
+    if (!limits.ok()) {
+      return limits.status();
+    }
+
+    return DoMove(game_id, Move::MoveFromString(move), limits.value());
   } else if (action == "Resign") {
     if (matches_.find(game_id) == matches_.end()) {
       return absl::InvalidArgumentError("Game does not exist");
@@ -142,7 +177,8 @@ absl::StatusOr<std::string> Server::HandleRequest(
 }
 
 absl::StatusOr<Move> Server::CreateNewGame(const std::string& game_id,
-                                           PieceSide client_side) {
+                                           PieceSide client_side,
+                                           const SearchLimits& limits) {
   if (matches_.find(game_id) != matches_.end()) {
     return absl::InvalidArgumentError("Game already exists");
   }
@@ -151,11 +187,16 @@ absl::StatusOr<Move> Server::CreateNewGame(const std::string& game_id,
   states.push_back(
       std::make_unique<GameState>(GameState::CreateInitGameState()));
 
+  // The game may reuse the id of the finished one.
+  if (last_game_id_ == game_id) {
+    last_game_id_.clear();
+  }
+
   if (client_side == WHITE) {
     // Return dummy move.
     return Move(0, 0, 0, 0);
   } else {
-    Move move = agent_->GetBestMove(*states.back());
+    Move move = GetComputerMove(game_id, *states.back(), limits);
     states.push_back(std::make_unique<GameState>(states.back().get(), move));
 
     return move;
@@ -163,7 +204,8 @@ absl::StatusOr<Move> Server::CreateNewGame(const std::string& game_id,
 }
 
 absl::StatusOr<std::string> Server::DoMove(const std::string& game_id,
-                                           Move move) {
+                                           Move move,
+                                           const SearchLimits& limits) {
   if (matches_.find(game_id) == matches_.end()) {
     return absl::InvalidArgumentError("Game does not exist");
   }
@@ -189,13 +231,73 @@ absl::StatusOr<std::string> Server::DoMove(const std::string& game_id,
     return "{'result' : 'win'}";
   }
 
-  Move computer_move = agent_->GetBestMove(*states.back());
+  Move computer_move = GetComputerMove(game_id, *states.back(), limits);
   states.push_back(
       std::make_unique<GameState>(states.back().get(), computer_move));
 
   return MoveToJsonString(computer_move);
 }
 
+absl::StatusOr<SearchLimits> Server::GetSearchLimits(
+    const json& request) const {
+  SearchLimits limits = SearchLimits::FromConfig(*config_);
+
+  // Stopping once the most visited move is settled does not change the move
+  // that the server plays. The Gumbel root plays the survivor of the
+  // sequential halving instead, which pruning would cut in the middle.
+  limits.smart_pruning = !config_->mcts_gumbel_root;
+
+  absl::StatusOr<std::optional<int64_t>> move_time_ms =
+      GetIntFromJson(request, "move_time_ms");
+  if (!move_time_ms.ok()) {
+    return move_time_ms.status();
+  }
+  if (move_time_ms->has_value()) {
+    if (**move_time_ms < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid move_time_ms [", **move_time_ms, "]"));
+    }
+    limits.move_time = std::chrono::milliseconds(**move_time_ms);
+  }
+
+  absl::StatusOr<std::optional<int64_t>> max_nodes =
+      GetIntFromJson(request, "max_nodes");
+  if (!max_nodes.ok()) {
+    return max_nodes.status();
+  }
+  if (max_nodes->has_value()) {
+    if (**max_nodes < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid max_nodes [", **max_nodes, "]"));
+    }
+    limits.max_nodes = **max_nodes;
+  }
+
+  return limits;
+}
+
+Move Server::GetComputerMove(const std::string& game_id,
+                             const GameState& state,
+                             const SearchLimits& limits) {
+  // While training, play through the trainer's evaluator so that the user's
+  // moves ride along the self-play batches instead of competing for the GPU.
+  auto [shared_evaluator, model_id] = server_context_->GetSharedEvaluator();
+  if (shared_evaluator == nullptr) {
+    // The search tree can be reused only while the same game continues.
+    if (game_id != last_game_id_) {
+      agent_->StartNewGame();
+      last_game_id_ = game_id;
+    }
+    return agent_->GetBestMove(state, limits);
+  }
+
+  Agent agent(&dist_, config_, shared_evaluator.get(),
+              /*worker_manager=*/nullptr,
+              shared_evaluator->InteractiveWorkerId(), model_id,
+              InferencePriority::kInteractive);
+  return agent.GetBestMove(state, limits);
+}
+
 absl::StatusOr<std::string> Server::HandleWorkerInfo() {
   json result;
 
@@ -220,10 +322,39 @@ absl::StatusOr<std::string> Server::HandleWorkerInfo() {
     auto& worker_info = inference_worker_infos.emplace_back();
     worker_info["total_inference_batch_size"] = info.total_inference_batch_size;
     worker_info["total_num_inference"] = info.total_num_inference;
+    worker_info["total_flush_by_target"] = info.total_flush_by_target;
+    worker_info["total_flush_by_deadline"] = info.total_flush_by_deadline;
+    worker_info["total_batch_wait_us"] = info.total_batch_wait_us;
+    worker_info["current_target_batch_size"] = info.current_target_batch_size;
   }
 
   result["inference_worker_info"] = inference_worker_infos;
 
+  const auto& cache_info =
+      server_context_->GetWorkerManager()->GetEvalCacheInfo();
+
+  std::map<std::string, uint64_t> eval_cache_info;
+  eval_cache_info["total_hits"] = cache_info.total_hits.load();
+  eval_cache_info["total_misses"] = cache_info.total_misses.load();
+
+  result["eval_cache_info"] = eval_cache_info;
+
+  std::map<std::string, std::map<std::string, uint64_t>> latency_infos;
+  for (auto [name, priority] :
+       {std::make_pair("background", InferencePriority::kBackground),
+        std::make_pair("interactive", InferencePriority::kInteractive)}) {
+    const auto& info =
+        server_context_->GetWorkerManager()->GetInferenceLatencyInfo(priority);
+
+    auto& latency_info = latency_infos[name];
+    latency_info["total_num_request"] = info.total_num_request.load();
+    latency_info["total_latency_us"] = info.total_latency_us.load();
+    latency_info["max_latency_us"] = info.max_latency_us.load();
+    latency_info["total_deadline_miss"] = info.total_deadline_miss.load();
+  }
+
+  result["inference_latency_info"] = latency_infos;
+
   return result.dump();
 }
 
@@ -4,12 +4,14 @@
 #include <absl/status/statusor.h>
 
 #include <memory>
+#include <nlohmann/json.hpp>
 #include <unordered_map>
 #include <zmq.hpp>
 
 #include "chess.h"
 #include "config.h"
 #include "game_state.h"
+#include "search_control.h"
 #include "server_context.h"
 
 namespace chess {
@@ -19,7 +21,8 @@ class Server {
  public:
   Server(Config* config, ServerContext* server_context)
       : config_(config),
-        chess_nn_(config->num_layer, config->num_filter),
+        chess_nn_(config->num_layer, config->num_filter,
+                  config->use_conv_policy_head),
         server_context_(server_context) {
     chess_nn_->to(config_->device);
   }
@@ -29,10 +32,12 @@ class Server {
   // Create a new game where the client takes client_side. If the client plays
   // black, then the server returns the first move of white.
   absl::StatusOr<Move> CreateNewGame(const std::string& game_id,
-                                     PieceSide client_side);
+                                     PieceSide client_side,
+                                     const SearchLimits& limits);
 
   // Client makes the move.
-  absl::StatusOr<std::string> DoMove(const std::string& game_id, Move move);
+  absl::StatusOr<std::string> DoMove(const std::string& game_id, Move move,
+                                     const SearchLimits& limits);
 
   // Handle WorkerInfo request.
   absl::StatusOr<std::string> HandleWorkerInfo();
@@ -41,12 +46,22 @@ class Server {
   absl::StatusOr<std::string> HandleGameInfo(
       std::optional<std::string> game_id);
 
+  // Limits of the search for the move of the computer. The request may
+  // override the config with "move_time_ms" and "max_nodes", given either as
+  // the integers or as their strings.
+  absl::StatusOr<SearchLimits> GetSearchLimits(
+      const nlohmann::json& request) const;
+
   // Start the server.
   void RunServer();
 
  private:
   void ServerRunner();
 
+  // Searches the move of the computer on the state of the game.
+  Move GetComputerMove(const std::string& game_id, const GameState& state,
+                       const SearchLimits& limits);
+
   // Mapping between user_id to the current matches.
   std::unordered_map<std::string, std::vector<std::unique_ptr<GameState>>>
       matches_;
@@ -59,6 +74,9 @@ class Server {
   std::unique_ptr<Evaluator> evaluator_;
   std::unique_ptr<Agent> agent_;
 
+  // Game that the search tree of agent_ belongs to.
+  std::string last_game_id_;
+
   ServerContext* server_context_;
   std::unique_ptr<std::thread> server_runner_;
 };
@@ -38,4 +38,17 @@ void ServerContext::DeleteRecordedGames() {
   games_.clear();
 }
 
+void ServerContext::SetSharedEvaluator(std::shared_ptr<Evaluator> evaluator,
+                                       int model_id) {
+  std::lock_guard lk(m_evaluator_);
+  shared_evaluator_ = std::move(evaluator);
+  shared_model_id_ = model_id;
+}
+
+std::pair<std::shared_ptr<Evaluator>, int>
+ServerContext::GetSharedEvaluator() {
+  std::lock_guard lk(m_evaluator_);
+  return std::make_pair(shared_evaluator_, shared_model_id_);
+}
+
 }  // namespace chess
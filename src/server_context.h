@@ -5,6 +5,7 @@
 
 #include "chess.h"
 #include "config.h"
+#include "evaluator.h"
 #include "move.h"
 #include "worker_manager.h"
 
@@ -23,11 +24,22 @@ class ServerContext {
 
   std::vector<std::pair<GameResult, std::vector<Move>>> GetGames();
 
+  // Shares the evaluator of the trainer with the server so that the interactive
+  // games are batched together with the self-play. Set nullptr to unshare.
+  void SetSharedEvaluator(std::shared_ptr<Evaluator> evaluator, int model_id);
+
+  // Returns the shared evaluator (nullptr if not shared) and its model id.
+  std::pair<std::shared_ptr<Evaluator>, int> GetSharedEvaluator();
+
  private:
   WorkerManager worker_manager_;
 
   std::mutex m_game_;
   std::vector<std::pair<GameResult, std::vector<Move>>> games_;
+
+  std::mutex m_evaluator_;
+  std::shared_ptr<Evaluator> shared_evaluator_;
+  int shared_model_id_ = 0;
 };
 
 }  // namespace chess
@@ -0,0 +1,160 @@
+#include "shm_evaluator.h"
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+
+#include "nn/nn_util.h"
+
+namespace chess {
+
+absl::StatusOr<std::unique_ptr<ShmEvaluator>> ShmEvaluator::Create(
+    const Config* config, WorkerManager* worker_manager) {
+  auto channel = ShmInferenceChannel::Open(config->inference_server_name);
+  if (!channel.ok()) {
+    return channel.status();
+  }
+
+  return std::unique_ptr<ShmEvaluator>(
+      new ShmEvaluator(std::move(channel).value(), config, worker_manager));
+}
+
+absl::StatusOr<std::vector<float>> ShmEvaluator::EvaluateOnServer(
+    const std::vector<const GameState*>& states, int model_id) {
+  if (model_id != 0) {
+    return absl::InvalidArgumentError(
+        "Inference server hosts only the model 0, got " +
+        std::to_string(model_id));
+  }
+
+  std::shared_ptr<ShmInferenceChannel> channel = GetChannel();
+
+  absl::StatusOr<std::vector<float>> result =
+      EvaluateOnChannel(channel.get(), states);
+  if (result.ok() || result.status().code() != absl::StatusCode::kUnavailable) {
+    return result;
+  }
+
+  if (absl::Status status = Reopen(channel.get()); !status.ok()) {
+    return status;
+  }
+  return EvaluateOnChannel(GetChannel().get(), states);
+}
+
+std::shared_ptr<ShmInferenceChannel> ShmEvaluator::GetChannel() const {
+  std::lock_guard<std::mutex> lk(channel_m_);
+  return channel_;
+}
+
+absl::Status ShmEvaluator::Reopen(const ShmInferenceChannel* failed) {
+  std::lock_guard<std::mutex> lk(channel_m_);
+  if (channel_.get() != failed) {
+    return absl::OkStatus();
+  }
+
+  auto channel = ShmInferenceChannel::Open(config_->inference_server_name);
+  if (!channel.ok()) {
+    return channel.status();
+  }
+
+  // Same region of the dead server unless it is restarted.
+  if (absl::Status status = (*channel)->CheckServer(); !status.ok()) {
+    return status;
+  }
+
+  fmt::print("Reconnected to the inference server (generation {})\n",
+             (*channel)->Generation());
+  channel_ = std::move(channel).value();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<float>> ShmEvaluator::EvaluateOnChannel(
+    ShmInferenceChannel* channel,
+    const std::vector<const GameState*>& states) {
+  const int slot_rows = channel->SlotRows();
+
+  std::vector<float> result;
+  result.reserve(states.size());
+
+  // Requests larger than the slot are sent in chunks.
+  for (size_t chunk_start = 0; chunk_start < states.size();
+       chunk_start += slot_rows) {
+    const int num_rows = std::min<int>(slot_rows, states.size() - chunk_start);
+
+    absl::StatusOr<int> slot = channel->AcquireSlot();
+    if (!slot.ok()) {
+      return slot.status();
+    }
+
+    torch::Tensor input = torch::from_blob(channel->SlotInput(*slot),
+                                           {slot_rows, kNumStatePlanes, 8, 8});
+    for (int i = 0; i < num_rows; i++) {
+      torch::Tensor row = input[i];
+      GameStateToTensor(*states[chunk_start + i], &row);
+    }
+
+    channel->Submit(*slot, num_rows);
+
+    absl::StatusOr<const float*> values = channel->WaitForResult(*slot);
+    if (values.ok()) {
+      result.insert(result.end(), *values, *values + num_rows);
+    }
+
+    channel->ReleaseSlot(*slot);
+
+    if (!values.ok()) {
+      return values.status();
+    }
+  }
+
+  return result;
+}
+
+uint64_t ShmEvaluator::PublishModel(int model_id, ChessNN /*model*/) {
+  fmt::print(
+      "Cannot publish the model {} to the inference server; Load it in the "
+      "server instead\n",
+      model_id);
+  std::abort();
+}
+
+uint64_t ShmEvaluator::ModelVersion(int model_id) const {
+  if (model_id != 0) {
+    fmt::print("Inference server hosts only the model 0, got {}\n", model_id);
+    std::abort();
+  }
+
+  // The restarted server may serve the other weights, so the cached values of
+  // each generation of the region are kept apart.
+  return GetChannel()->Generation();
+}
+
+std::vector<float> ShmEvaluator::EvaluateThroughWorker(
+    const std::vector<const GameState*>& states, int /*worker_id*/,
+    int model_id, InferencePriority /*priority*/) {
+  absl::StatusOr<std::vector<float>> result =
+      EvaluateOnServer(states, model_id);
+  if (!result.ok()) {
+    fmt::print("Inference server failed: {}\n", result.status().ToString());
+    std::abort();
+  }
+
+  return std::move(result).value();
+}
+
+void ShmEvaluator::SubmitAsyncBatch(const std::vector<const GameState*>& states,
+                                    int worker_id, int model_id,
+                                    InferencePriority priority) {
+  std::vector<float> result =
+      EvaluateAsyncBatch(states, worker_id, model_id, priority);
+
+  std::lock_guard<std::mutex> lk(results_m_);
+  results_[worker_id] = std::move(result);
+}
+
+std::vector<float> ShmEvaluator::TakeAsyncBatchResult(int worker_id) {
+  std::lock_guard<std::mutex> lk(results_m_);
+  return std::move(results_[worker_id]);
+}
+
+}  // namespace chess
@@ -0,0 +1,101 @@
+#ifndef SHM_EVALUATOR_H
+#define SHM_EVALUATOR_H
+
+#include <absl/status/statusor.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "evaluator.h"
+#include "shm_inference.h"
+
+namespace chess {
+
+// Evaluator that sends every inference to the out of process inference server
+// (app/inference_server.cc) through the shared memory. The requests of every
+// client process are batched together by the server.
+//
+// The Evaluator interface has no way to report the errors, so its methods
+// abort the process when the server is gone. Use EvaluateOnServer() to handle
+// them instead.
+class ShmEvaluator : public Evaluator {
+ public:
+  // Connect to the server listening on config->inference_server_name.
+  static absl::StatusOr<std::unique_ptr<ShmEvaluator>> Create(
+      const Config* config, WorkerManager* worker_manager);
+
+  // Evaluate the states (which are not terminal) on the server. If the server
+  // is gone, re-opens the region once (the restarted server creates a new
+  // generation of it) and retries. Fails with kUnavailable if that fails too.
+  // The server hosts a single model, so model_id must be 0.
+  absl::StatusOr<std::vector<float>> EvaluateOnServer(
+      const std::vector<const GameState*>& states, int model_id = 0);
+
+  // The model is loaded by the server; Publishing one here aborts.
+  uint64_t PublishModel(int model_id, ChessNN model) override;
+
+  // Generation of the region of the server (see
+  // ShmInferenceChannel::Generation()), so that the cached values of a dead
+  // server are not used after Reopen(). Aborts unless model_id is 0.
+  uint64_t ModelVersion(int model_id) const override;
+
+  // Sync and async versions are same; Both wait for the server.
+  float Evalulate(const GameState& state, int model_id = 0) override {
+    return EvaluateAsync(state, /*worker_id=*/0, model_id);
+  }
+
+  std::vector<float> EvalulateBatch(std::vector<const GameState*> states,
+                                    int model_id = 0) override {
+    return EvaluateAsyncBatch(states, /*worker_id=*/0, model_id);
+  }
+
+  // The server does the inference.
+  void StartInferenceWorker() override {}
+
+  // There is no non-blocking path to the server; SubmitAsyncBatch() waits for
+  // the server and the result is ready right away.
+  void SubmitAsyncBatch(
+      const std::vector<const GameState*>& states, int worker_id,
+      int model_id = 0,
+      InferencePriority priority = InferencePriority::kBackground) override;
+  bool PollAsyncBatch(int /*worker_id*/) override { return true; }
+  std::vector<float> TakeAsyncBatchResult(int worker_id) override;
+
+ protected:
+  // The server serves in the arrival order, so priority is ignored.
+  std::vector<float> EvaluateThroughWorker(
+      const std::vector<const GameState*>& states, int worker_id, int model_id,
+      InferencePriority priority) override;
+
+ private:
+  ShmEvaluator(std::unique_ptr<ShmInferenceChannel> channel,
+               const Config* config, WorkerManager* worker_manager)
+      : Evaluator(/*chess_net=*/nullptr, config, worker_manager),
+        config_(config),
+        channel_(std::move(channel)) {}
+
+  absl::StatusOr<std::vector<float>> EvaluateOnChannel(
+      ShmInferenceChannel* channel,
+      const std::vector<const GameState*>& states);
+
+  std::shared_ptr<ShmInferenceChannel> GetChannel() const;
+
+  // Replace the failed channel with the region that the server listens on
+  // now. No-op if another thread already did.
+  absl::Status Reopen(const ShmInferenceChannel* failed);
+
+  const Config* config_;
+
+  // Swapped by Reopen(). The requests in flight keep the old one alive.
+  mutable std::mutex channel_m_;
+  std::shared_ptr<ShmInferenceChannel> channel_;
+
+  // Results of SubmitAsyncBatch() by the worker id.
+  std::mutex results_m_;
+  std::unordered_map<int, std::vector<float>> results_;
+};
+
+}  // namespace chess
+
+#endif
@@ -0,0 +1,441 @@
+#include "shm_inference.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "completion_slot.h"
+#include "nn/nn_util.h"
+
+namespace chess {
+namespace {
+
+constexpr uint32_t kMagic = 0x43485349;
+
+// # of floats of a single encoded game state.
+constexpr size_t kRowSize = kNumStatePlanes * 8 * 8;
+
+constexpr size_t kAlignment = 64;
+
+enum SlotState : uint32_t {
+  kSlotFree = 0,
+  kSlotClaimed,
+  kSlotSubmitted,
+  kSlotRunning,
+  kSlotDone,
+};
+
+// Both sides wake up at least this often, so a dead peer does not hang the
+// other one in the futex forever. The clients check the server on each wake.
+constexpr std::chrono::milliseconds kPollInterval(100);
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Futex word must be a plain 32 bit integer.");
+static_assert(std::atomic<int64_t>::is_always_lock_free,
+              "Atomics in the shared memory must be lock free.");
+
+int64_t NowMs() {
+  // CLOCK_MONOTONIC is the same across the processes.
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool ProcessIsGone(pid_t pid) { return kill(pid, 0) < 0 && errno == ESRCH; }
+
+size_t AlignUp(size_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected,
+               std::chrono::milliseconds timeout) {
+  const auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(timeout);
+
+  timespec ts;
+  ts.tv_sec = seconds.count();
+  ts.tv_nsec =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds)
+          .count();
+
+  // Not FUTEX_PRIVATE since the word is shared across the processes.
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+          &ts, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<uint32_t>* word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+}  // namespace
+
+struct ShmInferenceChannel::Header {
+  uint32_t magic;
+  int32_t num_slots;
+  int32_t slot_rows;
+  int32_t server_pid;
+  uint32_t generation;
+
+  // Set once the server is done with the region.
+  std::atomic<uint32_t> closed;
+
+  // Bumped whenever a slot is submitted. The server sleeps on this.
+  std::atomic<uint32_t> request_seq;
+
+  // Clients wake up the server only when it is parked.
+  std::atomic<uint32_t> server_parked;
+};
+
+struct alignas(kAlignment) ShmInferenceChannel::Slot {
+  // One of SlotState. The client sleeps on this.
+  std::atomic<uint32_t> state;
+  int32_t num_rows;
+
+  // Pid of the client that claimed the slot, and when (see NowMs()). The pid
+  // is 0 while the slot is being claimed or released.
+  std::atomic<int32_t> owner_pid;
+  std::atomic<int64_t> claim_time_ms;
+};
+
+namespace {
+
+absl::Status ErrnoError(const std::string& what) {
+  return absl::InternalError(what + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+size_t ShmInferenceChannel::RegionSize(int num_slots, int slot_rows) {
+  return AlignUp(sizeof(Header)) + AlignUp(num_slots * sizeof(Slot)) +
+         AlignUp(sizeof(float) * num_slots * slot_rows * kRowSize) +
+         AlignUp(sizeof(float) * num_slots * slot_rows);
+}
+
+absl::StatusOr<std::unique_ptr<ShmInferenceChannel>>
+ShmInferenceChannel::Create(const std::string& name, int num_slots,
+                            int slot_rows) {
+  if (num_slots <= 0 || slot_rows <= 0) {
+    return absl::InvalidArgumentError("Slot size must be positive");
+  }
+
+  // Region of the previous server (which could have crashed). Its clients
+  // are told to move on to this one.
+  uint32_t generation = 0;
+  if (auto previous = Open(name); previous.ok()) {
+    (*previous)->Close();
+    generation = (*previous)->Generation() + 1;
+  }
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return ErrnoError("shm_open " + name);
+  }
+
+  const size_t region_size = RegionSize(num_slots, slot_rows);
+  if (ftruncate(fd, region_size) < 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return ErrnoError("ftruncate " + name);
+  }
+
+  void* region =
+      mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (region == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return ErrnoError("mmap " + name);
+  }
+
+  // The region is zero filled, so every slot starts as kSlotFree.
+  Header* header = new (region) Header();
+  header->num_slots = num_slots;
+  header->slot_rows = slot_rows;
+  header->server_pid = getpid();
+  header->generation = generation;
+
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+
+  return std::unique_ptr<ShmInferenceChannel>(
+      new ShmInferenceChannel(name, region, region_size, /*owner=*/true));
+}
+
+absl::StatusOr<std::unique_ptr<ShmInferenceChannel>> ShmInferenceChannel::Open(
+    const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return ErrnoError("shm_open " + name);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return ErrnoError("fstat " + name);
+  }
+
+  const size_t region_size = st.st_size;
+  if (region_size < sizeof(Header)) {
+    close(fd);
+    return absl::UnavailableError("Inference server is not ready");
+  }
+
+  void* region =
+      mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (region == MAP_FAILED) {
+    return ErrnoError("mmap " + name);
+  }
+
+  const Header* header = static_cast<const Header*>(region);
+  if (header->magic != kMagic ||
+      RegionSize(header->num_slots, header->slot_rows) != region_size) {
+    munmap(region, region_size);
+    return absl::UnavailableError("Inference server is not ready");
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return std::unique_ptr<ShmInferenceChannel>(
+      new ShmInferenceChannel(name, region, region_size, /*owner=*/false));
+}
+
+ShmInferenceChannel::ShmInferenceChannel(std::string name, void* region,
+                                         size_t region_size, bool owner)
+    : name_(std::move(name)),
+      region_(region),
+      region_size_(region_size),
+      owner_(owner) {
+  char* current = static_cast<char*>(region);
+
+  header_ = static_cast<Header*>(region);
+  current += AlignUp(sizeof(Header));
+
+  slots_ = reinterpret_cast<Slot*>(current);
+  current += AlignUp(NumSlots() * sizeof(Slot));
+
+  inputs_ = reinterpret_cast<float*>(current);
+  current += AlignUp(sizeof(float) * NumSlots() * SlotRows() * kRowSize);
+
+  outputs_ = reinterpret_cast<float*>(current);
+}
+
+ShmInferenceChannel::~ShmInferenceChannel() {
+  // Once closed by the next server, the name belongs to its region.
+  if (owner_ && !header_->closed.load()) {
+    Close();
+    shm_unlink(name_.c_str());
+  }
+  munmap(region_, region_size_);
+}
+
+void ShmInferenceChannel::Close() {
+  header_->closed.store(1);
+  for (int slot = 0; slot < NumSlots(); slot++) {
+    FutexWakeAll(&slots_[slot].state);
+  }
+}
+
+int ShmInferenceChannel::NumSlots() const { return header_->num_slots; }
+int ShmInferenceChannel::SlotRows() const { return header_->slot_rows; }
+
+uint32_t ShmInferenceChannel::Generation() const {
+  return header_->generation;
+}
+
+absl::Status ShmInferenceChannel::CheckServer() const {
+  if (header_->closed.load()) {
+    return absl::UnavailableError("Inference server has shut down");
+  }
+
+  // The server could also be killed before it closes the region.
+  if (ProcessIsGone(header_->server_pid)) {
+    return absl::UnavailableError(
+        "Inference server (pid " + std::to_string(header_->server_pid) +
+        ") is gone");
+  }
+
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> ShmInferenceChannel::AcquireSlot() {
+  if (header_->closed.load()) {
+    return CheckServer();
+  }
+
+  // Start from different slots in each thread so that they do not fight over
+  // the same one.
+  static std::atomic<int> next_hint = 0;
+  thread_local int hint = next_hint.fetch_add(1);
+
+  while (true) {
+    for (int i = 0; i < NumSlots(); i++) {
+      const int slot = (hint + i) % NumSlots();
+
+      uint32_t expected = kSlotFree;
+      if (slots_[slot].state.compare_exchange_strong(
+              expected, kSlotClaimed, std::memory_order_acquire)) {
+        slots_[slot].claim_time_ms.store(NowMs(), std::memory_order_relaxed);
+        slots_[slot].owner_pid.store(getpid(), std::memory_order_release);
+        hint = slot;
+        return slot;
+      }
+    }
+
+    // Every slot is in use. Slots are freed as soon as the next forward is
+    // done, so just yield (unless no one is going to free them).
+    if (absl::Status status = CheckServer(); !status.ok()) {
+      return status;
+    }
+    std::this_thread::yield();
+  }
+}
+
+float* ShmInferenceChannel::SlotInput(int slot) {
+  return inputs_ + static_cast<size_t>(slot) * SlotRows() * kRowSize;
+}
+
+void ShmInferenceChannel::Submit(int slot, int num_rows) {
+  slots_[slot].num_rows = num_rows;
+  slots_[slot].state.store(kSlotSubmitted, std::memory_order_release);
+
+  // Both of these are sequentially consistent. Together with the ones in
+  // TakeRequests, either the parked server sees the new slot, or we see the
+  // parked server and wake it up.
+  header_->request_seq.fetch_add(1);
+  if (header_->server_parked.load()) {
+    FutexWakeAll(&header_->request_seq);
+  }
+}
+
+absl::StatusOr<const float*> ShmInferenceChannel::WaitForResult(int slot) {
+  auto& state = slots_[slot].state;
+
+  for (int i = 0; i < SpinCountBeforePark(1024); i++) {
+    if (state.load(std::memory_order_acquire) == kSlotDone) {
+      return SlotOutput(slot);
+    }
+    CpuRelax();
+  }
+
+  while (true) {
+    const uint32_t current = state.load(std::memory_order_acquire);
+    if (current == kSlotDone) {
+      return SlotOutput(slot);
+    }
+
+    if (absl::Status status = CheckServer(); !status.ok()) {
+      return status;
+    }
+
+    FutexWait(&state, current, kPollInterval);
+  }
+}
+
+void ShmInferenceChannel::ReleaseSlot(int slot) {
+  slots_[slot].owner_pid.store(0, std::memory_order_relaxed);
+  slots_[slot].state.store(kSlotFree, std::memory_order_release);
+}
+
+std::vector<int> ShmInferenceChannel::TakeRequests(
+    int max_rows, std::chrono::milliseconds timeout) {
+  std::vector<int> taken = TakeSubmittedSlots(max_rows);
+  if (!taken.empty()) {
+    return taken;
+  }
+
+  const uint32_t seq = header_->request_seq.load();
+  header_->server_parked.store(1);
+
+  // The slot could be submitted before the server is marked as parked.
+  taken = TakeSubmittedSlots(max_rows);
+  if (taken.empty()) {
+    FutexWait(&header_->request_seq, seq, timeout);
+    taken = TakeSubmittedSlots(max_rows);
+  }
+
+  header_->server_parked.store(0);
+  return taken;
+}
+
+std::vector<int> ShmInferenceChannel::TakeSubmittedSlots(int max_rows) {
+  std::vector<int> taken;
+
+  int total_rows = 0;
+  for (int slot = 0; slot < NumSlots(); slot++) {
+    if (slots_[slot].state.load(std::memory_order_acquire) != kSlotSubmitted) {
+      continue;
+    }
+
+    const int num_rows = slots_[slot].num_rows;
+    if (!taken.empty() && total_rows + num_rows > max_rows) {
+      continue;
+    }
+
+    slots_[slot].state.store(kSlotRunning, std::memory_order_relaxed);
+    taken.push_back(slot);
+    total_rows += num_rows;
+  }
+
+  return taken;
+}
+
+int ShmInferenceChannel::SlotNumRows(int slot) const {
+  return slots_[slot].num_rows;
+}
+
+float* ShmInferenceChannel::SlotOutput(int slot) {
+  return outputs_ + static_cast<size_t>(slot) * SlotRows();
+}
+
+void ShmInferenceChannel::Complete(int slot) {
+  slots_[slot].state.store(kSlotDone, std::memory_order_release);
+  FutexWakeAll(&slots_[slot].state);
+}
+
+int ShmInferenceChannel::ReclaimSlots(std::chrono::milliseconds min_claim_age) {
+  const int64_t claimed_before = NowMs() - min_claim_age.count();
+
+  int num_reclaimed = 0;
+  for (int slot = 0; slot < NumSlots(); slot++) {
+    Slot& s = slots_[slot];
+
+    // The running slots are completed first.
+    const uint32_t state = s.state.load(std::memory_order_acquire);
+    if (state == kSlotFree || state == kSlotRunning) {
+      continue;
+    }
+
+    int32_t owner = s.owner_pid.load(std::memory_order_acquire);
+    if (owner == 0 ||
+        s.claim_time_ms.load(std::memory_order_relaxed) > claimed_before ||
+        !ProcessIsGone(owner)) {
+      continue;
+    }
+
+    // Fails if the slot changed hands in the meantime. Otherwise no one else
+    // touches the slot of the dead owner.
+    if (s.owner_pid.compare_exchange_strong(owner, 0)) {
+      s.state.store(kSlotFree, std::memory_order_release);
+      num_reclaimed++;
+    }
+  }
+
+  return num_reclaimed;
+}
+
+}  // namespace chess
@@ -0,0 +1,110 @@
+#ifndef SHM_INFERENCE_H
+#define SHM_INFERENCE_H
+
+#include <absl/status/statusor.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace chess {
+
+// Shared memory channel between the out of process inference server and its
+// clients (the self-play processes).
+//
+// The region is split into fixed size slots. Each slot holds up to SlotRows()
+// encoded game states and their values. A client claims a free slot, encodes
+// its states directly into the slot and submits it. The server takes every
+// submitted slot as a single batch, writes the values back and wakes up the
+// clients. Both sides sleep on futexes placed in the shared region.
+class ShmInferenceChannel {
+ public:
+  // Create the region (called by the server). The existing region with the
+  // same name is replaced; It is closed, so its clients fail and re-open the
+  // new one, which is of the next generation. The region is unlinked when the
+  // channel is deleted (unless it is replaced by then).
+  static absl::StatusOr<std::unique_ptr<ShmInferenceChannel>> Create(
+      const std::string& name, int num_slots, int slot_rows);
+
+  // Open the region created by the server (called by the client).
+  static absl::StatusOr<std::unique_ptr<ShmInferenceChannel>> Open(
+      const std::string& name);
+
+  ~ShmInferenceChannel();
+
+  int NumSlots() const;
+  int SlotRows() const;
+
+  // Generation of the region. Each Create() of the same name bumps it.
+  uint32_t Generation() const;
+
+  // Client side.
+
+  // Ok while the server is alive.
+  absl::Status CheckServer() const;
+
+  // Claim the free slot. Waits until one is available.
+  absl::StatusOr<int> AcquireSlot();
+
+  // Where the client encodes its states (SlotRows() * 119 * 8 * 8 floats).
+  float* SlotInput(int slot);
+
+  // Hand num_rows states in the slot to the server.
+  void Submit(int slot, int num_rows);
+
+  // Wait until the server fills the values. Returns the values. The slot
+  // still has to be released if this fails.
+  absl::StatusOr<const float*> WaitForResult(int slot);
+
+  void ReleaseSlot(int slot);
+
+  // Server side.
+
+  // Take the submitted slots whose rows add up to at most max_rows (at least
+  // one slot is taken if any). Waits up to timeout when nothing is submitted.
+  std::vector<int> TakeRequests(int max_rows,
+                                std::chrono::milliseconds timeout);
+
+  int SlotNumRows(int slot) const;
+  float* SlotOutput(int slot);
+
+  // Mark the values of the slot as ready and wake up the client.
+  void Complete(int slot);
+
+  // Free the slots (except the running ones) whose owner process died, so the
+  // crashed clients do not leak them. Only the slots claimed at least
+  // min_claim_age ago are checked. Returns the # of slots freed.
+  int ReclaimSlots(std::chrono::milliseconds min_claim_age);
+
+ private:
+  struct Header;
+  struct Slot;
+
+  ShmInferenceChannel(std::string name, void* region, size_t region_size,
+                      bool owner);
+
+  static size_t RegionSize(int num_slots, int slot_rows);
+
+  std::vector<int> TakeSubmittedSlots(int max_rows);
+
+  // Tell the clients that the server is gone and wake up the waiting ones.
+  void Close();
+
+  Header* header_;
+  Slot* slots_;
+  float* inputs_;
+  float* outputs_;
+
+  std::string name_;
+  void* region_;
+  size_t region_size_;
+
+  // True if this side created the region.
+  bool owner_;
+};
+
+}  // namespace chess
+
+#endif
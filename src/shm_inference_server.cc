@@ -0,0 +1,72 @@
+#include "shm_inference_server.h"
+
+#include <fmt/core.h>
+
+#include "nn/nn_util.h"
+
+namespace chess {
+namespace {
+
+// How often the server checks whether it should stop while idle.
+constexpr std::chrono::milliseconds kIdleTimeout(100);
+
+// How often the slots of the crashed clients are reclaimed. A slot is held
+// for a single request, so any slot held longer than this is worth checking.
+constexpr std::chrono::milliseconds kReclaimInterval(1000);
+
+}  // namespace
+
+void ShmInferenceServer::Run() {
+  torch::NoGradGuard no_grad;
+
+  auto last_reclaim = std::chrono::steady_clock::now();
+  while (!should_stop_) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_reclaim >= kReclaimInterval) {
+      if (int num_reclaimed = channel_->ReclaimSlots(kReclaimInterval)) {
+        fmt::print("Reclaimed {} slots of the dead clients\n", num_reclaimed);
+      }
+      last_reclaim = now;
+    }
+
+    std::vector<int> slots = channel_->TakeRequests(
+        config_->inference_max_batch_size, kIdleTimeout);
+    if (slots.empty()) {
+      continue;
+    }
+
+    InferenceSlots(slots);
+  }
+}
+
+void ShmInferenceServer::InferenceSlots(const std::vector<int>& slots) {
+  std::vector<torch::Tensor> batches;
+  for (int slot : slots) {
+    // Views of the shared memory; No copy until they are concatenated.
+    batches.push_back(torch::from_blob(
+        channel_->SlotInput(slot),
+        {channel_->SlotNumRows(slot), kNumStatePlanes, 8, 8}));
+  }
+
+  torch::Tensor batch_tensor = torch::cat(batches).to(config_->device);
+
+  torch::Tensor cpu_tensor;
+  {
+    ReducedPrecisionGuard precision_guard(config_);
+    torch::Tensor value_tensor = chess_net_->GetValue(batch_tensor);
+
+    torch::Device device(torch::kCPU);
+    cpu_tensor = value_tensor.to(device, torch::kFloat).contiguous();
+  }
+
+  const float* values = cpu_tensor.data_ptr<float>();
+  for (int slot : slots) {
+    const int num_rows = channel_->SlotNumRows(slot);
+    std::copy(values, values + num_rows, channel_->SlotOutput(slot));
+    values += num_rows;
+
+    channel_->Complete(slot);
+  }
+}
+
+}  // namespace chess
@@ -0,0 +1,40 @@
+#ifndef SHM_INFERENCE_SERVER_H
+#define SHM_INFERENCE_SERVER_H
+
+#include <atomic>
+
+#include "config.h"
+#include "nn/chess_nn.h"
+#include "shm_inference.h"
+
+namespace chess {
+
+// Serves the value of the game states submitted to the channel by the client
+// processes (see ShmEvaluator). Every submitted slot is inferenced together in
+// a single batch.
+class ShmInferenceServer {
+ public:
+  ShmInferenceServer(ChessNN chess_net, const Config* config,
+                     ShmInferenceChannel* channel)
+      : chess_net_(chess_net), config_(config), channel_(channel) {}
+
+  // Serve until Stop() is called. Also reclaims the slots of the clients that
+  // died.
+  void Run();
+
+  // Safe to call from the signal handler.
+  void Stop() { should_stop_ = true; }
+
+ private:
+  void InferenceSlots(const std::vector<int>& slots);
+
+  ChessNN chess_net_;
+  const Config* config_;
+  ShmInferenceChannel* channel_;
+
+  std::atomic<bool> should_stop_ = false;
+};
+
+}  // namespace chess
+
+#endif
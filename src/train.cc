@@ -4,8 +4,10 @@
 
 #include "agent.h"
 #include "chess.h"
+#include "coroutine_self_play.h"
 #include "evaluator.h"
 #include "nn/nn_util.h"
+#include "self_play_driver.h"
 #include "util.h"
 
 namespace chess {
@@ -47,17 +49,23 @@ void Train::DoTrain() {
     torch::save(current_best_, model_name);
   }
 
-  Evaluator target_eval(train_target_, config_,
-                        server_context_->GetWorkerManager());
-  target_eval.StartInferenceWorker();
+  // Both models share the inference workers, so the gating matches fill the
+  // batches as full as the self-play does.
+  auto evaluator = std::make_shared<Evaluator>(
+      std::vector<ChessNN>{train_target_, current_best_}, config_,
+      server_context_->GetWorkerManager());
+  evaluator->StartInferenceWorker();
 
-  Evaluator current_eval(current_best_, config_,
-                         server_context_->GetWorkerManager());
-  current_eval.StartInferenceWorker();
+  // The server plays the users with the current best model through the
+  // interactive queue of this evaluator.
+  server_context_->SetSharedEvaluator(evaluator, kCurrentBestModelId);
 
   for (int i = 0; i < config_->num_epoch; i++) {
-    torch::load(train_target_, model_name);
-    train_target_->to(config_->device);
+    // Every epoch trains from the current best. Models are copied in memory
+    // and published as snapshots, so the inference workers (including the
+    // ones that serve the interactive games) never see half-updated weights.
+    CopyChessNNWeights(current_best_, train_target_);
+    evaluator->PublishModel(kTargetModelId, train_target_);
 
     auto start = std::chrono::high_resolution_clock::now();
     exp_gen_start_ = std::chrono::high_resolution_clock::now();
@@ -65,7 +73,7 @@ void Train::DoTrain() {
     std::vector<std::thread> exp_generators;
     for (int i = 0; i < config_->num_threads; i++) {
       exp_generators.push_back(
-          std::thread(&Train::GenerateExperience, this, &target_eval, i));
+          std::thread(&Train::GenerateExperience, this, evaluator.get(), i));
     }
 
     for (auto& gen : exp_generators) {
@@ -83,16 +91,16 @@ void Train::DoTrain() {
         ms.count() / 1000.0 / config_->num_self_play_game);
 
     TrainNN();
+    evaluator->PublishModel(kTargetModelId, train_target_);
     torch::save(train_target_,
                 "CurrentTrainTarget" + std::to_string(i + 1) + ".pt");
 
-    if (IsTrainedBetter(&target_eval, &current_eval)) {
+    if (IsTrainedBetter(evaluator.get())) {
       fmt::print("New model is better! Saving model at {} \n", model_name);
 
-      // Copy the contents of train_target to current_best via model
-      // serialization & deserialization.
       torch::save(train_target_, model_name);
-      torch::load(current_best_, model_name);
+      CopyChessNNWeights(train_target_, current_best_);
+      evaluator->PublishModel(kCurrentBestModelId, current_best_);
 
       experiences_.clear();
       experience_saver_.ClearSavedExperiences();
@@ -106,41 +114,95 @@ void Train::DoTrain() {
     server_context_->GetWorkerManager()->ResetWorkerInfo();
     server_context_->DeleteRecordedGames();
   }
+
+  server_context_->SetSharedEvaluator(nullptr, 0);
+}
+
+void Train::DoSelfPlay(Evaluator* evaluator) {
+  auto start = std::chrono::high_resolution_clock::now();
+  exp_gen_start_ = start;
+
+  std::vector<std::thread> exp_generators;
+  for (int i = 0; i < config_->num_threads; i++) {
+    exp_generators.push_back(
+        std::thread(&Train::GenerateExperience, this, evaluator, i));
+  }
+
+  for (auto& gen : exp_generators) {
+    gen.join();
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+  fmt::print("Total {} Experiences saved to {}, took {} seconds. \n",
+             experiences_.size(), config_->exp_save_file_name,
+             ms.count() / 1000.0);
+
+  // Already saved; Nothing trains on them here.
+  experiences_.clear();
+  total_exp_ = 0;
+  total_exp_done_ = 0;
 }
 
 void Train::GenerateExperience(Evaluator* evaluator, int worker_id) {
   DirichletDistribution dirichlet(0.3);
+  torch::NoGradGuard guard;
+
+  auto start_game = [this]() {
+    return total_exp_.fetch_add(1) < config_->num_self_play_game;
+  };
+  auto finish_game =
+      [this, worker_id](std::vector<std::unique_ptr<Experience>>& exp) {
+        AddExperiences(exp, worker_id);
+      };
+
+  if (config_->use_coroutine_self_play) {
+    CoroutineSelfPlay self_play(&dirichlet, config_, evaluator, worker_id,
+                                kTargetModelId);
+    self_play.Run(start_game, finish_game);
+    return;
+  }
 
-  while (total_exp_.fetch_add(1) < config_->num_self_play_game) {
-    torch::NoGradGuard guard;
+  if (config_->self_play_games_per_thread > 1) {
+    SelfPlayDriver driver(&dirichlet, config_, evaluator, worker_id,
+                          kTargetModelId);
+    driver.Run(start_game, finish_game);
+    return;
+  }
 
+  while (start_game()) {
     Agent agent(&dirichlet, config_, evaluator,
-                server_context_->GetWorkerManager(), worker_id);
+                server_context_->GetWorkerManager(), worker_id,
+                kTargetModelId);
     agent.Run();
 
-    auto& experiences = agent.GetExperience();
+    AddExperiences(agent.GetExperience(), worker_id);
+  }
+}
 
-    auto game_end = std::chrono::high_resolution_clock::now();
-    auto took_sec = std::chrono::duration_cast<std::chrono::seconds>(
-        game_end - exp_gen_start_);
+void Train::AddExperiences(
+    std::vector<std::unique_ptr<Experience>>& experiences, int worker_id) {
+  auto game_end = std::chrono::high_resolution_clock::now();
+  auto took_sec = std::chrono::duration_cast<std::chrono::seconds>(
+      game_end - exp_gen_start_);
 
-    int done = total_exp_done_.fetch_add(1) + 1;
-    fmt::print("Done : {}/{}, Average {} seconds per game \n", done,
-               config_->num_self_play_game, took_sec.count() / (float)done);
+  int done = total_exp_done_.fetch_add(1) + 1;
+  fmt::print("Done : {}/{}, Average {} seconds per game \n", done,
+             config_->num_self_play_game, took_sec.count() / (float)done);
 
-    // Save the experiences.
-    experience_saver_.SaveExperiences(experiences);
+  // Save the experiences.
+  experience_saver_.SaveExperiences(experiences);
 
-    exp_guard_.lock();
-    experiences_.insert(experiences_.end(),
-                        std::make_move_iterator(experiences.begin()),
-                        std::make_move_iterator(experiences.end()));
-    exp_guard_.unlock();
+  exp_guard_.lock();
+  experiences_.insert(experiences_.end(),
+                      std::make_move_iterator(experiences.begin()),
+                      std::make_move_iterator(experiences.end()));
+  exp_guard_.unlock();
 
-    server_context_->GetWorkerManager()
-        ->GetWorkerInfo(worker_id)
-        .total_game_played++;
-  }
+  server_context_->GetWorkerManager()
+      ->GetWorkerInfo(worker_id)
+      .total_game_played++;
 }
 
 void Train::TrainNN() {
@@ -164,22 +226,30 @@ void Train::TrainNN() {
 
     train_target_->zero_grad();
 
-    for (const Experience* exp : batch) {
-      torch::Tensor state_tensor =
-          GameStateToTensor(*exp->state.get()).to(config_->device);
-      states.push_back(state_tensor);
+    torch::Tensor input_values;
+    {
+      // Only the forward pass runs in the reduced precision. The outputs are
+      // converted back to fp32 so that the loss is computed in fp32.
+      ReducedPrecisionGuard precision_guard(config_);
 
-      target_policies.push_back(exp->policy.to(config_->device));
-      results.push_back(exp->result);
+      for (const Experience* exp : batch) {
+        torch::Tensor state_tensor =
+            GameStateToTensor(*exp->state.get()).to(config_->device);
+        states.push_back(state_tensor);
 
-      input_policies.push_back(
-          NormalizePolicy(*exp->state, train_target_->GetPolicy(state_tensor)));
-    }
+        target_policies.push_back(exp->policy.to(config_->device));
+        results.push_back(exp->result);
 
-    torch::Tensor state_batch = torch::stack(states).to(config_->device);
+        input_policies.push_back(NormalizePolicy(
+            *exp->state,
+            train_target_->GetPolicy(state_tensor).to(torch::kFloat)));
+      }
 
-    torch::Tensor input_values =
-        train_target_->GetValue(state_batch).to(config_->device);
+      torch::Tensor state_batch = torch::stack(states).to(config_->device);
+
+      input_values = train_target_->GetValue(state_batch)
+                         .to(config_->device, torch::kFloat);
+    }
     torch::Tensor target_values =
         torch::from_blob(results.data(), {(long)batch.size(), 1})
             .to(config_->device);
@@ -204,14 +274,14 @@ void Train::TrainNN() {
   }
 }
 
-bool Train::IsTrainedBetter(Evaluator* target_eval, Evaluator* current_eval) {
+bool Train::IsTrainedBetter(Evaluator* evaluator) {
   target_score_ = 0;
   current_game_playing_ = 0;
 
   std::vector<std::thread> agent_evaluators;
   for (int i = 0; i < config_->num_threads; i++) {
-    agent_evaluators.push_back(std::thread(&Train::PlayGamesEachOther, this,
-                                           target_eval, current_eval, i));
+    agent_evaluators.push_back(
+        std::thread(&Train::PlayGamesEachOther, this, evaluator, i));
   }
 
   for (auto& eval : agent_evaluators) {
@@ -226,14 +296,16 @@ bool Train::IsTrainedBetter(Evaluator* target_eval, Evaluator* current_eval) {
   return false;
 }
 
-void Train::PlayGamesEachOther(Evaluator* target_eval, Evaluator* current_eval,
-                               int worker_id) {
+void Train::PlayGamesEachOther(Evaluator* evaluator, int worker_id) {
   UniformDistribution no_noise;
 
-  Agent target(&no_noise, config_, target_eval,
-               server_context_->GetWorkerManager(), worker_id);
-  Agent current(&no_noise, config_, current_eval,
-                server_context_->GetWorkerManager(), worker_id);
+  // The agents never search at the same time, so they can share the worker id.
+  Agent target(&no_noise, config_, evaluator,
+               server_context_->GetWorkerManager(), worker_id,
+               kTargetModelId);
+  Agent current(&no_noise, config_, evaluator,
+                server_context_->GetWorkerManager(), worker_id,
+                kCurrentBestModelId);
 
   Chess chess(config_);
 
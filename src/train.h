@@ -11,9 +11,15 @@ namespace chess {
 
 class Train {
  public:
+  // Index of each model in the evaluator passed to IsTrainedBetter().
+  static constexpr int kTargetModelId = 0;
+  static constexpr int kCurrentBestModelId = 1;
+
   Train(Config* config, ServerContext* server_context)
-      : current_best_(config->num_layer, config->num_filter),
-        train_target_(config->num_layer, config->num_filter),
+      : current_best_(config->num_layer, config->num_filter,
+                      config->use_conv_policy_head),
+        train_target_(config->num_layer, config->num_filter,
+                      config->use_conv_policy_head),
         config_(config),
         server_context_(server_context),
         experience_saver_(config) {
@@ -23,20 +29,31 @@ class Train {
 
   void DoTrain();
 
+  // Play num_self_play_game games with the model 0 of the evaluator (e.g. the
+  // ShmEvaluator of the inference server) and save their experiences, without
+  // training.
+  void DoSelfPlay(Evaluator* evaluator);
+
   // Train the train target.
   void TrainNN();
 
-  // Check whether the train_target performs better than current_best.
-  bool IsTrainedBetter(Evaluator* target_eval, Evaluator* current_eval);
+  // Check whether the train_target performs better than current_best. The
+  // evaluator hosts both models (see kTargetModelId and kCurrentBestModelId).
+  bool IsTrainedBetter(Evaluator* evaluator);
 
   // Following two are exposed for the testing.
   void AddExperienceForTesting(std::unique_ptr<Experience> exp);
   ChessNN GetTrainTarget() { return train_target_; }
 
  private:
+  // Plays self_play_games_per_thread games at once if it is more than 1 (or
+  // with use_coroutine_self_play).
   void GenerateExperience(Evaluator* evaluator, int worker_id);
-  void PlayGamesEachOther(Evaluator* target_eval, Evaluator* current_eval,
-                          int worker_id);
+
+  // Save and keep the experiences of a finished game.
+  void AddExperiences(std::vector<std::unique_ptr<Experience>>& experiences,
+                      int worker_id);
+  void PlayGamesEachOther(Evaluator* evaluator, int worker_id);
 
   ChessNN current_best_;
   ChessNN train_target_;
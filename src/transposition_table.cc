@@ -0,0 +1,36 @@
+#include "transposition_table.h"
+
+namespace chess {
+namespace {
+
+constexpr size_t kNumStripes = 16;
+
+}  // namespace
+
+TranspositionTable::TranspositionTable() : stripes_(kNumStripes) {}
+
+NodeIndex TranspositionTable::FindOrInsert(uint64_t position_hash,
+                                           NodeIndex node) {
+  Stripe& stripe = StripeOf(position_hash);
+
+  std::lock_guard<std::mutex> lk(stripe.m);
+  return stripe.nodes.try_emplace(position_hash, node).first->second;
+}
+
+void TranspositionTable::Clear() {
+  for (Stripe& stripe : stripes_) {
+    std::lock_guard<std::mutex> lk(stripe.m);
+    stripe.nodes.clear();
+  }
+}
+
+size_t TranspositionTable::Size() const {
+  size_t size = 0;
+  for (const Stripe& stripe : stripes_) {
+    std::lock_guard<std::mutex> lk(stripe.m);
+    size += stripe.nodes.size();
+  }
+  return size;
+}
+
+}  // namespace chess
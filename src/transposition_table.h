@@ -0,0 +1,45 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mcts_tree.h"
+
+namespace chess {
+
+// Node of each position (keyed by GameState::PositionHash()) within a single
+// MCTSTree. The first node that is expanded with the position is the one that
+// the later transpositions of it refer to (see MCTS::Transpose). Guarded by a
+// small set of striped locks, so it can be shared by every search thread.
+class TranspositionTable {
+ public:
+  TranspositionTable();
+
+  // Returns the node of the position. If there is none yet, the node becomes
+  // the one of the position and is returned.
+  NodeIndex FindOrInsert(uint64_t position_hash, NodeIndex node);
+
+  // Drop every entry. Must be called when the nodes of the tree are gone.
+  void Clear();
+
+  size_t Size() const;
+
+ private:
+  struct Stripe {
+    mutable std::mutex m;
+    std::unordered_map<uint64_t, NodeIndex> nodes;
+  };
+
+  Stripe& StripeOf(uint64_t position_hash) {
+    return stripes_[position_hash & (stripes_.size() - 1)];
+  }
+
+  std::vector<Stripe> stripes_;
+};
+
+}  // namespace chess
+
+#endif
@@ -1,6 +1,8 @@
 #include "util.h"
 
 #include <execinfo.h>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 
 #include <cstdio>
@@ -20,4 +22,29 @@ bool IsFileExist(const std::string& file_name) {
   return in.is_open();
 }
 
+bool PinCurrentThreadToCores(int first_core, int num_cores) {
+  const int total_cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+
+  for (int core = first_core; core < first_core + num_cores; core++) {
+    // Wrap around if there are not enough cores.
+    CPU_SET(core % total_cores, &cpu_set);
+  }
+
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) ==
+         0;
+}
+
+uint64_t HashCombine(uint64_t seed, uint64_t value) {
+  // Finalizer of splitmix64 so that the nearby values spread well.
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 }  // namespace chess
@@ -1,33 +1,71 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <thread>
 
 namespace chess {
 
-// Util class to compute once (when needed).
+// Util class to compute once (when needed). Safe to Get from several threads
+// (e.g. the search threads that share the tree); Only one of them computes.
 template <typename T>
 class LazyGet {
  public:
+  LazyGet() = default;
+  LazyGet(const LazyGet& other) { *this = other; }
+
+  LazyGet& operator=(const LazyGet& other) {
+    if (other.state_.load(std::memory_order_acquire) == kFetched) {
+      data_ = other.data_;
+      state_.store(kFetched, std::memory_order_release);
+    } else {
+      state_.store(kEmpty, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
   template <typename Func>
   T& Get(Func generator) {
-    if (fetched_) {
+    if (state_.load(std::memory_order_acquire) == kFetched) {
       return data_;
     }
 
-    data_ = generator();
-    fetched_ = true;
+    int expected = kEmpty;
+    if (state_.compare_exchange_strong(expected, kFetching,
+                                       std::memory_order_acquire)) {
+      data_ = generator();
+      state_.store(kFetched, std::memory_order_release);
+      return data_;
+    }
+
+    while (state_.load(std::memory_order_acquire) != kFetched) {
+      std::this_thread::yield();
+    }
     return data_;
   }
 
  private:
-  bool fetched_ = false;
+  static constexpr int kEmpty = 0;
+  static constexpr int kFetching = 1;
+  static constexpr int kFetched = 2;
+
+  std::atomic<int> state_ = kEmpty;
   T data_;
 };
 
 void PrintStackTrace();
 bool IsFileExist(const std::string& file_name);
 
+// Pin the calling thread to cores [first_core, first_core + num_cores). Threads
+// that are created by the calling thread afterwards inherit the affinity.
+// Returns false if pinning failed.
+bool PinCurrentThreadToCores(int first_core, int num_cores);
+
+// Mix the value into the seed (64 bit version of boost::hash_combine).
+uint64_t HashCombine(uint64_t seed, uint64_t value);
+
 }  // namespace chess
 
 #endif
@@ -1,7 +1,11 @@
 #ifndef WORKER_MANAGER_H
 #define WORKER_MANAGER_H
 
+#include <array>
+#include <atomic>
+
 #include "config.h"
+#include "inference_priority.h"
 
 namespace chess {
 
@@ -19,6 +23,41 @@ struct InferenceWorkerInfo {
 
   // Total # of states that are inferenced.
   uint64_t total_inference_batch_size = 0;
+
+  // # of batches that are inferenced because the target batch size was
+  // reached, or because the batch collection window has expired.
+  uint64_t total_flush_by_target = 0;
+  uint64_t total_flush_by_deadline = 0;
+
+  // Total time spent on waiting for the batch to be filled.
+  uint64_t total_batch_wait_us = 0;
+
+  // Latest target batch size chosen by the batching policy.
+  int current_target_batch_size = 0;
+};
+
+// Latency of the async inference requests of a single priority class, measured
+// by the requester (from queueing the states until the values are back).
+struct InferenceLatencyInfo {
+  std::atomic<uint64_t> total_num_request = 0;
+  std::atomic<uint64_t> total_latency_us = 0;
+  std::atomic<uint64_t> max_latency_us = 0;
+
+  // # of requests that took longer than interactive_inference_deadline_us.
+  std::atomic<uint64_t> total_deadline_miss = 0;
+
+  void Reset() {
+    total_num_request = 0;
+    total_latency_us = 0;
+    max_latency_us = 0;
+    total_deadline_miss = 0;
+  }
+};
+
+// Aggregated over every Evaluator that reports to the manager.
+struct EvalCacheInfo {
+  std::atomic<uint64_t> total_hits = 0;
+  std::atomic<uint64_t> total_misses = 0;
 };
 
 class WorkerManager {
@@ -38,17 +77,32 @@ class WorkerManager {
 
     inference_worker_info_.clear();
     inference_worker_info_.resize(config_->evaluator_worker_count);
+
+    eval_cache_info_.total_hits = 0;
+    eval_cache_info_.total_misses = 0;
+
+    for (auto& info : latency_info_) {
+      info.Reset();
+    }
   }
 
   InferenceWorkerInfo& GetInferenceWorkerInfo(int worker_id) {
     return inference_worker_info_[worker_id];
   }
 
+  EvalCacheInfo& GetEvalCacheInfo() { return eval_cache_info_; }
+
+  InferenceLatencyInfo& GetInferenceLatencyInfo(InferencePriority priority) {
+    return latency_info_[static_cast<int>(priority)];
+  }
+
  private:
   Config* config_;
 
   std::vector<TrainWorkerInfo> train_worker_info_;
   std::vector<InferenceWorkerInfo> inference_worker_info_;
+  EvalCacheInfo eval_cache_info_;
+  std::array<InferenceLatencyInfo, kNumInferencePriorities> latency_info_;
 };
 
 }  // namespace chess
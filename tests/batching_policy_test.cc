@@ -0,0 +1,53 @@
+#include "batching_policy.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace chess {
+namespace {
+
+using ::std::chrono::microseconds;
+
+TEST(BatchingPolicyTest, DisabledByDefault) {
+  Config config;
+  BatchingPolicy policy(&config);
+
+  EXPECT_FALSE(policy.Enabled());
+  EXPECT_EQ(policy.TargetBatchSize(), 1);
+}
+
+TEST(BatchingPolicyTest, AdaptTarget) {
+  Config config;
+  config.inference_batch_max_wait_us = 500;
+  config.inference_min_batch_size = 4;
+  config.inference_max_batch_size = 64;
+
+  BatchingPolicy policy(&config);
+  EXPECT_TRUE(policy.Enabled());
+  EXPECT_EQ(policy.TargetBatchSize(), 4);
+
+  auto now = BatchingPolicy::Clock::now();
+  policy.RecordDispatch(now);
+
+  // 20 states per 1000us; Forward takes 1000us.
+  policy.RecordArrival(20);
+  policy.RecordDispatch(now + microseconds(1000));
+  policy.RecordForwardLatency(microseconds(1000));
+
+  EXPECT_EQ(policy.TargetBatchSize(), 20);
+
+  // Much slower forward; Target is bounded by the max batch size.
+  for (int i = 0; i < 100; i++) {
+    policy.RecordForwardLatency(microseconds(100000));
+  }
+  EXPECT_EQ(policy.TargetBatchSize(), 64);
+
+  // Very fast forward; Target is bounded by the min batch size.
+  for (int i = 0; i < 100; i++) {
+    policy.RecordForwardLatency(microseconds(1));
+  }
+  EXPECT_EQ(policy.TargetBatchSize(), 4);
+}
+
+}  // namespace
+}  // namespace chess
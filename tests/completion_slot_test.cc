@@ -0,0 +1,35 @@
+#include "completion_slot.h"
+
+#include <chrono>
+#include <thread>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace chess {
+namespace {
+
+TEST(CompletionSlotTest, WaitUntilComplete) {
+  CompletionSlot slot;
+  int result = 0;
+
+  for (int i = 0; i < 100; i++) {
+    slot.Reset();
+    std::thread completer([&slot, &result, i]() {
+      // Make the waiter park sometimes.
+      if (i % 10 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      result = i;
+      slot.Complete();
+    });
+
+    slot.Wait();
+    EXPECT_EQ(result, i);
+
+    completer.join();
+  }
+}
+
+}  // namespace
+}  // namespace chess
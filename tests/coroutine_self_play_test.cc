@@ -0,0 +1,150 @@
+#include "coroutine_self_play.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+namespace chess {
+namespace {
+
+// Evaluates every state as 0 without a model. A batch finishes only once
+// another batch is sent after it, and then the newest one finishes first, so
+// the scheduler can make progress only by keeping more than one batch in
+// flight (or by blocking on the oldest one).
+class FakeEvaluator : public Evaluator {
+ public:
+  struct Event {
+    bool submitted;  // Otherwise finished.
+    int worker_id;
+
+    // Games (see GameOf()) of the states of the batch.
+    std::set<const GameState*> games;
+  };
+
+  explicit FakeEvaluator(const Config* config)
+      : Evaluator(/*chess_net=*/nullptr, config, /*worker_manager=*/nullptr) {}
+
+  void SubmitAsyncBatch(const std::vector<const GameState*>& states,
+                        int worker_id, int /*model_id*/,
+                        InferencePriority /*priority*/) override {
+    std::set<const GameState*> games;
+    for (const GameState* state : states) {
+      games.insert(GameOf(state));
+    }
+
+    batches_[worker_id] = Event{/*submitted=*/true, worker_id, games};
+    in_flight_.push_back(worker_id);
+    max_in_flight_ = std::max<int>(max_in_flight_, in_flight_.size());
+
+    num_states_[worker_id] = states.size();
+    events_.push_back(batches_[worker_id]);
+  }
+
+  bool PollAsyncBatch(int worker_id) override {
+    return in_flight_.size() >= 2 && in_flight_.back() == worker_id;
+  }
+
+  std::vector<float> TakeAsyncBatchResult(int worker_id) override {
+    in_flight_.erase(
+        std::find(in_flight_.begin(), in_flight_.end(), worker_id));
+
+    Event finished = batches_[worker_id];
+    finished.submitted = false;
+    events_.push_back(finished);
+
+    return std::vector<float>(num_states_[worker_id], 0);
+  }
+
+  // The first state of the game that the state belongs to. Every game (and
+  // its tree) starts from its own initial state.
+  static const GameState* GameOf(const GameState* state) {
+    while (state->PrevState() != nullptr) {
+      state = state->PrevState();
+    }
+    return state;
+  }
+
+  const std::vector<Event>& Events() const { return events_; }
+  int MaxInFlight() const { return max_in_flight_; }
+
+ private:
+  std::map<int, Event> batches_;
+  std::map<int, size_t> num_states_;
+
+  // Worker ids of the batches in flight, in the order they were sent.
+  std::vector<int> in_flight_;
+  int max_in_flight_ = 0;
+
+  std::vector<Event> events_;
+};
+
+Config AsyncConfig(int games_per_thread) {
+  Config config;
+  config.num_threads = 1;
+  config.num_mcts_iteration = 10;
+  config.max_game_moves_until_draw = 4;
+  config.mcts_batch_leaf_node_size = 4;
+  config.self_play_games_per_thread = games_per_thread;
+  config.use_async_inference = true;
+  config.coroutine_batches_in_flight = 2;
+  return config;
+}
+
+std::vector<int> PlayGames(Config* config, Evaluator* eval, int num_games) {
+  UniformDistribution dist;
+  CoroutineSelfPlay self_play(&dist, config, eval, /*worker_id=*/0);
+
+  int num_started = 0;
+  std::vector<int> game_lengths;
+  self_play.Run([&]() { return num_started++ < num_games; },
+                [&](std::vector<std::unique_ptr<Experience>>& experiences) {
+                  game_lengths.push_back(experiences.size());
+                });
+
+  return game_lengths;
+}
+
+TEST(CoroutineSelfPlayTest, PlaysEveryGame) {
+  Config config = AsyncConfig(/*games_per_thread=*/3);
+  FakeEvaluator eval(&config);
+
+  // No game can end before the 4th move (the fool's mate).
+  EXPECT_THAT(PlayGames(&config, &eval, /*num_games=*/5),
+              testing::ElementsAre(4, 4, 4, 4, 4));
+}
+
+TEST(CoroutineSelfPlayTest, KeepsBatchesInFlight) {
+  Config config = AsyncConfig(/*games_per_thread=*/2);
+  FakeEvaluator eval(&config);
+
+  PlayGames(&config, &eval, /*num_games=*/2);
+
+  EXPECT_EQ(eval.MaxInFlight(), 2);
+
+  const auto& events = eval.Events();
+  ASSERT_GE(events.size(), 4);
+
+  // Each game sends its own batch; The second one is sent while the first one
+  // is in flight.
+  EXPECT_TRUE(events[0].submitted);
+  EXPECT_TRUE(events[1].submitted);
+  EXPECT_NE(events[0].worker_id, events[1].worker_id);
+  ASSERT_EQ(events[0].games.size(), 1);
+  ASSERT_EQ(events[1].games.size(), 1);
+  EXPECT_NE(events[0].games, events[1].games);
+
+  // The second batch finishes first, so its game resumes (and sends the next
+  // batch) first while the first batch is still in flight.
+  EXPECT_FALSE(events[2].submitted);
+  EXPECT_EQ(events[2].worker_id, events[1].worker_id);
+
+  EXPECT_TRUE(events[3].submitted);
+  EXPECT_EQ(events[3].games, events[1].games);
+}
+
+}  // namespace
+}  // namespace chess
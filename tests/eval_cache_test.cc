@@ -0,0 +1,77 @@
+#include "eval_cache.h"
+
+#include "evaluator.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+namespace chess {
+namespace {
+
+using ::testing::Optional;
+
+TEST(EvalCacheTest, LookupAndInsert) {
+  EvalCache cache(16);
+  EXPECT_TRUE(cache.Enabled());
+
+  EXPECT_EQ(cache.Lookup(3), std::nullopt);
+
+  // The empty entries do not match the key 0.
+  EXPECT_EQ(cache.Lookup(0), std::nullopt);
+
+  cache.Insert(3, 0.5);
+  EXPECT_THAT(cache.Lookup(3), Optional(0.5));
+
+  // 19 is mapped to the same entry with 3 and replaces it.
+  cache.Insert(19, -0.25);
+  EXPECT_THAT(cache.Lookup(19), Optional(-0.25));
+  EXPECT_EQ(cache.Lookup(3), std::nullopt);
+
+  EXPECT_EQ(cache.Hits(), 2);
+  EXPECT_EQ(cache.Misses(), 3);
+}
+
+TEST(EvalCacheTest, Disabled) {
+  EvalCache cache(0);
+  EXPECT_FALSE(cache.Enabled());
+
+  cache.Insert(1, 0.5);
+  EXPECT_EQ(cache.Lookup(1), std::nullopt);
+}
+
+TEST(EvalCacheTest, EvaluatorUsesCache) {
+  Config config;
+  config.num_threads = 1;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  WorkerManager worker_manager(&config);
+  Evaluator eval(nn, &config, &worker_manager);
+
+  GameStateBuilder builder;
+  builder.DoMove(Move(6, 4, 4, 4));  // e4
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  std::vector<float> values = eval.EvalulateBatch(states);
+  EXPECT_EQ(eval.GetEvalCache().Hits(), 0);
+  EXPECT_EQ(eval.GetEvalCache().Misses(), 2);
+
+  EXPECT_FLOAT_EQ(eval.Evalulate(*states[0]), values[0]);
+  EXPECT_EQ(eval.GetEvalCache().Hits(), 1);
+  EXPECT_EQ(worker_manager.GetEvalCacheInfo().total_hits, 1);
+
+  // Values of the previous version of the model are not used anymore.
+  eval.SyncModelReplicas();
+  eval.Evalulate(*states[0]);
+  EXPECT_EQ(eval.GetEvalCache().Hits(), 1);
+  EXPECT_EQ(eval.GetEvalCache().Misses(), 3);
+}
+
+}  // namespace
+}  // namespace chess
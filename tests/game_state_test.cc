@@ -275,6 +275,94 @@ TEST(GameStateTest, NoProgressCountTest) {
   EXPECT_EQ(states.back()->NoProgressCount(), 1);
 }
 
+TEST(GameStateTest, HashTest) {
+  GameStateBuilder builder1;
+  builder1
+      .DoMove(Move(7, 1, 5, 2))   // Nc3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 6, 5, 5));  // Nf3
+
+  GameStateBuilder builder2;
+  builder2
+      .DoMove(Move(7, 1, 5, 2))   // Nc3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 6, 5, 5));  // Nf3
+
+  // Same board reached in different order. The network sees the history, so
+  // the hash should differ.
+  GameStateBuilder builder3;
+  builder3
+      .DoMove(Move(7, 6, 5, 5))   // Nf3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 1, 5, 2));  // Nc3
+
+  const GameState& state1 = *builder1.GetStates().back();
+  const GameState& state2 = *builder2.GetStates().back();
+  const GameState& state3 = *builder3.GetStates().back();
+
+  EXPECT_EQ(state1.GetBoard(), state3.GetBoard());
+  EXPECT_EQ(state1.Hash(), state2.Hash());
+  EXPECT_NE(state1.Hash(), state3.Hash());
+  EXPECT_NE(builder1.GetStates().front()->Hash(), state1.Hash());
+}
+
+TEST(GameStateTest, HashTestRepitition) {
+  GameStateBuilder builder;
+
+  builder
+      .DoMove(Move(7, 1, 5, 2))  // Nb3
+      .DoMove(Move(0, 1, 2, 2))  // Nc6
+      .DoMove(Move(5, 2, 7, 1))
+      .DoMove(Move(2, 2, 0, 1));
+
+  // Same board, but the repetition count is different.
+  auto& states = builder.GetStates();
+  EXPECT_EQ(states.front()->GetBoard(), states.back()->GetBoard());
+  EXPECT_NE(states.front()->Hash(), states.back()->Hash());
+}
+
+TEST(GameStateTest, PositionHashOfTransposition) {
+  GameStateBuilder builder1;
+  builder1
+      .DoMove(Move(7, 1, 5, 2))   // Nc3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 6, 5, 5));  // Nf3
+
+  GameStateBuilder builder2;
+  builder2
+      .DoMove(Move(7, 6, 5, 5))   // Nf3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 1, 5, 2));  // Nc3
+
+  const GameState& state1 = *builder1.GetStates().back();
+  const GameState& state2 = *builder2.GetStates().back();
+  EXPECT_EQ(state1.PositionHash(), state2.PositionHash());
+
+  // Same board, but the other side moves.
+  const GameState& state3 = *builder1.GetStates()[2];
+  EXPECT_NE(state3.PositionHash(), state1.PositionHash());
+}
+
+TEST(GameStateTest, PositionHashOfEnPassant) {
+  // e5 can be captured en passant only here.
+  GameStateBuilder builder1;
+  builder1
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4));  // e5
+
+  GameStateBuilder builder2;
+  builder2
+      .DoMove(Move(6, 4, 5, 4))   // e3
+      .DoMove(Move(1, 4, 2, 4))   // e6
+      .DoMove(Move(5, 4, 4, 4))   // e4
+      .DoMove(Move(2, 4, 3, 4));  // e5
+
+  const GameState& state1 = *builder1.GetStates().back();
+  const GameState& state2 = *builder2.GetStates().back();
+  EXPECT_EQ(state1.GetBoard(), state2.GetBoard());
+  EXPECT_NE(state1.PositionHash(), state2.PositionHash());
+}
+
 int DepthSearchMoves(const GameState& state, int depth) {
   int total = 0;
 
@@ -0,0 +1,128 @@
+#include "gumbel_root.h"
+
+#include <random>
+#include <vector>
+
+#include "game_state.h"
+#include "gtest/gtest.h"
+#include "search_arena.h"
+
+namespace chess {
+namespace {
+
+// Root (of the initial state) with the first num_children legal moves as the
+// children of the same prior.
+class GumbelRootTest : public ::testing::Test {
+ protected:
+  GumbelRootTest()
+      : state_(GameState::CreateInitGameState()),
+        tree_(/*virtual_loss=*/-0.05, &arena_) {}
+
+  NodeIndex CreateRoot(int num_children) {
+    std::vector<Move> moves = state_.GetLegalMoves();
+    moves.erase(moves.begin() + num_children, moves.end());
+
+    const NodeIndex root = tree_.CreateRoot(state_);
+    tree_.AddChildren(root, moves,
+                      std::vector<float>(num_children, 1.0 / num_children));
+    return root;
+  }
+
+  GameState state_;
+  SearchArena arena_;
+  MCTSTree tree_;
+};
+
+TEST_F(GumbelRootTest, HalvingFindsBestChild) {
+  const NodeIndex root = CreateRoot(8);
+  const NodeIndex best = tree_.FirstChild(root) + 5;
+
+  GumbelRoot::Params params;
+  params.num_considered = 8;
+
+  std::mt19937 gen(0);
+  GumbelRoot gumbel(tree_, root, params, /*num_simulations=*/16, &gen);
+
+  // 8 children once, 4 once and then 2 twice.
+  std::vector<int> visits(8, 0);
+  for (int i = 0; i < 16; i++) {
+    const NodeIndex child = gumbel.NextChild(tree_);
+    visits[child - tree_.FirstChild(root)]++;
+    tree_.UpdateQ(child, child == best ? 1 : -1);
+  }
+
+  EXPECT_EQ(gumbel.BestChild(tree_), best);
+  EXPECT_EQ(visits[5], 4);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_GE(visits[i], 1);
+  }
+}
+
+TEST_F(GumbelRootTest, ConsidersOnlyTopChildren) {
+  const NodeIndex root = CreateRoot(10);
+
+  GumbelRoot::Params params;
+  params.num_considered = 4;
+
+  std::mt19937 gen(1);
+  GumbelRoot gumbel(tree_, root, params, /*num_simulations=*/8, &gen);
+
+  std::vector<int> visits(10, 0);
+  for (int i = 0; i < 8; i++) {
+    const NodeIndex child = gumbel.NextChild(tree_);
+    visits[child - tree_.FirstChild(root)]++;
+    tree_.UpdateQ(child, 0);
+  }
+
+  int num_visited = 0;
+  for (int visit : visits) {
+    num_visited += visit > 0;
+  }
+  EXPECT_EQ(num_visited, 4);
+}
+
+TEST_F(GumbelRootTest, CompletedQMixesValueOfRoot) {
+  const NodeIndex root = CreateRoot(4);
+  tree_.SetValueOfThisState(root, 0.2);
+
+  std::mt19937 gen(0);
+  GumbelRoot gumbel(tree_, root, GumbelRoot::Params(), 4, &gen);
+
+  tree_.UpdateQ(tree_.FirstChild(root), 0.6);
+
+  // (0.2 + 1 * 0.6) / (1 + 1)
+  const std::vector<float> completed_q = gumbel.CompletedQ(tree_);
+  ASSERT_EQ(completed_q.size(), 4);
+  EXPECT_FLOAT_EQ(completed_q[0], 0.6);
+  for (int i = 1; i < 4; i++) {
+    EXPECT_FLOAT_EQ(completed_q[i], 0.4);
+  }
+}
+
+TEST_F(GumbelRootTest, ImprovedPolicyFavorsBetterQ) {
+  const NodeIndex root = CreateRoot(3);
+  const NodeIndex first_child = tree_.FirstChild(root);
+
+  std::mt19937 gen(0);
+  GumbelRoot gumbel(tree_, root, GumbelRoot::Params(), 4, &gen);
+
+  tree_.UpdateQ(first_child, -0.5);
+  tree_.UpdateQ(first_child + 1, 0.5);
+  tree_.UpdateQ(first_child + 2, 0);
+
+  const auto policy = gumbel.ImprovedPolicy(tree_);
+  ASSERT_EQ(policy.size(), 3);
+
+  float total = 0;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(policy[i].first, tree_.GetMove(first_child + i));
+    total += policy[i].second;
+  }
+  EXPECT_NEAR(total, 1, 1e-5);
+
+  EXPECT_GT(policy[1].second, policy[2].second);
+  EXPECT_GT(policy[2].second, policy[0].second);
+}
+
+}  // namespace
+}  // namespace chess
@@ -36,6 +36,435 @@ TEST_F(MCTSTest, CheckMoves) {
   EXPECT_TRUE(possible_moves.size() > 1);
 }
 
+TEST_F(MCTSTest, ReRootKeepsSubtree) {
+  Config config;
+  config.num_mcts_iteration = 50;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  const size_t num_nodes = mcts.NumNodes();
+  const Move move = mcts.MoveToMake(/*choose_best_move=*/true);
+
+  const MCTSTree& tree = mcts.Tree();
+  const NodeIndex first_child = tree.FirstChild(mcts.Root());
+
+  int carried_visit = 0;
+  for (int i = 0; i < tree.NumChildren(mcts.Root()); i++) {
+    if (tree.GetMove(first_child + i) == move) {
+      carried_visit = tree.Visit(first_child + i);
+    }
+  }
+  EXPECT_GT(carried_visit, 0);
+
+  mcts.ReRoot(move);
+  EXPECT_EQ(mcts.Tree().State(mcts.Root()).LastMove(), move);
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), carried_visit);
+  EXPECT_EQ(mcts.Tree().Parent(mcts.Root()), kNoNode);
+  EXPECT_EQ(mcts.Tree().Prior(mcts.Root()), 1);
+  EXPECT_LT(mcts.NumNodes(), num_nodes);
+
+  // Runs num_mcts_iteration more on top of the carried visits.
+  mcts.RunMCTS();
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()),
+            carried_visit + config.num_mcts_iteration);
+}
+
+TEST_F(MCTSTest, ChildStatesAreCreatedLazily) {
+  Config config;
+  config.num_mcts_iteration = 50;
+  config.precompute_batch_parent_min_visit_count = 1000;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  // Only the root, the precomputed children of the root and the selected
+  // leaves have the states.
+  const MCTSTree& tree = mcts.Tree();
+  EXPECT_LE(tree.NumStates(),
+            1 + tree.NumChildren(mcts.Root()) + config.num_mcts_iteration);
+  EXPECT_LT(tree.NumStates(), tree.NumNodes());
+}
+
+TEST_F(MCTSTest, StopsAtNodeBudget) {
+  Config config;
+  config.num_mcts_iteration = 1000;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+
+  SearchLimits limits = SearchLimits::FromConfig(config);
+  limits.max_nodes = 200;
+  mcts.RunMCTS(limits);
+
+  // The last expansion may go over the budget by the children of a node.
+  EXPECT_GE(mcts.NumNodes(), limits.max_nodes);
+  EXPECT_LT(mcts.NumNodes(), limits.max_nodes + 64);
+  EXPECT_LT(mcts.Tree().Visit(mcts.Root()), config.num_mcts_iteration);
+}
+
+TEST_F(MCTSTest, SmartPruningStopsOnOnlyMove) {
+  Config config;
+  config.num_mcts_iteration = 100;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  // Ka2 is the only move of white.
+  Board board = BoardFromNotation(R"(
+.r.....k
+........
+........
+........
+........
+.......r
+........
+K.......
+)");
+  GameStateBuilder builder(GameState::CreateGameStateForTesting(board));
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+
+  SearchLimits limits = SearchLimits::FromConfig(config);
+  limits.smart_pruning = true;
+  mcts.RunMCTS(limits);
+
+  // Stops once the only move is visited.
+  EXPECT_EQ(mcts.Tree().NumChildren(mcts.Root()), 1);
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), 2);
+  EXPECT_EQ(mcts.MoveToMake(/*choose_best_move=*/true).Str(), "a1a2");
+  EXPECT_EQ(mcts.MoveToMake(/*choose_best_move=*/false).Str(), "a1a2");
+
+  torch::Tensor policy = mcts.GetPolicyVector();
+  EXPECT_FALSE(policy.isnan().any().item<bool>());
+  EXPECT_NEAR(policy.sum().item<float>(), 1, 1e-5);
+}
+
+TEST_F(MCTSTest, BudgetsWaitForVisitedChild) {
+  Config config;
+  config.num_mcts_iteration = 100;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+
+  // The expansion of the root alone goes over the node budget.
+  SearchLimits limits = SearchLimits::FromConfig(config);
+  limits.max_nodes = 1;
+  limits.smart_pruning = true;
+  mcts.RunMCTS(limits);
+
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), 2);
+  mcts.MoveToMake(/*choose_best_move=*/false);
+
+  torch::Tensor policy = mcts.GetPolicyVector();
+  EXPECT_FALSE(policy.isnan().any().item<bool>());
+  EXPECT_NEAR(policy.sum().item<float>(), 1, 1e-5);
+}
+
+TEST_F(MCTSTest, SingleIterationFallsBackToPriors) {
+  Config config;
+  config.num_mcts_iteration = 1;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  // Only the root is visited.
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), 1);
+  mcts.MoveToMake(/*choose_best_move=*/false);
+
+  torch::Tensor policy = mcts.GetPolicyVector();
+  EXPECT_FALSE(policy.isnan().any().item<bool>());
+  EXPECT_NEAR(policy.sum().item<float>(), 1, 1e-5);
+}
+
+TEST_F(MCTSTest, GumbelRootSearchesConsideredMoves) {
+  Config config;
+  config.num_mcts_iteration = 32;
+  config.mcts_gumbel_root = true;
+  config.mcts_gumbel_num_considered = 4;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  const MCTSTree& tree = mcts.Tree();
+  const NodeIndex first_child = tree.FirstChild(mcts.Root());
+
+  std::unordered_set<std::string> visited;
+  for (int i = 0; i < tree.NumChildren(mcts.Root()); i++) {
+    if (tree.Visit(first_child + i) > 0) {
+      visited.insert(tree.GetMove(first_child + i).Str());
+    }
+  }
+  EXPECT_EQ(visited.size(), 4);
+
+  // The move is the one that the halving chose, not a sample.
+  const std::string move = mcts.MoveToMake().Str();
+  EXPECT_EQ(visited.count(move), 1);
+  EXPECT_EQ(mcts.MoveToMake().Str(), move);
+
+  // Every legal move gets some of the improved policy.
+  torch::Tensor policy = mcts.GetPolicyVector();
+  EXPECT_NEAR(policy.sum().item<float>(), 1, 1e-5);
+  EXPECT_EQ(policy.gt(0).sum().item<int64_t>(), 20);
+}
+
+TEST_F(MCTSTest, StepByStepSearch) {
+  Config config;
+  config.num_mcts_iteration = 50;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+
+  mcts.BeginSearch(SearchLimits::FromConfig(config));
+  while (!mcts.SearchDone()) {
+    std::vector<NodeIndex> leaves = mcts.CollectLeaves(/*max_leaves=*/8);
+    EXPECT_LE(leaves.size(), 8u);
+
+    std::vector<const GameState*> states;
+    for (NodeIndex leaf : leaves) {
+      EXPECT_FALSE(mcts.Tree().Computed(leaf));
+      states.push_back(&mcts.Tree().State(leaf));
+    }
+    mcts.ApplyValues(leaves, eval.EvalulateBatch(states));
+  }
+
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), config.num_mcts_iteration);
+  EXPECT_EQ(mcts.Tree().VirtualLoss(mcts.Root()), 0);
+}
+
+TEST_F(MCTSTest, BatchCollisionsAreRetriedAndUndone) {
+  Config config;
+  config.num_mcts_iteration = 100;
+  config.mcts_max_batch_collisions = 3;
+
+  // Otherwise the checkmate is proven when it is expanded, and never waits for
+  // the evaluation.
+  config.mcts_solver = false;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  // Qxb2# is the only move of white, so every selection after the first two
+  // reaches the checkmate that waits for the evaluation.
+  Board board = BoardFromNotation(R"(
+........
+........
+.....Q..
+...q....
+........
+........
+.q......
+k.K.....
+)");
+  GameStateBuilder builder(GameState::CreateGameStateForTesting(board));
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+
+  mcts.BeginSearch(SearchLimits::FromConfig(config));
+  std::vector<NodeIndex> leaves = mcts.CollectLeaves(/*max_leaves=*/8);
+
+  const MCTSTree& tree = mcts.Tree();
+  const NodeIndex mate = tree.FirstChild(mcts.Root());
+  EXPECT_THAT(leaves, testing::ElementsAre(mcts.Root(), mate));
+  EXPECT_EQ(tree.GetMove(mate).Str(), "f6b2");
+
+  // Only the virtual visits of the two leaves are left.
+  EXPECT_EQ(tree.VirtualVisit(mcts.Root()), 2);
+  EXPECT_EQ(tree.VirtualVisit(mate), 1);
+  EXPECT_FLOAT_EQ(mcts.CollisionRate(), 4.0 / 6);
+
+  std::vector<const GameState*> states;
+  for (NodeIndex leaf : leaves) {
+    states.push_back(&tree.State(leaf));
+  }
+  mcts.ApplyValues(leaves, eval.EvalulateBatch(states));
+
+  EXPECT_EQ(tree.VirtualVisit(mcts.Root()), 0);
+  EXPECT_EQ(tree.VirtualVisit(mate), 0);
+  EXPECT_EQ(tree.Visit(mcts.Root()), 2);
+}
+
+TEST_F(MCTSTest, SolverProvesCheckmate) {
+  Config config;
+  config.num_mcts_iteration = 100;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  // Qxb2# is the only move of white.
+  Board board = BoardFromNotation(R"(
+........
+........
+.....Q..
+...q....
+........
+........
+.q......
+k.K.....
+)");
+  GameStateBuilder builder(GameState::CreateGameStateForTesting(board));
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  const MCTSTree& tree = mcts.Tree();
+  const NodeIndex mate = tree.FirstChild(mcts.Root());
+  EXPECT_EQ(tree.Proven(mate), ProvenValue::kLoss);
+  EXPECT_EQ(tree.Proven(mcts.Root()), ProvenValue::kWin);
+
+  // The search stops once the root is proven: The root and the checkmate.
+  EXPECT_EQ(tree.Visit(mcts.Root()), 2);
+  EXPECT_EQ(mcts.MoveToMake().Str(), "f6b2");
+}
+
+TEST_F(MCTSTest, TranspositionsShareSearch) {
+  Config config;
+  config.num_mcts_iteration = 500;
+  config.mcts_transpositions = true;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  // Few moves, so the same positions are reached by different move orders
+  // (e.g. Kg1 Kg8 a3 and a3 Kg8 Kg1) early on.
+  Board board = BoardFromNotation(R"(
+.......k
+........
+........
+........
+........
+........
+P.......
+.......K
+)");
+  GameStateBuilder builder(GameState::CreateGameStateForTesting(board));
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  EXPECT_GT(mcts.NumTransposedVisits(), 0);
+  EXPECT_EQ(mcts.Tree().Visit(mcts.Root()), 500);
+}
+
+TEST_F(MCTSTest, AdvanceToFollowsGame) {
+  Config config;
+  config.num_mcts_iteration = 50;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4));  // e5
+  const auto& states = builder.GetStates();
+
+  MCTS mcts(states[0].get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  EXPECT_TRUE(mcts.AdvanceTo(*states[2]));
+  const GameState& root_state = mcts.Tree().State(mcts.Root());
+  EXPECT_EQ(root_state.GetBoard().Hash(), states[2]->GetBoard().Hash());
+  EXPECT_EQ(root_state.Hash(), states[2]->Hash());
+
+  // Not a continuation of the searched game.
+  GameStateBuilder other;
+  other.DoMove(Move(6, 3, 4, 3));  // d4
+  EXPECT_FALSE(mcts.AdvanceTo(*other.GetStates()[1]));
+  EXPECT_FALSE(mcts.AdvanceTo(*states[1]));
+}
+
+TEST_F(MCTSTest, ParallelSearchSharesTree) {
+  Config config;
+  config.num_threads = 1;
+  config.num_mcts_iteration = 200;
+  config.mcts_search_threads = 4;
+  config.use_async_inference = true;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+  MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, 0);
+  mcts.RunMCTS();
+
+  // Every iteration is backed up exactly once, and the virtual losses of the
+  // search threads are all removed.
+  const MCTSTree& tree = mcts.Tree();
+  EXPECT_EQ(tree.Visit(mcts.Root()), config.num_mcts_iteration);
+
+  int total_child_visit = 0;
+  const NodeIndex first_child = tree.FirstChild(mcts.Root());
+  for (int i = 0; i < tree.NumChildren(mcts.Root()); i++) {
+    total_child_visit += tree.Visit(first_child + i);
+    EXPECT_NEAR(tree.VirtualLoss(first_child + i), 0, 1e-4);
+  }
+  EXPECT_EQ(total_child_visit, config.num_mcts_iteration - 1);
+}
+
 TEST_F(MCTSTest, AsyncEval) {
   Config config;
   config.num_threads = 10;
@@ -68,6 +497,382 @@ TEST_F(MCTSTest, AsyncEval) {
   }
 }
 
+TEST_F(MCTSTest, AsyncEvalMultipleWorkers) {
+  Config config;
+  config.num_threads = 10;
+  config.num_mcts_iteration = 100;
+  config.total_game_play_for_testing = 20;
+  config.max_game_moves_until_draw = 10;
+  config.current_best_target_score = 10;
+  config.use_async_inference = true;
+  config.evaluator_worker_count = 3;
+  config.evaluator_intra_op_threads = 1;
+  config.pin_evaluator_worker_cores = true;
+
+  ChessNN nn(10, 10);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 10; i++) {
+    workers.push_back(std::thread([&, i]() {
+      MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, i);
+      mcts.RunMCTS();
+    }));
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+TEST_F(MCTSTest, BatchMCTSAsyncWithBatchWindow) {
+  Config config;
+  config.num_threads = 10;
+  config.num_mcts_iteration = 100;
+  config.do_batch_mcts = true;
+  config.mcts_batch_leaf_node_size = 8;
+  config.use_async_inference = true;
+  config.inference_batch_max_wait_us = 2000;
+  config.inference_max_batch_size = 64;
+
+  ChessNN nn(10, 10);
+  nn->to(config.device);
+
+  WorkerManager worker_manager(&config);
+  Evaluator eval(nn, &config, &worker_manager);
+  eval.StartInferenceWorker();
+
+  UniformDistribution dist;
+
+  GameStateBuilder builder;
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 10; i++) {
+    workers.push_back(std::thread([&, i]() {
+      MCTS mcts(builder.GetStates().front().get(), &eval, &dist, &config, i);
+      mcts.RunMCTS();
+    }));
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  const auto& info = worker_manager.GetInferenceWorkerInfo(0);
+  EXPECT_EQ(info.total_flush_by_target + info.total_flush_by_deadline,
+            info.total_num_inference);
+  EXPECT_LE(info.current_target_batch_size, 64);
+}
+
+TEST_F(MCTSTest, AsyncBatchMatchesSyncBatch) {
+  Config config;
+  config.num_threads = 4;
+  config.use_async_inference = true;
+  config.evaluator_worker_count = 2;
+
+  // Smaller than the request so that it is sent in chunks.
+  config.inference_max_batch_size = 3;
+  config.eval_cache_size = 0;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  // Otherwise the batch norm makes the value depend on the other states in the
+  // batch.
+  nn->eval();
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4))   // e5
+      .DoMove(Move(7, 6, 5, 5))   // Nf3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 5, 4, 2));  // Bc4
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<float> expected = eval.EvalulateBatch(states);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.num_threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      for (int iter = 0; iter < 20; iter++) {
+        std::vector<float> scores = eval.EvaluateAsyncBatch(states, i);
+        ASSERT_EQ(scores.size(), expected.size());
+        for (size_t j = 0; j < scores.size(); j++) {
+          EXPECT_NEAR(scores[j], expected[j], 1e-4);
+        }
+
+        EXPECT_NEAR(eval.EvaluateAsync(*states.back(), i), expected.back(),
+                    1e-4);
+      }
+    }));
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+TEST_F(MCTSTest, SubmitAsyncBatchMatchesSyncBatch) {
+  Config config;
+  config.num_threads = 1;
+  config.use_async_inference = true;
+  config.coroutine_batches_in_flight = 2;
+
+  // Smaller than the request so that it is sent in chunks.
+  config.inference_max_batch_size = 2;
+  config.eval_cache_size = 0;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4))   // e5
+      .DoMove(Move(7, 6, 5, 5))   // Nf3
+      .DoMove(Move(0, 1, 2, 2))   // Nc6
+      .DoMove(Move(7, 5, 4, 2));  // Bc4
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<float> expected = eval.EvalulateBatch(states);
+
+  // Both requester slots of the worker have a batch in flight.
+  const int first = eval.SearchThreadWorkerId(0, 0);
+  const int second = eval.SearchThreadWorkerId(0, 1);
+  for (int iter = 0; iter < 10; iter++) {
+    eval.SubmitAsyncBatch(states, first);
+    eval.SubmitAsyncBatch({states.back()}, second);
+
+    while (!eval.PollAsyncBatch(second)) {
+    }
+    std::vector<float> scores = eval.TakeAsyncBatchResult(second);
+    ASSERT_EQ(scores.size(), 1u);
+    EXPECT_NEAR(scores[0], expected.back(), 1e-4);
+
+    scores = eval.TakeAsyncBatchResult(first);
+    ASSERT_EQ(scores.size(), expected.size());
+    for (size_t i = 0; i < scores.size(); i++) {
+      EXPECT_NEAR(scores[i], expected[i], 1e-4);
+    }
+  }
+}
+
+TEST_F(MCTSTest, AsyncBatchMultipleModels) {
+  Config config;
+  config.num_threads = 4;
+  config.use_async_inference = true;
+  config.evaluator_worker_count = 2;
+  config.eval_cache_size = 0;
+
+  ChessNN nn1(2, 8);
+  nn1->to(config.device);
+  nn1->eval();
+
+  ChessNN nn2(2, 8);
+  nn2->to(config.device);
+  nn2->eval();
+
+  Evaluator eval(std::vector<ChessNN>{nn1, nn2}, &config,
+                 /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+  EXPECT_EQ(eval.NumModels(), 2);
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4));  // e5
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<std::vector<float>> expected = {
+      eval.EvalulateBatch(states, /*model_id=*/0),
+      eval.EvalulateBatch(states, /*model_id=*/1)};
+  EXPECT_NE(expected[0], expected[1]);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.num_threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      const int model_id = i % 2;
+      for (int iter = 0; iter < 20; iter++) {
+        std::vector<float> scores =
+            eval.EvaluateAsyncBatch(states, i, model_id);
+        ASSERT_EQ(scores.size(), expected[model_id].size());
+        for (size_t j = 0; j < scores.size(); j++) {
+          EXPECT_NEAR(scores[j], expected[model_id][j], 1e-4);
+        }
+      }
+    }));
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+TEST_F(MCTSTest, AsyncInteractiveRequestsWithBackground) {
+  Config config;
+  config.num_threads = 3;
+  config.use_async_inference = true;
+  config.evaluator_worker_count = 1;
+  config.eval_cache_size = 0;
+
+  // Long window so that only the interactive requests flush the batches early.
+  config.inference_batch_max_wait_us = 20000;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  WorkerManager worker_manager(&config);
+  Evaluator eval(nn, &config, &worker_manager);
+  eval.StartInferenceWorker();
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4));  // e5
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<float> expected = eval.EvalulateBatch(states);
+
+  auto check_scores = [&](int worker_id, InferencePriority priority) {
+    for (int iter = 0; iter < 10; iter++) {
+      std::vector<float> scores =
+          eval.EvaluateAsyncBatch(states, worker_id, /*model_id=*/0, priority);
+      ASSERT_EQ(scores.size(), expected.size());
+      for (size_t j = 0; j < scores.size(); j++) {
+        EXPECT_NEAR(scores[j], expected[j], 1e-4);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.num_threads; i++) {
+    workers.push_back(
+        std::thread(check_scores, i, InferencePriority::kBackground));
+  }
+  workers.push_back(std::thread(check_scores, eval.InteractiveWorkerId(),
+                                InferencePriority::kInteractive));
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  EXPECT_EQ(worker_manager
+                .GetInferenceLatencyInfo(InferencePriority::kBackground)
+                .total_num_request,
+            10 * config.num_threads);
+  EXPECT_EQ(worker_manager
+                .GetInferenceLatencyInfo(InferencePriority::kInteractive)
+                .total_num_request,
+            10);
+}
+
+TEST_F(MCTSTest, AsyncPublishModelWhileEvaluating) {
+  Config config;
+  config.num_threads = 4;
+  config.use_async_inference = true;
+  config.evaluator_worker_count = 2;
+
+  ChessNN nn1(2, 8);
+  nn1->to(config.device);
+  nn1->eval();
+
+  ChessNN nn2(2, 8);
+  nn2->to(config.device);
+  nn2->eval();
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4));  // e5
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<float> expected1 =
+      Evaluator(nn1, &config, nullptr).EvalulateBatch(states);
+  const std::vector<float> expected2 =
+      Evaluator(nn2, &config, nullptr).EvalulateBatch(states);
+  ASSERT_NE(expected1, expected2);
+
+  Evaluator eval(nn1, &config, /*worker_manager=*/nullptr);
+  eval.StartInferenceWorker();
+  const uint64_t version = eval.ModelVersion(0);
+
+  auto matches = [](const std::vector<float>& scores,
+                    const std::vector<float>& expected) {
+    for (size_t i = 0; i < scores.size(); i++) {
+      if (std::abs(scores[i] - expected[i]) > 1e-4) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::atomic<bool> published = false;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.num_threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      for (int iter = 0; iter < 50; iter++) {
+        const bool published_before = published.load();
+        std::vector<float> scores = eval.EvaluateAsyncBatch(states, i);
+        ASSERT_EQ(scores.size(), expected1.size());
+
+        // Every batch runs on a single snapshot; Once published, the old
+        // weights are never used again.
+        if (published_before) {
+          EXPECT_TRUE(matches(scores, expected2));
+        } else {
+          EXPECT_TRUE(matches(scores, expected1) ||
+                      matches(scores, expected2));
+        }
+      }
+    }));
+  }
+
+  EXPECT_EQ(eval.PublishModel(0, nn2), version + 1);
+  published = true;
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  EXPECT_TRUE(matches(eval.EvalulateBatch(states), expected2));
+}
+
 TEST_F(MCTSTest, BatchMCTSNotAsync) {
   Config config;
   config.num_threads = 10;
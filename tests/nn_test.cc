@@ -414,6 +414,114 @@ TEST(ChessNNTest, ChessNN) {
              GetModelNumParams(model) * 4 / 1024.f / 1024.f);
 }
 
+TEST(ChessNNTest, ConvPolicyHead) {
+  ChessNN fc_model(10, 10);
+  ChessNN conv_model(10, 10, /*use_conv_policy_head=*/true);
+
+  torch::Device device(torch::kCUDA);
+  fc_model->to(device);
+  conv_model->to(device);
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(7, 1, 5, 2))   // Nb3
+      .DoMove(Move(0, 1, 2, 2));  // Nc6
+
+  auto v1 = GameStateToTensor(*builder.GetStates()[0]);
+  auto v2 = GameStateToTensor(*builder.GetStates()[1]);
+  auto v3 = GameStateToTensor(*builder.GetStates()[2]);
+
+  torch::Tensor batch = torch::stack({v1, v2, v3}).to(device);
+  torch::Tensor policy = conv_model->GetPolicy(batch);
+
+  EXPECT_EQ(policy.sizes(), fc_model->GetPolicy(batch).sizes());
+  EXPECT_EQ(policy.sizes()[1], 73 * 8 * 8);
+
+  // Each policy should be a probability distribution.
+  EXPECT_TRUE(policy.sum(1).allclose(torch::ones({3}).to(device)));
+
+  // Dense layer alone has 4672 * 4672 parameters.
+  EXPECT_LT(GetModelNumParams(conv_model) * 10, GetModelNumParams(fc_model));
+}
+
+TEST(ChessNNTest, ReducedPrecision) {
+  Config config;
+  config.use_cuda = false;
+  config.device = torch::Device(torch::kCPU);
+
+  if (!IsReducedPrecisionSupported(config.device)) {
+    GTEST_SKIP() << "bfloat16 is not supported on this CPU.";
+  }
+
+  torch::NoGradGuard no_grad;
+
+  ChessNN model(10, 64);
+  model->eval();
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(7, 1, 5, 2))  // Nb3
+      .DoMove(Move(0, 1, 2, 2))  // Nc6
+      .DoMove(Move(5, 2, 7, 1))
+      .DoMove(Move(2, 2, 0, 1));
+
+  std::vector<torch::Tensor> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(GameStateToTensor(*state));
+  }
+
+  // 5 * 12 = 60 positions, which is around the MCTS inference batch size.
+  torch::Tensor batch = torch::stack(states).repeat({12, 1, 1, 1});
+
+  // Only the closeness is checked here; app/inference_benchmark measures the
+  // speed (--precisions=fp32,reduced).
+  auto run = [&](bool use_reduced_precision, torch::Tensor* value,
+                 torch::Tensor* policy) {
+    config.use_reduced_precision = use_reduced_precision;
+    ReducedPrecisionGuard precision_guard(&config);
+
+    *value = model->GetValue(batch).to(torch::kFloat);
+    *policy = model->GetPolicy(batch).to(torch::kFloat);
+  };
+
+  torch::Tensor value_fp32, policy_fp32, value_bf16, policy_bf16;
+  run(false, &value_fp32, &policy_fp32);
+  run(true, &value_bf16, &policy_bf16);
+
+  float value_dev = (value_fp32 - value_bf16).abs().max().item<float>();
+  float policy_dev = (policy_fp32 - policy_bf16).abs().max().item<float>();
+
+  EXPECT_LT(value_dev, 0.1);
+  EXPECT_LT(policy_dev, 0.01);
+}
+
+TEST(ChessNNTest, CloneChessNN) {
+  torch::Device device(torch::kCUDA);
+  ChessNN model(3, 16);
+  model->to(device);
+
+  ChessNN replica = CloneChessNN(model);
+
+  auto init = GameStateToTensor(GameState::CreateInitGameState());
+  init = init.to(device);
+
+  EXPECT_TRUE(model->GetValue(init).equal(replica->GetValue(init)));
+  EXPECT_TRUE(model->GetPolicy(init).equal(replica->GetPolicy(init)));
+
+  // Replica should not share the storage with the original.
+  {
+    torch::NoGradGuard no_grad;
+    for (auto& param : model->parameters()) {
+      param.add_(1);
+    }
+  }
+
+  EXPECT_FALSE(model->GetValue(init).equal(replica->GetValue(init)));
+
+  CopyChessNNWeights(model, replica);
+  EXPECT_TRUE(model->GetValue(init).equal(replica->GetValue(init)));
+}
+
 TEST(ChessNNTest, NormalizePolicy) {
   torch::Tensor policy = torch::ones({1, 73, 8, 8});
   policy = policy.flatten(1);
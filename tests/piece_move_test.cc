@@ -281,6 +281,13 @@ TEST_F(PieceMoveTest, KingBlocked) {
               UnorderedElementsAre("d3", "c3", "c5", "e3", "e4", "e5"));
 }
 
+TEST(MoveTest, EncodeDecode) {
+  for (const Move& move : {Move(6, 4, 4, 4), Move(1, 0, 0, 1, PROMOTE_QUEEN),
+                           Move(63, 0, PROMOTE_ROOK)}) {
+    EXPECT_EQ(Move::Decode(move.Encode()), move);
+  }
+}
+
 }  // namespace
 }  // namespace chess
 
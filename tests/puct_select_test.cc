@@ -0,0 +1,108 @@
+#include "puct_select.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace chess {
+namespace {
+
+struct Children {
+  std::vector<float> prior;
+  std::vector<int32_t> n_s_a;
+  std::vector<float> w_s_a;
+  std::vector<int32_t> virtual_visit;
+
+  ChildStats Stats() const {
+    return {prior.data(), n_s_a.data(), w_s_a.data(), virtual_visit.data()};
+  }
+};
+
+Children RandomChildren(int num_children, std::mt19937* gen) {
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::uniform_int_distribution<int> visit(1, 50);
+  std::uniform_int_distribution<int> virtual_visit(0, 2);
+
+  Children children;
+  for (int i = 0; i < num_children; i++) {
+    children.prior.push_back(unit(*gen));
+    children.n_s_a.push_back(visit(*gen));
+    children.w_s_a.push_back((2 * unit(*gen) - 1) * children.n_s_a.back());
+    children.virtual_visit.push_back(virtual_visit(*gen));
+  }
+  return children;
+}
+
+std::vector<PUCTKernel> SupportedKernels() {
+  std::vector<PUCTKernel> kernels;
+  for (PUCTKernel kernel :
+       {PUCTKernel::kScalar, PUCTKernel::kAvx2, PUCTKernel::kAvx512}) {
+    if (IsPUCTKernelSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+TEST(PUCTSelectTest, PicksLargestScore) {
+  Children children;
+  children.prior = {0.1, 0.8, 0.1};
+  children.n_s_a = {1, 1, 1};
+  children.w_s_a = {0, 0, 0};
+  children.virtual_visit = {0, 0, 0};
+
+  for (PUCTKernel kernel : SupportedKernels()) {
+    EXPECT_EQ(SelectPUCT(kernel, children.Stats(), 3, 3, -1), 1);
+  }
+}
+
+TEST(PUCTSelectTest, FirstUnvisitedChildWins) {
+  std::mt19937 gen(0);
+  Children children = RandomChildren(40, &gen);
+  children.n_s_a[21] = children.virtual_visit[21] = 0;
+  children.n_s_a[33] = children.virtual_visit[33] = 0;
+
+  for (PUCTKernel kernel : SupportedKernels()) {
+    EXPECT_EQ(SelectPUCT(kernel, children.Stats(), 40, 100, -1), 21)
+        << PUCTKernelName(kernel);
+  }
+}
+
+TEST(PUCTSelectTest, FirstChildWinsTies) {
+  Children children;
+  for (int i = 0; i < 20; i++) {
+    children.prior.push_back(i == 5 || i == 17 ? 0.5 : 0.1);
+    children.n_s_a.push_back(3);
+    children.w_s_a.push_back(1);
+    children.virtual_visit.push_back(0);
+  }
+
+  for (PUCTKernel kernel : SupportedKernels()) {
+    EXPECT_EQ(SelectPUCT(kernel, children.Stats(), 20, 60, -1), 5)
+        << PUCTKernelName(kernel);
+  }
+}
+
+TEST(PUCTSelectTest, KernelsAgree) {
+  std::mt19937 gen(1);
+  for (int num_children = 1; num_children <= 64; num_children++) {
+    for (int trial = 0; trial < 20; trial++) {
+      Children children = RandomChildren(num_children, &gen);
+      const int total_visit = 1 + gen() % 1000;
+
+      const int expected =
+          SelectPUCT(PUCTKernel::kScalar, children.Stats(), num_children,
+                     total_visit, /*virtual_loss=*/-1);
+      for (PUCTKernel kernel : SupportedKernels()) {
+        EXPECT_EQ(SelectPUCT(kernel, children.Stats(), num_children,
+                             total_visit, /*virtual_loss=*/-1),
+                  expected)
+            << PUCTKernelName(kernel) << " with " << num_children;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace chess
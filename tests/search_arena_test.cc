@@ -0,0 +1,58 @@
+#include "search_arena.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "gtest/gtest.h"
+
+namespace chess {
+namespace {
+
+TEST(SearchArenaTest, AlignsAllocations) {
+  SearchArena arena;
+
+  arena.Allocate(1, 1);
+  void* p = arena.Allocate(64, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 64, 0);
+  EXPECT_GE(arena.BytesUsed(), 65);
+}
+
+TEST(SearchArenaTest, ResetReusesBlocks) {
+  SearchArena arena(/*use_huge_pages=*/true);
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 1000; j++) {
+      arena.Allocate(4096, 8);
+    }
+    const size_t reserved = arena.BytesReserved();
+
+    arena.Reset();
+    EXPECT_EQ(arena.BytesUsed(), 0);
+    EXPECT_EQ(arena.BytesReserved(), reserved);
+  }
+}
+
+TEST(SearchArenaTest, LargerThanBlock) {
+  SearchArena arena;
+
+  char* p = static_cast<char*>(arena.Allocate(3 * SearchArena::kBlockSize, 8));
+  p[3 * SearchArena::kBlockSize - 1] = 1;
+  EXPECT_GE(arena.BytesReserved(), 3 * SearchArena::kBlockSize);
+}
+
+TEST(SearchArenaTest, ResetDestructsObjects) {
+  auto counter = std::make_shared<int>(0);
+
+  SearchArena arena;
+  for (int i = 0; i < 10; i++) {
+    arena.New<std::shared_ptr<int>>(counter);
+  }
+  arena.New<int>(3);
+  EXPECT_EQ(counter.use_count(), 11);
+
+  arena.Reset();
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+}  // namespace
+}  // namespace chess
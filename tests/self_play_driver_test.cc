@@ -0,0 +1,44 @@
+#include "self_play_driver.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+namespace chess {
+namespace {
+
+TEST(SelfPlayDriverTest, PlaysEveryGame) {
+  Config config;
+  config.num_mcts_iteration = 10;
+  config.max_game_moves_until_draw = 4;
+  config.mcts_batch_leaf_node_size = 4;
+  config.self_play_games_per_thread = 3;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+
+  Evaluator eval(nn, &config, /*worker_manager=*/nullptr);
+  UniformDistribution dist;
+
+  SelfPlayDriver driver(&dist, &config, &eval, /*worker_id=*/0);
+
+  // More games than the driver plays at once. No game can end before the 4th
+  // move (the fool's mate).
+  int num_started = 0;
+  std::vector<int> game_lengths;
+  driver.Run([&]() { return num_started++ < 5; },
+             [&](std::vector<std::unique_ptr<Experience>>& experiences) {
+               game_lengths.push_back(experiences.size());
+
+               // Every move was searched from the previous state.
+               for (size_t i = 1; i < experiences.size(); i++) {
+                 EXPECT_EQ(experiences[i]->state->PrevState(),
+                           experiences[i - 1]->state.get());
+               }
+             });
+
+  EXPECT_THAT(game_lengths, testing::ElementsAre(4, 4, 4, 4, 4));
+}
+
+}  // namespace
+}  // namespace chess
@@ -90,6 +90,20 @@ TEST(ServerTest, HandleWorkerInfoRequest) {
   WorkerManager* worker_manager = server_context.GetWorkerManager();
   worker_manager->GetInferenceWorkerInfo(0).total_inference_batch_size = 4;
   worker_manager->GetInferenceWorkerInfo(0).total_num_inference = 24;
+  worker_manager->GetInferenceWorkerInfo(0).total_flush_by_target = 20;
+  worker_manager->GetInferenceWorkerInfo(0).total_flush_by_deadline = 4;
+  worker_manager->GetInferenceWorkerInfo(0).total_batch_wait_us = 300;
+  worker_manager->GetInferenceWorkerInfo(0).current_target_batch_size = 8;
+
+  worker_manager->GetEvalCacheInfo().total_hits = 30;
+  worker_manager->GetEvalCacheInfo().total_misses = 10;
+
+  auto& interactive_info = worker_manager->GetInferenceLatencyInfo(
+      InferencePriority::kInteractive);
+  interactive_info.total_num_request = 3;
+  interactive_info.total_latency_us = 1200;
+  interactive_info.max_latency_us = 600;
+  interactive_info.total_deadline_miss = 1;
 
   worker_manager->GetWorkerInfo(1).current_game_total_move = 32;
   worker_manager->GetWorkerInfo(1).total_game_played = 50;
@@ -99,14 +113,40 @@ TEST(ServerTest, HandleWorkerInfoRequest) {
   json request = R"({"action" : "WorkerInfo"})"_json;
   json expected = R"(
    {
+   "eval_cache_info": {
+        "total_hits": 30,
+        "total_misses": 10
+    },
+   "inference_latency_info": {
+        "background": {
+            "total_num_request": 0,
+            "total_latency_us": 0,
+            "max_latency_us": 0,
+            "total_deadline_miss": 0
+        },
+        "interactive": {
+            "total_num_request": 3,
+            "total_latency_us": 1200,
+            "max_latency_us": 600,
+            "total_deadline_miss": 1
+        }
+    },
    "inference_worker_info": [
         {
             "total_inference_batch_size": 4,
-            "total_num_inference": 24
+            "total_num_inference": 24,
+            "total_flush_by_target": 20,
+            "total_flush_by_deadline": 4,
+            "total_batch_wait_us": 300,
+            "current_target_batch_size": 8
         },
         {
             "total_inference_batch_size": 0,
-            "total_num_inference": 0
+            "total_num_inference": 0,
+            "total_flush_by_target": 0,
+            "total_flush_by_deadline": 0,
+            "total_batch_wait_us": 0,
+            "current_target_batch_size": 0
         }
     ],
     "worker_info": [
@@ -136,6 +176,84 @@ TEST(ServerTest, HandleWorkerInfoRequest) {
   EXPECT_EQ(json::parse(result.value()), expected);
 }
 
+TEST(ServerTest, GetSearchLimits) {
+  Config config;
+  ServerContext server_context(&config);
+  Server server(&config, &server_context);
+
+  absl::StatusOr<SearchLimits> limits =
+      server.GetSearchLimits(R"({"move_time_ms" : 500})"_json);
+  ASSERT_TRUE(limits.ok());
+  EXPECT_EQ(limits->move_time, std::chrono::milliseconds(500));
+
+  limits = server.GetSearchLimits(R"({"max_nodes" : 20000})"_json);
+  ASSERT_TRUE(limits.ok());
+  EXPECT_EQ(limits->max_nodes, 20000u);
+
+  // Strings of the integers are also accepted.
+  limits = server.GetSearchLimits(
+      R"({"move_time_ms" : "250", "max_nodes" : "100"})"_json);
+  ASSERT_TRUE(limits.ok());
+  EXPECT_EQ(limits->move_time, std::chrono::milliseconds(250));
+  EXPECT_EQ(limits->max_nodes, 100u);
+
+  // Falls back to the config.
+  limits = server.GetSearchLimits(R"({})"_json);
+  ASSERT_TRUE(limits.ok());
+  EXPECT_EQ(limits->max_nodes, SearchLimits::FromConfig(config).max_nodes);
+  EXPECT_TRUE(limits->smart_pruning);
+}
+
+TEST(ServerTest, ResignIgnoresSearchLimits) {
+  Config config;
+  ServerContext server_context(&config);
+  Server server(&config, &server_context);
+
+  // The client plays white, so the server does not search.
+  json request;
+  request["action"] = "Create";
+  request["game_id"] = "game";
+  request["client_side"] = "white";
+  ASSERT_TRUE(server.HandleRequest(request.dump()).ok());
+
+  // Resign does not search, so the malformed limits do not matter.
+  request["action"] = "Resign";
+  request["move_time_ms"] = "soon";
+  absl::StatusOr<std::string> result = server.HandleRequest(request.dump());
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(result.value(), "{'result' : 'lost'}");
+}
+
+TEST(ServerTest, GetSearchLimitsDoesNotPruneGumbelRoot) {
+  Config config;
+  config.mcts_gumbel_root = true;
+  ServerContext server_context(&config);
+  Server server(&config, &server_context);
+
+  absl::StatusOr<SearchLimits> limits = server.GetSearchLimits(R"({})"_json);
+  ASSERT_TRUE(limits.ok());
+  EXPECT_FALSE(limits->smart_pruning);
+}
+
+TEST(ServerTest, GetSearchLimitsRejectsInvalidValues) {
+  Config config;
+  ServerContext server_context(&config);
+  Server server(&config, &server_context);
+
+  for (const char* request : {
+           R"({"move_time_ms" : 1.5})",
+           R"({"move_time_ms" : -1})",
+           R"({"move_time_ms" : "soon"})",
+           R"({"max_nodes" : [100]})",
+           R"({"max_nodes" : -5})",
+           R"({"max_nodes" : true})",
+       }) {
+    EXPECT_EQ(server.GetSearchLimits(json::parse(request)).status().code(),
+              absl::StatusCode::kInvalidArgument)
+        << request;
+  }
+}
+
 }  // namespace
 }  // namespace chess
 
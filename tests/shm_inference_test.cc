@@ -0,0 +1,440 @@
+#include "shm_inference.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nn/nn_util.h"
+#include "serialize.h"
+#include "server_context.h"
+#include "shm_evaluator.h"
+#include "shm_inference_server.h"
+#include "test_utils.h"
+#include "train.h"
+
+namespace chess {
+namespace {
+
+std::string UniqueName(std::string_view test_name) {
+  return "/deepchess_test_" + std::string(test_name) + "_" +
+         std::to_string(getpid());
+}
+
+// Fork a process that creates the channel and waits until it is killed.
+pid_t StartServerProcess(const std::string& name, int num_slots,
+                         int slot_rows) {
+  int ready[2];
+  if (pipe(ready) < 0) {
+    return -1;
+  }
+
+  const pid_t pid = fork();
+  if (pid == 0) {
+    auto channel = ShmInferenceChannel::Create(name, num_slots, slot_rows);
+    const char ok = channel.ok();
+    (void)!write(ready[1], &ok, 1);
+    while (true) {
+      pause();
+    }
+  }
+
+  char ok = 0;
+  (void)!read(ready[0], &ok, 1);
+  close(ready[0]);
+  close(ready[1]);
+  return ok ? pid : -1;
+}
+
+// Kill the server process before it cleans up the region.
+void KillServerProcess(pid_t pid) {
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+TEST(ShmInferenceChannelTest, OpenWithoutServer) {
+  EXPECT_FALSE(ShmInferenceChannel::Open(UniqueName("no_server")).ok());
+}
+
+TEST(ShmInferenceChannelTest, RoundTrip) {
+  const std::string name = UniqueName("round_trip");
+
+  auto server = ShmInferenceChannel::Create(name, /*num_slots=*/4,
+                                            /*slot_rows=*/8);
+  ASSERT_TRUE(server.ok());
+
+  auto client = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(client.ok());
+  EXPECT_EQ((*client)->NumSlots(), 4);
+  EXPECT_EQ((*client)->SlotRows(), 8);
+
+  constexpr int kNumClients = 4;
+  constexpr int kNumRequests = 200;
+
+  std::atomic<bool> done = false;
+
+  // Echoes back the first float of each row.
+  std::thread server_thread([&]() {
+    auto& channel = *server.value();
+    while (!done) {
+      std::vector<int> slots = channel.TakeRequests(
+          /*max_rows=*/16, std::chrono::milliseconds(10));
+      for (int slot : slots) {
+        for (int row = 0; row < channel.SlotNumRows(slot); row++) {
+          channel.SlotOutput(slot)[row] =
+              channel.SlotInput(slot)[row * kNumStatePlanes * 64];
+        }
+        channel.Complete(slot);
+      }
+    }
+  });
+
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kNumClients; i++) {
+    clients.push_back(std::thread([&, i]() {
+      auto& channel = *client.value();
+      for (int request = 0; request < kNumRequests; request++) {
+        const int num_rows = 1 + request % channel.SlotRows();
+
+        const int slot = channel.AcquireSlot().value();
+        for (int row = 0; row < num_rows; row++) {
+          channel.SlotInput(slot)[row * kNumStatePlanes * 64] = i * 1000 + row;
+        }
+
+        channel.Submit(slot, num_rows);
+        const float* values = channel.WaitForResult(slot).value();
+        for (int row = 0; row < num_rows; row++) {
+          EXPECT_EQ(values[row], i * 1000 + row);
+        }
+        channel.ReleaseSlot(slot);
+      }
+    }));
+  }
+
+  for (auto& c : clients) {
+    c.join();
+  }
+
+  done = true;
+  server_thread.join();
+}
+
+TEST(ShmInferenceChannelTest, ServerDiesWhileWaiting) {
+  const std::string name = UniqueName("server_dies");
+
+  const pid_t server_pid = StartServerProcess(name, /*num_slots=*/2,
+                                              /*slot_rows=*/4);
+  ASSERT_GT(server_pid, 0);
+
+  auto client = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(client.ok());
+  EXPECT_TRUE((*client)->CheckServer().ok());
+
+  const int slot = (*client)->AcquireSlot().value();
+  (*client)->Submit(slot, 1);
+
+  std::thread killer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    KillServerProcess(server_pid);
+  });
+
+  absl::StatusOr<const float*> values = (*client)->WaitForResult(slot);
+  killer.join();
+
+  EXPECT_EQ(values.status().code(), absl::StatusCode::kUnavailable);
+  (*client)->ReleaseSlot(slot);
+
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmInferenceChannelTest, ServerShutsDownWhileWaiting) {
+  const std::string name = UniqueName("server_shuts_down");
+
+  auto server = ShmInferenceChannel::Create(name, /*num_slots=*/2,
+                                            /*slot_rows=*/4);
+  ASSERT_TRUE(server.ok());
+
+  auto client = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(client.ok());
+
+  const int slot = (*client)->AcquireSlot().value();
+  (*client)->Submit(slot, 1);
+
+  server->reset();
+
+  EXPECT_EQ((*client)->WaitForResult(slot).status().code(),
+            absl::StatusCode::kUnavailable);
+  EXPECT_EQ((*client)->AcquireSlot().status().code(),
+            absl::StatusCode::kUnavailable);
+}
+
+TEST(ShmInferenceChannelTest, ReclaimsSlotsOfDeadClients) {
+  const std::string name = UniqueName("reclaim");
+
+  auto server = ShmInferenceChannel::Create(name, /*num_slots=*/2,
+                                            /*slot_rows=*/4);
+  ASSERT_TRUE(server.ok());
+
+  // Claims both slots and exits without releasing them.
+  const pid_t client_pid = fork();
+  if (client_pid == 0) {
+    auto client = ShmInferenceChannel::Open(name);
+    if (client.ok()) {
+      (void)(*client)->AcquireSlot();
+      const int slot = (*client)->AcquireSlot().value_or(0);
+      (*client)->Submit(slot, 1);
+    }
+    _exit(0);
+  }
+  ASSERT_GT(client_pid, 0);
+  waitpid(client_pid, nullptr, 0);
+
+  auto client = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(client.ok());
+
+  // Too recent to be checked.
+  EXPECT_EQ((*server)->ReclaimSlots(std::chrono::hours(1)), 0);
+  EXPECT_EQ((*server)->ReclaimSlots(std::chrono::milliseconds(0)), 2);
+
+  // The slots of the live clients are kept.
+  EXPECT_TRUE((*client)->AcquireSlot().ok());
+  EXPECT_TRUE((*client)->AcquireSlot().ok());
+  EXPECT_EQ((*server)->ReclaimSlots(std::chrono::milliseconds(0)), 0);
+
+  // Only the submitted slot of the dead client is served.
+  EXPECT_TRUE(
+      (*server)->TakeRequests(/*max_rows=*/8, std::chrono::milliseconds(0))
+          .empty());
+}
+
+TEST(ShmInferenceChannelTest, RecreateClosesPreviousGeneration) {
+  const std::string name = UniqueName("recreate");
+
+  auto old_server = ShmInferenceChannel::Create(name, /*num_slots=*/2,
+                                                /*slot_rows=*/4);
+  ASSERT_TRUE(old_server.ok());
+
+  auto client = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(client.ok());
+  EXPECT_EQ((*client)->Generation(), 0);
+
+  auto new_server = ShmInferenceChannel::Create(name, /*num_slots=*/2,
+                                                /*slot_rows=*/4);
+  ASSERT_TRUE(new_server.ok());
+
+  EXPECT_EQ((*client)->AcquireSlot().status().code(),
+            absl::StatusCode::kUnavailable);
+
+  // Deleting the old server leaves the new region alone.
+  old_server->reset();
+
+  auto reopened = ShmInferenceChannel::Open(name);
+  ASSERT_TRUE(reopened.ok());
+  EXPECT_EQ((*reopened)->Generation(), 1);
+  EXPECT_TRUE((*reopened)->CheckServer().ok());
+}
+
+TEST(ShmEvaluatorTest, FailsWhenServerDies) {
+  Config config;
+  config.inference_server_name = UniqueName("evaluator_server_dies");
+  config.eval_cache_size = 0;
+
+  const pid_t server_pid =
+      StartServerProcess(config.inference_server_name,
+                         config.inference_server_num_slots,
+                         config.inference_server_slot_rows);
+  ASSERT_GT(server_pid, 0);
+
+  auto shm_eval = ShmEvaluator::Create(&config, /*worker_manager=*/nullptr);
+  ASSERT_TRUE(shm_eval.ok());
+
+  GameState state = GameState::CreateInitGameState();
+
+  std::thread killer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    KillServerProcess(server_pid);
+  });
+
+  absl::StatusOr<std::vector<float>> values =
+      (*shm_eval)->EvaluateOnServer({&state});
+  killer.join();
+
+  EXPECT_EQ(values.status().code(), absl::StatusCode::kUnavailable);
+
+  shm_unlink(config.inference_server_name.c_str());
+}
+
+TEST(ShmEvaluatorTest, ReopensRestartedServer) {
+  Config config;
+  config.inference_server_name = UniqueName("evaluator_reopen");
+  config.eval_cache_size = 0;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  auto old_channel = ShmInferenceChannel::Create(
+      config.inference_server_name, config.inference_server_num_slots,
+      config.inference_server_slot_rows);
+  ASSERT_TRUE(old_channel.ok());
+
+  auto shm_eval = ShmEvaluator::Create(&config, /*worker_manager=*/nullptr);
+  ASSERT_TRUE(shm_eval.ok());
+  const uint64_t old_version = (*shm_eval)->ModelVersion(0);
+
+  // The server restarts before serving anything.
+  auto channel = ShmInferenceChannel::Create(config.inference_server_name,
+                                             config.inference_server_num_slots,
+                                             config.inference_server_slot_rows);
+  ASSERT_TRUE(channel.ok());
+  old_channel->reset();
+
+  ShmInferenceServer server(nn, &config, channel.value().get());
+  std::thread server_thread([&]() { server.Run(); });
+
+  GameState state = GameState::CreateInitGameState();
+  Evaluator local_eval(nn, &config, /*worker_manager=*/nullptr);
+
+  absl::StatusOr<std::vector<float>> values =
+      (*shm_eval)->EvaluateOnServer({&state});
+  ASSERT_TRUE(values.ok()) << values.status();
+  ASSERT_EQ(values->size(), 1);
+  EXPECT_NEAR((*values)[0], local_eval.Evalulate(state), 1e-4);
+
+  // The values of the dead server are not served from the cache.
+  EXPECT_NE((*shm_eval)->ModelVersion(0), old_version);
+
+  server.Stop();
+  server_thread.join();
+}
+
+TEST(ShmEvaluatorTest, RejectsOtherModels) {
+  Config config;
+  config.inference_server_name = UniqueName("evaluator_models");
+
+  auto channel = ShmInferenceChannel::Create(config.inference_server_name,
+                                             config.inference_server_num_slots,
+                                             config.inference_server_slot_rows);
+  ASSERT_TRUE(channel.ok());
+
+  auto shm_eval = ShmEvaluator::Create(&config, /*worker_manager=*/nullptr);
+  ASSERT_TRUE(shm_eval.ok());
+
+  GameState state = GameState::CreateInitGameState();
+  EXPECT_EQ(
+      (*shm_eval)->EvaluateOnServer({&state}, /*model_id=*/1).status().code(),
+      absl::StatusCode::kInvalidArgument);
+
+  EXPECT_EQ((*shm_eval)->ModelVersion(0), 0);
+  EXPECT_DEATH((*shm_eval)->ModelVersion(1), "only the model 0");
+  EXPECT_DEATH((*shm_eval)->Evalulate(state, /*model_id=*/1),
+               "only the model 0");
+  EXPECT_DEATH((*shm_eval)->PublishModel(0, ChessNN(2, 8)),
+               "Cannot publish");
+}
+
+TEST(ShmEvaluatorTest, MatchesInProcessEvaluator) {
+  Config config;
+  config.num_threads = 4;
+  config.inference_server_name = UniqueName("evaluator");
+  config.inference_server_slot_rows = 2;
+  config.eval_cache_size = 0;
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  auto channel = ShmInferenceChannel::Create(config.inference_server_name,
+                                             config.inference_server_num_slots,
+                                             config.inference_server_slot_rows);
+  ASSERT_TRUE(channel.ok());
+
+  ShmInferenceServer server(nn, &config, channel.value().get());
+  std::thread server_thread([&]() { server.Run(); });
+
+  auto shm_eval = ShmEvaluator::Create(&config, /*worker_manager=*/nullptr);
+  ASSERT_TRUE(shm_eval.ok());
+
+  Evaluator local_eval(nn, &config, /*worker_manager=*/nullptr);
+
+  GameStateBuilder builder;
+  builder
+      .DoMove(Move(6, 4, 4, 4))   // e4
+      .DoMove(Move(1, 4, 3, 4))   // e5
+      .DoMove(Move(7, 6, 5, 5))   // Nf3
+      .DoMove(Move(0, 1, 2, 2));  // Nc6
+
+  std::vector<const GameState*> states;
+  for (const auto& state : builder.GetStates()) {
+    states.push_back(state.get());
+  }
+
+  const std::vector<float> expected = local_eval.EvalulateBatch(states);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.num_threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      std::vector<float> scores =
+          (*shm_eval)->EvaluateAsyncBatch(states, /*worker_id=*/i);
+      ASSERT_EQ(scores.size(), expected.size());
+      for (size_t j = 0; j < scores.size(); j++) {
+        EXPECT_NEAR(scores[j], expected[j], 1e-4);
+      }
+
+      EXPECT_NEAR((*shm_eval)->Evalulate(*states.back()), expected.back(),
+                  1e-4);
+    }));
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  server.Stop();
+  server_thread.join();
+}
+
+TEST(ShmEvaluatorTest, SelfPlayOnlySavesExperiences) {
+  Config config;
+  config.num_threads = 2;
+  config.num_self_play_game = 2;
+  config.num_mcts_iteration = 2;
+  config.max_game_moves_until_draw = 4;
+  config.show_self_play_boards = false;
+  config.self_play_only = true;
+  config.inference_server_name = UniqueName("self_play");
+  config.exp_save_file_name = "ShmSelfPlayExperiencesForTesting.exp";
+
+  ChessNN nn(2, 8);
+  nn->to(config.device);
+  nn->eval();
+
+  auto channel = ShmInferenceChannel::Create(config.inference_server_name,
+                                             config.inference_server_num_slots,
+                                             config.inference_server_slot_rows);
+  ASSERT_TRUE(channel.ok());
+
+  ShmInferenceServer server(nn, &config, channel.value().get());
+  std::thread server_thread([&]() { server.Run(); });
+
+  ServerContext server_context(&config);
+  auto shm_eval = ShmEvaluator::Create(&config,
+                                       server_context.GetWorkerManager());
+  ASSERT_TRUE(shm_eval.ok());
+
+  {
+    // The experiences are flushed once the trainer is gone.
+    Train trainer(&config, &server_context);
+    trainer.DoSelfPlay(shm_eval->get());
+  }
+
+  EXPECT_FALSE(DeserializeExperiences(config.exp_save_file_name).empty());
+
+  server.Stop();
+  server_thread.join();
+}
+
+}  // namespace
+}  // namespace chess
@@ -61,14 +61,12 @@ TEST(TrainTest, AgentPlayTest) {
   ChessNN nn(10, 10);
   nn->to(config.device);
 
-  Evaluator target_eval(nn, &config, /*worker_manager=*/nullptr);
-  target_eval.StartInferenceWorker();
-
-  Evaluator current_eval(nn, &config, /*worker_manager=*/nullptr);
-  current_eval.StartInferenceWorker();
+  Evaluator evaluator(std::vector<ChessNN>{nn, nn}, &config,
+                      /*worker_manager=*/nullptr);
+  evaluator.StartInferenceWorker();
 
   // Every match should be draw.
-  EXPECT_TRUE(trainer.IsTrainedBetter(&target_eval, &current_eval));
+  EXPECT_TRUE(trainer.IsTrainedBetter(&evaluator));
 }
 
 /*
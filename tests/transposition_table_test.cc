@@ -0,0 +1,28 @@
+#include "transposition_table.h"
+
+#include "gtest/gtest.h"
+
+namespace chess {
+namespace {
+
+TEST(TranspositionTableTest, FirstNodeOfPosition) {
+  TranspositionTable table;
+
+  EXPECT_EQ(table.FindOrInsert(3, 10), 10);
+  EXPECT_EQ(table.FindOrInsert(3, 20), 10);
+  EXPECT_EQ(table.FindOrInsert(19, 20), 20);
+  EXPECT_EQ(table.Size(), 2);
+}
+
+TEST(TranspositionTableTest, Clear) {
+  TranspositionTable table;
+
+  table.FindOrInsert(1, 10);
+  table.Clear();
+
+  EXPECT_EQ(table.Size(), 0);
+  EXPECT_EQ(table.FindOrInsert(1, 20), 20);
+}
+
+}  // namespace
+}  // namespace chess